@@ -69,10 +69,12 @@ AdvancedSSR::AdvancedSSR(rendergraph::RenderGraph &graph, uint32_t w, uint32_t h
   reflections = graph.create_image(VK_IMAGE_TYPE_2D, reflections_info, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT|VK_IMAGE_USAGE_STORAGE_BIT);
 
   gpu::ImageInfo blurred_info {VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT, w/2, h/2};
-  blurred_reflection = graph.create_image(VK_IMAGE_TYPE_2D, blurred_info, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT|VK_IMAGE_USAGE_STORAGE_BIT);
-  blurred_reflection_history = graph.create_image(VK_IMAGE_TYPE_2D, blurred_info, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT|VK_IMAGE_USAGE_STORAGE_BIT);
+  blurred_history = graph.create_history_image(VK_IMAGE_TYPE_2D, blurred_info, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT|VK_IMAGE_USAGE_STORAGE_BIT);
+  blurred_reflection = graph.get_current(blurred_history);
+  blurred_reflection_history = graph.get_previous(blurred_history);
   
   sampler = gpu::create_sampler(gpu::DEFAULT_SAMPLER);
+  sampler_index = gpu::get_sampler_index(sampler);
 
   const auto indirect_usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT|VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT|VK_BUFFER_USAGE_TRANSFER_DST_BIT;
   reflective_indirect = graph.create_buffer(VMA_MEMORY_USAGE_GPU_ONLY, sizeof(VkDispatchIndirectCommand), indirect_usage);
@@ -103,7 +105,7 @@ void AdvancedSSR::preintegrate_pdf(rendergraph::RenderGraph &graph) {
     },
     [=](Input &input, rendergraph::RenderResources &resources, gpu::CmdContext &cmd) {
       auto set = resources.allocate_set(preintegrate_pass, 0);
-      gpu::write_set(set, 
+      gpu::write_set(set, preintegrate_pass.get_update_template(0), 
         gpu::StorageTextureBinding {0, resources.get_view(input.out_pdf)});
 
       auto extent = resources.get_image(input.out_pdf)->get_extent();
@@ -124,7 +126,7 @@ void AdvancedSSR::preintegrate_brdf(rendergraph::RenderGraph &graph) {
     },
     [=](Input &input, rendergraph::RenderResources &resources, gpu::CmdContext &cmd) {
       auto set = resources.allocate_set(preintegrate_brdf_pass, 0);
-      gpu::write_set(set, 
+      gpu::write_set(set, preintegrate_brdf_pass.get_update_template(0), 
         gpu::UBOBinding {0, halton_buffer},
         gpu::StorageTextureBinding {1, resources.get_view(input.out_brdf)});
 
@@ -183,6 +185,7 @@ void AdvancedSSR::run_trace_pass(
 
   graph.add_task<Input>("SSSR_trace",
     [&](Input &input, rendergraph::RenderGraphBuilder &builder) {
+      builder.use_async_compute();
       input.depth = builder.sample_image(gbuff.depth, VK_SHADER_STAGE_COMPUTE_BIT, VK_IMAGE_ASPECT_DEPTH_BIT, 1, mips_count - 1, 0, 1);
       input.normal = builder.sample_image(gbuff.downsampled_normals, VK_SHADER_STAGE_COMPUTE_BIT);
       input.material = builder.sample_image(gbuff.material, VK_SHADER_STAGE_COMPUTE_BIT);
@@ -195,7 +198,7 @@ void AdvancedSSR::run_trace_pass(
       auto blk = cmd.allocate_ubo<TraceParams>();
       *blk.ptr = config;
 
-      gpu::write_set(set, 
+      gpu::write_set(set, trace_pass.get_update_template(0), 
         gpu::TextureBinding {0, resources.get_view(input.depth), sampler},
         gpu::TextureBinding {1, resources.get_view(input.normal), sampler},
         gpu::TextureBinding {2, resources.get_view(input.material), sampler},
@@ -250,6 +253,7 @@ void AdvancedSSR::run_trace_indirect_pass(
 
   graph.add_task<Input>("SSSR_trace",
     [&](Input &input, rendergraph::RenderGraphBuilder &builder) {
+      builder.use_async_compute();
       input.depth = builder.sample_image(gbuff.depth, VK_SHADER_STAGE_COMPUTE_BIT, VK_IMAGE_ASPECT_DEPTH_BIT, 1, mips_count - 1, 0, 1);
       input.normal = builder.sample_image(gbuff.downsampled_normals, VK_SHADER_STAGE_COMPUTE_BIT);
       input.material = builder.sample_image(gbuff.material, VK_SHADER_STAGE_COMPUTE_BIT);
@@ -267,7 +271,7 @@ void AdvancedSSR::run_trace_indirect_pass(
       auto blk = cmd.allocate_ubo<TraceParams>();
       *blk.ptr = config;
 
-      gpu::write_set(set_mirror, 
+      gpu::write_set(set_mirror, trace_indirect_pass.get_update_template(0), 
         gpu::TextureBinding {0, resources.get_view(input.depth), sampler},
         gpu::TextureBinding {1, resources.get_view(input.normal), sampler},
         gpu::TextureBinding {2, resources.get_view(input.material), sampler},
@@ -276,7 +280,7 @@ void AdvancedSSR::run_trace_indirect_pass(
         gpu::StorageTextureBinding {5, resources.get_view(input.out)},
         gpu::SSBOBinding {6, resources.get_buffer(reflective_tiles)});
       
-      gpu::write_set(set_glossy, 
+      gpu::write_set(set_glossy, trace_indirect_pass.get_update_template(0), 
         gpu::TextureBinding {0, resources.get_view(input.depth), sampler},
         gpu::TextureBinding {1, resources.get_view(input.normal), sampler},
         gpu::TextureBinding {2, resources.get_view(input.material), sampler},
@@ -330,15 +334,24 @@ void AdvancedSSR::run_filter_pass(
 
   struct PushConstants {
     uint32_t render_flags;
+    uint32_t rays_index;
+    uint32_t depth_index;
+    uint32_t albedo_index;
+    uint32_t normal_index;
+    uint32_t material_index;
+    uint32_t out_index;
+    uint32_t sampler_index;
   };
 
-  PushConstants pc {0u};
-  pc.render_flags |= settings.normalize_reflections? NORMALIZE_REFLECTIONS : 0;
-  pc.render_flags |= settings.accumulate_reflections? ACCUMULATE_REFLECTIONS : 0;
-  pc.render_flags |= settings.bilateral_filter? BILATERAL_FILTER : 0;
+  PushConstants push_consts {0u};
+  push_consts.render_flags |= settings.normalize_reflections? NORMALIZE_REFLECTIONS : 0;
+  push_consts.render_flags |= settings.accumulate_reflections? ACCUMULATE_REFLECTIONS : 0;
+  push_consts.render_flags |= settings.bilateral_filter? BILATERAL_FILTER : 0;
+  push_consts.sampler_index = sampler_index;
 
   graph.add_task<Input>("SSSR_filter",
     [&](Input &input, rendergraph::RenderGraphBuilder &builder) {
+      builder.use_async_compute();
       input.depth = builder.sample_image(gbuff.depth, VK_SHADER_STAGE_COMPUTE_BIT, VK_IMAGE_ASPECT_DEPTH_BIT, 0, 10, 0, 1);
       input.normal = builder.sample_image(gbuff.normal, VK_SHADER_STAGE_COMPUTE_BIT);
       input.albedo = builder.sample_image(gbuff.albedo, VK_SHADER_STAGE_COMPUTE_BIT);
@@ -347,22 +360,21 @@ void AdvancedSSR::run_filter_pass(
       input.reflection = builder.use_storage_image(reflections, VK_SHADER_STAGE_COMPUTE_BIT, 0, 0);
     },
     [=](Input &input, rendergraph::RenderResources &resources, gpu::CmdContext &cmd){
-      auto set = resources.allocate_set(filter_pass, 0);
       auto blk = cmd.allocate_ubo<TraceParams>();
       *blk.ptr = config;
 
-      gpu::write_set(set, 
-        gpu::TextureBinding {0, resources.get_view(input.rays), sampler},
-        gpu::TextureBinding {1, resources.get_view(input.depth), sampler},
-        gpu::TextureBinding {2, resources.get_view(input.albedo), sampler},
-        gpu::TextureBinding {3, resources.get_view(input.normal), sampler},
-        gpu::TextureBinding {4, resources.get_view(input.material), sampler},
-        gpu::StorageTextureBinding {5, resources.get_view(input.reflection)},
-        gpu::UBOBinding {6, cmd.get_ubo_pool(), blk});
+      auto pc = push_consts;
+      pc.rays_index = resources.get_sampled_index(input.rays);
+      pc.depth_index = resources.get_sampled_index(input.depth);
+      pc.albedo_index = resources.get_sampled_index(input.albedo);
+      pc.normal_index = resources.get_sampled_index(input.normal);
+      pc.material_index = resources.get_sampled_index(input.material);
+      pc.out_index = resources.get_storage_index(input.reflection);
       
       auto ext = resources.get_image(input.reflection)->get_extent();
       cmd.bind_pipeline(filter_pass);
-      cmd.bind_descriptors_compute(0, {set}, {blk.offset});
+      resources.bind_set(cmd, filter_pass, 0, {blk.offset},
+        gpu::UBOBinding {0, cmd.get_ubo_pool(), blk});
       cmd.push_constants_compute(0, sizeof(pc), &pc);
       cmd.dispatch((ext.width + 7)/8, (ext.height + 7)/8, 1);
     });
@@ -389,6 +401,15 @@ void AdvancedSSR::run_blur_pass(
     float max_roughness;
     uint32_t accumulate;
     uint32_t disable_blur;
+    uint32_t depth_index;
+    uint32_t normal_index;
+    uint32_t reflections_index;
+    uint32_t material_index;
+    uint32_t history_index;
+    uint32_t velocity_index;
+    uint32_t history_depth_index;
+    uint32_t result_index;
+    uint32_t sampler_index;
   };
 
   struct Params {
@@ -397,11 +418,13 @@ void AdvancedSSR::run_blur_pass(
     glm::vec4 fovy_aspect_znear_zfar;
   };
 
-  PushConstants pc {settings.max_rougness, settings.accumulate_reflections, !settings.use_blur}; 
+  PushConstants push_consts {settings.max_rougness, settings.accumulate_reflections, !settings.use_blur};
+  push_consts.sampler_index = sampler_index;
   Params buf {glm::inverse(taa_params.camera), glm::inverse(taa_params.prev_camera), taa_params.fovy_aspect_znear_zfar};
 
   graph.add_task<Input>("SSSR_blur",
     [&](Input &input, rendergraph::RenderGraphBuilder &builder){
+      builder.use_async_compute();
       input.depth = builder.sample_image(gbuff.depth, VK_SHADER_STAGE_COMPUTE_BIT, VK_IMAGE_ASPECT_DEPTH_BIT, 0, 10, 0, 1);
       input.normal = builder.sample_image(gbuff.normal, VK_SHADER_STAGE_COMPUTE_BIT);
       input.reflections = builder.sample_image(reflections, VK_SHADER_STAGE_COMPUTE_BIT);
@@ -415,23 +438,20 @@ void AdvancedSSR::run_blur_pass(
       auto blk = cmd.allocate_ubo<Params>();
       *blk.ptr = buf;
       
-      auto set = resources.allocate_set(blur_pass, 0);
-
-      gpu::write_set(set, 
-        gpu::TextureBinding {0, resources.get_view(input.depth), sampler},
-        gpu::TextureBinding {1, resources.get_view(input.normal), sampler},
-        gpu::TextureBinding {2, resources.get_view(input.reflections), sampler},
-        gpu::TextureBinding {3, resources.get_view(input.material), sampler},
-        gpu::TextureBinding {4, resources.get_view(input.history), sampler},
-        gpu::TextureBinding {5, resources.get_view(input.velocity), sampler},
-        gpu::TextureBinding {6, resources.get_view(input.history_depth), sampler},
-        gpu::StorageTextureBinding {7, resources.get_view(input.result)},
-        gpu::UBOBinding {8, cmd.get_ubo_pool(), blk}
-      );
+      auto pc = push_consts;
+      pc.depth_index = resources.get_sampled_index(input.depth);
+      pc.normal_index = resources.get_sampled_index(input.normal);
+      pc.reflections_index = resources.get_sampled_index(input.reflections);
+      pc.material_index = resources.get_sampled_index(input.material);
+      pc.history_index = resources.get_sampled_index(input.history);
+      pc.velocity_index = resources.get_sampled_index(input.velocity);
+      pc.history_depth_index = resources.get_sampled_index(input.history_depth);
+      pc.result_index = resources.get_storage_index(input.result);
       
       auto ext = resources.get_image(input.result)->get_extent();
       cmd.bind_pipeline(blur_pass);
-      cmd.bind_descriptors_compute(0, {set}, {blk.offset});
+      resources.bind_set(cmd, blur_pass, 0, {blk.offset},
+        gpu::UBOBinding {0, cmd.get_ubo_pool(), blk});
       cmd.push_constants_compute(0, sizeof(pc), &pc);
       cmd.dispatch((ext.width + 7)/8, (ext.height + 7)/8, 1);
     });
@@ -480,7 +500,7 @@ void AdvancedSSR::run_classification_pass(
     },
     [=](Input &input, rendergraph::RenderResources &resources, gpu::CmdContext &cmd) {
       auto set = resources.allocate_set(classification_pass, 0);
-      gpu::write_set(set,
+      gpu::write_set(set, classification_pass.get_update_template(0),
         gpu::TextureBinding {0, resources.get_view(input.material_tex), sampler},
         gpu::SSBOBinding {1, resources.get_buffer(reflective_tiles)},
         gpu::SSBOBinding {2, resources.get_buffer(glossy_tiles)},
@@ -511,12 +531,14 @@ void AdvancedSSR::run_tile_regression_pass(
     float aspect;
     float znear;
     float zfar;
+    uint32_t depth_index;
+    uint32_t planes_index;
   };
 
   auto extent = graph.get_descriptor(gbuff.depth).extent2D();
   extent.width /= 2;
   extent.height /= 2;
-  PushConstants pc {glm::transpose(params.normal_mat), params.fovy, params.aspect, params.znear, params.zfar};
+  PushConstants push_consts {glm::transpose(params.normal_mat), params.fovy, params.aspect, params.znear, params.zfar};
 
   graph.add_task<Input>("SSSR_Tile_Regression", 
     [&](Input &input, rendergraph::RenderGraphBuilder &builder) {
@@ -524,14 +546,11 @@ void AdvancedSSR::run_tile_regression_pass(
       input.planes_tex = builder.use_storage_image(tile_planes, VK_SHADER_STAGE_COMPUTE_BIT, 0, 0);
     },
     [=](Input &input, rendergraph::RenderResources &resources, gpu::CmdContext &cmd) {
-      auto set = resources.allocate_set(tile_regression, 0);
-      
-      gpu::write_set(set,
-        gpu::TextureBinding {0, resources.get_view(input.depth_tex), sampler},
-        gpu::StorageTextureBinding {1, resources.get_view(input.planes_tex)});
+      auto pc = push_consts;
+      pc.depth_index = resources.get_sampled_index(input.depth_tex);
+      pc.planes_index = resources.get_storage_index(input.planes_tex);
 
       cmd.bind_pipeline(tile_regression);
-      cmd.bind_descriptors_compute(0, {set});
       cmd.push_constants_compute(0, sizeof(pc), &pc);
       cmd.dispatch((extent.width + 7)/8, (extent.height + 7)/8, 1);
     });
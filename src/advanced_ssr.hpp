@@ -27,7 +27,6 @@ struct AdvancedSSR {
 
   void preintegrate_pdf(rendergraph::RenderGraph &graph);
   void preintegrate_brdf(rendergraph::RenderGraph &graph);
-  void remap_images(rendergraph::RenderGraph &graph) { graph.remap(blurred_reflection, blurred_reflection_history); }
 
   rendergraph::ImageResourceId get_ouput() const { return reflections; }
   rendergraph::ImageResourceId get_rays() const { return rays; }
@@ -54,11 +53,13 @@ private:
   gpu::ComputePipeline preintegrate_brdf_pass;
 
   VkSampler sampler;
+  uint32_t sampler_index;
 
   rendergraph::ImageResourceId rays;
   rendergraph::ImageResourceId reflections;
   rendergraph::ImageResourceId blurred_reflection;
   rendergraph::ImageResourceId blurred_reflection_history;
+  rendergraph::HistoryImageId blurred_history;
   rendergraph::ImageResourceId tile_planes;
   rendergraph::ImageResourceId rays_occlusion;
   rendergraph::ImageResourceId preintegrated_pdf;
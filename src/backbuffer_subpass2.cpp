@@ -32,7 +32,7 @@ void add_backbuffer_subpass(rendergraph::RenderGraph &graph, rendergraph::ImageR
       
       auto set = resources.allocate_set(pipeline.get_layout(0));
 
-      gpu::write_set(set,
+      gpu::write_set(set, pipeline.get_update_template(0),
         gpu::TextureBinding {0, resources.get_view(data.texture_view), sampler});
 
       VkRect2D scissors {{0, 0}, VkExtent2D {ext.width, ext.height}};
@@ -46,6 +46,7 @@ void add_backbuffer_subpass(rendergraph::RenderGraph &graph, rendergraph::ImageR
       cmd.bind_viewport(viewport);
       cmd.bind_scissors(scissors);
       cmd.draw(3, 1, 0, 0);
+      cmd.flush_renderpass();
       imgui_draw(cmd.get_command_buffer());
       cmd.end_renderpass();
     });
@@ -73,7 +74,7 @@ void add_backbuffer_subpass(rendergraph::RenderGraph &graph, gpu::ImagePtr &imag
       auto set = resources.allocate_set(pipeline.get_layout(0));
       auto range = gpu::make_image_range2D(0, ~0u);
 
-      gpu::write_set(set,
+      gpu::write_set(set, pipeline.get_update_template(0),
         gpu::TextureBinding {0, image->get_view(range), sampler});
 
       VkRect2D scissors {{0, 0}, VkExtent2D {ext.width, ext.height}};
@@ -87,6 +88,7 @@ void add_backbuffer_subpass(rendergraph::RenderGraph &graph, gpu::ImagePtr &imag
       cmd.bind_viewport(viewport);
       cmd.bind_scissors(scissors);
       cmd.draw(3, 1, 0, 0);
+      cmd.flush_renderpass();
       imgui_draw(cmd.get_command_buffer());
       cmd.end_renderpass();
     });
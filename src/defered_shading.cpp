@@ -23,6 +23,7 @@ DeferedShadingPass::DeferedShadingPass(rendergraph::RenderGraph &graph, SDL_Wind
   imgui_init(window, pipeline.get_renderpass());
 
   sampler = gpu::create_sampler(gpu::DEFAULT_SAMPLER);
+  sampler_index = gpu::get_sampler_index(sampler);
 
   ubo_consts = graph.create_buffer(
     VMA_MEMORY_USAGE_GPU_ONLY, 
@@ -68,8 +69,18 @@ void DeferedShadingPass::draw(rendergraph::RenderGraph &graph,
   struct PushConsts {
     glm::vec2 min_max_roughness;
     uint32_t show_ao;
+    uint32_t albedo_index;
+    uint32_t normal_index;
+    uint32_t material_index;
+    uint32_t depth_index;
+    uint32_t shadow_index;
+    uint32_t ssao_index;
+    uint32_t brdf_index;
+    uint32_t ssr_index;
+    uint32_t sampler_index;
   };
-  PushConsts pc {min_max_roughness, only_ao? 1u : 0u};
+  PushConsts constants {min_max_roughness, only_ao? 1u : 0u};
+  constants.sampler_index = sampler_index;
   pipeline.set_rendersubpass({false, {graph.get_descriptor(out_image).format}});
 
   graph.add_task<PassData>("DeferedShading",
@@ -88,18 +99,15 @@ void DeferedShadingPass::draw(rendergraph::RenderGraph &graph,
     },
     [=](PassData &input, rendergraph::RenderResources &resources, gpu::CmdContext &cmd){
       
-      auto set = resources.allocate_set(pipeline, 0);
-      
-      gpu::write_set(set,
-        gpu::TextureBinding {0, resources.get_view(input.albedo), sampler},
-        gpu::TextureBinding {1, resources.get_view(input.normal), sampler},
-        gpu::TextureBinding {2, resources.get_view(input.material), sampler},
-        gpu::TextureBinding {3, resources.get_view(input.depth), sampler},
-        gpu::UBOBinding {4, resources.get_buffer(input.ubo)}, 
-        gpu::TextureBinding {5, resources.get_view(input.shadow), sampler},
-        gpu::TextureBinding {6, resources.get_view(input.ssao), sampler},
-        gpu::TextureBinding {7, resources.get_view(input.brdf), sampler},
-        gpu::TextureBinding {8, resources.get_view(input.ssr), sampler});
+      auto pc = constants;
+      pc.albedo_index = resources.get_sampled_index(input.albedo);
+      pc.normal_index = resources.get_sampled_index(input.normal);
+      pc.material_index = resources.get_sampled_index(input.material);
+      pc.depth_index = resources.get_sampled_index(input.depth);
+      pc.shadow_index = resources.get_sampled_index(input.shadow);
+      pc.ssao_index = resources.get_sampled_index(input.ssao);
+      pc.brdf_index = resources.get_sampled_index(input.brdf);
+      pc.ssr_index = resources.get_sampled_index(input.ssr);
       
       const auto &image_info = resources.get_image(input.rt)->get_extent();
       auto w = image_info.width;
@@ -109,7 +117,8 @@ void DeferedShadingPass::draw(rendergraph::RenderGraph &graph,
       cmd.bind_pipeline(pipeline);
       cmd.bind_viewport(0.f, 0.f, float(w), float(h), 0.f, 1.f);
       cmd.bind_scissors(0, 0, w, h);
-      cmd.bind_descriptors_graphics(0, {set}, {0});
+      resources.bind_set(cmd, pipeline, 0, {0},
+        gpu::UBOBinding {0, resources.get_buffer(input.ubo)});
       cmd.push_constants_graphics(VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(pc), &pc);
       cmd.draw(3, 1, 0, 0);
       //imgui_draw(cmd.get_command_buffer());
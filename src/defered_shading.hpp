@@ -25,6 +25,7 @@ private:
 
   gpu::GraphicsPipeline pipeline;
   VkSampler sampler;
+  uint32_t sampler_index;
   rendergraph::BufferResourceId ubo_consts;
 
   glm::vec2 min_max_roughness {0.f, 1.f};
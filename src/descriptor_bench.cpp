@@ -0,0 +1,123 @@
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_vulkan.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+
+#include "gpu/gpu.hpp"
+
+//Writes the same TAA-like set N times with vkUpdateDescriptorSets and with an update template.
+//Needs a vulkan device: descriptor_bench [updates]
+
+using Clock = std::chrono::high_resolution_clock;
+
+struct BenchInit {
+  BenchInit() {
+    SDL_Init(SDL_INIT_VIDEO);
+    window = SDL_CreateWindow("descriptor_bench", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 64, 64, SDL_WINDOW_VULKAN|SDL_WINDOW_HIDDEN);
+
+    uint32_t count = 0;
+    SDL_Vulkan_GetInstanceExtensions(window, &count, nullptr);
+    std::vector<const char*> ext;
+    ext.resize(count);
+    SDL_Vulkan_GetInstanceExtensions(window, &count, ext.data());
+
+    gpu::InstanceConfig instance_info {};
+    instance_info.api_version = VK_API_VERSION_1_2;
+    instance_info.extensions.insert(ext.begin(), ext.end());
+    instance_info.extensions.insert(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+
+    gpu::DeviceConfig device_info {};
+    device_info.extensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+
+    gpu::init_all(instance_info, debug_cb, device_info, {64, 64}, [&](VkInstance instance){
+      VkSurfaceKHR surface;
+      SDL_Vulkan_CreateSurface(window, instance, &surface);
+      return surface;
+    });
+  }
+
+  ~BenchInit() {
+    gpu::close();
+    SDL_DestroyWindow(window);
+    SDL_Quit();
+  }
+
+  static VKAPI_ATTR VkBool32 VKAPI_CALL debug_cb(
+    VkDebugUtilsMessageSeverityFlagBitsEXT,
+    VkDebugUtilsMessageTypeFlagsEXT,
+    const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData,
+    void*)
+  {
+    std::cerr << "validation layer: " << pCallbackData->pMessage << std::endl;
+    return VK_FALSE;
+  }
+
+  SDL_Window *window;
+};
+
+static double elapsed_us(Clock::time_point start, uint32_t updates) {
+  return std::chrono::duration<double, std::micro>(Clock::now() - start).count()/updates;
+}
+
+static void run_bench(uint32_t updates) {
+  constexpr uint32_t TEXTURES_COUNT = 5;
+
+  gpu::DescriptorSetLayoutInfo info {};
+  for (uint32_t i = 0; i < TEXTURES_COUNT; i++) {
+    info.parse_resources(VK_SHADER_STAGE_COMPUTE_BIT, {0, i, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1});
+  }
+  info.parse_resources(VK_SHADER_STAGE_COMPUTE_BIT, {0, TEXTURES_COUNT, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1});
+  info.parse_resources(VK_SHADER_STAGE_COMPUTE_BIT, {0, TEXTURES_COUNT + 1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1});
+
+  gpu::DescriptorSetLayoutCache layouts;
+  auto layout_id = layouts.register_layout(info);
+  auto layout = layouts.get_layout(layout_id);
+  const auto &update_template = layouts.get_update_template(layout_id);
+
+  auto image = gpu::create_tex2d(VK_FORMAT_R16G16B16A16_SFLOAT, 64, 64, 1, VK_IMAGE_USAGE_SAMPLED_BIT|VK_IMAGE_USAGE_STORAGE_BIT);
+  auto view = image->get_view(gpu::ImageViewRange {});
+  auto sampler = gpu::create_sampler(gpu::DEFAULT_SAMPLER);
+  auto buffer = gpu::create_buffer(VMA_MEMORY_USAGE_CPU_TO_GPU, 256, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+
+  gpu::DescriptorPool pool {1};
+  auto set = pool.allocate_set(layout);
+
+  auto start = Clock::now();
+  for (uint32_t i = 0; i < updates; i++) {
+    gpu::write_set(set,
+      gpu::TextureBinding {0, view, sampler},
+      gpu::TextureBinding {1, view, sampler},
+      gpu::TextureBinding {2, view, sampler},
+      gpu::TextureBinding {3, view, sampler},
+      gpu::TextureBinding {4, view, sampler},
+      gpu::StorageTextureBinding {5, view},
+      gpu::UBOBinding {6, buffer});
+  }
+  double writes_us = elapsed_us(start, updates);
+
+  start = Clock::now();
+  for (uint32_t i = 0; i < updates; i++) {
+    gpu::DescriptorSetData data {update_template};
+    for (uint32_t t = 0; t < TEXTURES_COUNT; t++) {
+      data.set_texture(t, view, sampler);
+    }
+    data.set_storage_image(5, view);
+    data.set_buffer(6, buffer->api_buffer(), 0, buffer->get_size());
+    gpu::update_set(set, data);
+  }
+  double template_us = elapsed_us(start, updates);
+
+  std::cout << "Set of " << TEXTURES_COUNT + 2 << " bindings, " << updates << " updates\n";
+  std::cout << "  vkUpdateDescriptorSets:            " << writes_us << " us/update\n";
+  std::cout << "  vkUpdateDescriptorSetWithTemplate: " << template_us << " us/update\n";
+}
+
+int main(int argc, char **argv) {
+  uint32_t updates = (argc > 1)? std::stoul(argv[1]) : 10000;
+
+  BenchInit init {};
+  run_bench(updates);
+  return 0;
+}
@@ -71,7 +71,7 @@ void DownsamplePass::run_downsample_gbuff(
     },
     [=](Input &input, rendergraph::RenderResources &resources, gpu::CmdContext &cmd){
        auto set = resources.allocate_set(downsample_gbuffer, 0); 
-        gpu::write_set(set, 
+        gpu::write_set(set, downsample_gbuffer.get_update_template(0), 
           gpu::TextureBinding {0, resources.get_view(input.gbuffer_depth), sampler},
           gpu::TextureBinding {1, resources.get_view(input.gbuffer_normal), sampler},
           gpu::TextureBinding {2, resources.get_view(input.gbuffer_velocity), sampler});
@@ -112,7 +112,7 @@ void DownsamplePass::run_downsample_depth(
       },
       [=](Input &input, rendergraph::RenderResources &resources, gpu::CmdContext &cmd){
         auto set = resources.allocate_set(downsample_depth, 0); 
-        gpu::write_set(set, 
+        gpu::write_set(set, downsample_depth.get_update_template(0), 
           gpu::TextureBinding {0, resources.get_view(input.depth_tex), sampler});
 
         uint32_t w = desc.width/(1 << i), h = desc.height/(1 << i);
@@ -30,7 +30,7 @@ struct DrawDirs {
       [=](PassData &input, rendergraph::RenderResources &resources, gpu::CmdContext &cmd){
         auto set = resources.allocate_set(pipeline, 0);
     
-        gpu::write_set(set,
+        gpu::write_set(set, pipeline.get_update_template(0),
           gpu::StorageTextureBinding {0, resources.get_view(input.id)}
         );
 
@@ -0,0 +1,171 @@
+#include "bindless.hpp"
+
+#include <optional>
+#include <stdexcept>
+
+namespace gpu {
+
+  BindlessHeap::BindlessHeap() {
+    auto device = internal::app_vk_device();
+
+    VkDescriptorSetLayoutBinding bindings[BINDLESS_TYPES_COUNT];
+    VkDescriptorBindingFlags binding_flags[BINDLESS_TYPES_COUNT];
+    VkDescriptorPoolSize sizes[BINDLESS_TYPES_COUNT];
+
+    for (uint32_t i = 0; i < BINDLESS_TYPES_COUNT; i++) {
+      bindings[i] = VkDescriptorSetLayoutBinding {
+        .binding = i,
+        .descriptorType = BINDLESS_DESCRIPTOR_TYPES[i],
+        .descriptorCount = BINDLESS_DESCRIPTOR_COUNTS[i],
+        .stageFlags = VK_SHADER_STAGE_ALL,
+        .pImmutableSamplers = nullptr
+      };
+      //slots are written while frames in flight use other slots of the set
+      binding_flags[i] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT
+        |VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT
+        |VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+      sizes[i] = VkDescriptorPoolSize {BINDLESS_DESCRIPTOR_TYPES[i], BINDLESS_DESCRIPTOR_COUNTS[i]};
+    }
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo flags_info {
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+      .pNext = nullptr,
+      .bindingCount = BINDLESS_TYPES_COUNT,
+      .pBindingFlags = binding_flags
+    };
+
+    VkDescriptorSetLayoutCreateInfo layout_info {
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+      .pNext = &flags_info,
+      .flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT,
+      .bindingCount = BINDLESS_TYPES_COUNT,
+      .pBindings = bindings
+    };
+    VKCHECK(vkCreateDescriptorSetLayout(device, &layout_info, nullptr, &layout));
+
+    VkDescriptorPoolCreateInfo pool_info {
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+      .pNext = nullptr,
+      .flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT,
+      .maxSets = 1,
+      .poolSizeCount = BINDLESS_TYPES_COUNT,
+      .pPoolSizes = sizes
+    };
+    VKCHECK(vkCreateDescriptorPool(device, &pool_info, nullptr, &pool));
+
+    VkDescriptorSetAllocateInfo alloc_info {
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+      .pNext = nullptr,
+      .descriptorPool = pool,
+      .descriptorSetCount = 1,
+      .pSetLayouts = &layout
+    };
+    VKCHECK(vkAllocateDescriptorSets(device, &alloc_info, &set));
+  }
+
+  BindlessHeap::~BindlessHeap() {
+    auto device = internal::app_vk_device();
+    if (pool) {
+      vkDestroyDescriptorPool(device, pool, nullptr);
+    }
+    if (layout) {
+      vkDestroyDescriptorSetLayout(device, layout, nullptr);
+    }
+  }
+
+  uint32_t BindlessHeap::add_sampled_image(VkImageView view) {
+    return write(BindlessType::SampledImage, {nullptr, view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL});
+  }
+
+  uint32_t BindlessHeap::add_storage_image(VkImageView view) {
+    return write(BindlessType::StorageImage, {nullptr, view, VK_IMAGE_LAYOUT_GENERAL});
+  }
+
+  uint32_t BindlessHeap::add_sampler(VkSampler sampler) {
+    return write(BindlessType::Sampler, {sampler, nullptr, VK_IMAGE_LAYOUT_UNDEFINED});
+  }
+
+  uint32_t BindlessHeap::write(BindlessType type, const VkDescriptorImageInfo &info) {
+    auto binding = uint32_t(type);
+    std::lock_guard guard {lock};
+
+    auto &type_slots = slots[binding];
+    uint32_t index = INVALID_BINDLESS_INDEX;
+    if (type_slots.free_list.size()) {
+      index = type_slots.free_list.back();
+      type_slots.free_list.pop_back();
+    } else if (type_slots.next < BINDLESS_DESCRIPTOR_COUNTS[binding]) {
+      index = type_slots.next++;
+    } else {
+      return INVALID_BINDLESS_INDEX;
+    }
+
+    VkWriteDescriptorSet desc_write {
+      .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+      .pNext = nullptr,
+      .dstSet = set,
+      .dstBinding = binding,
+      .dstArrayElement = index,
+      .descriptorCount = 1,
+      .descriptorType = BINDLESS_DESCRIPTOR_TYPES[binding],
+      .pImageInfo = &info,
+      .pBufferInfo = nullptr,
+      .pTexelBufferView = nullptr
+    };
+    vkUpdateDescriptorSets(internal::app_vk_device(), 1, &desc_write, 0, nullptr);
+    writes++;
+    return index;
+  }
+
+  void BindlessHeap::release(BindlessType type, uint32_t index) {
+    if (index == INVALID_BINDLESS_INDEX) {
+      return;
+    }
+    std::lock_guard guard {lock};
+    slots[uint32_t(type)].released.push_back({index, frame});
+  }
+
+  void BindlessHeap::flip() {
+    std::lock_guard guard {lock};
+    frame++;
+
+    for (auto &type_slots : slots) {
+      auto &released = type_slots.released;
+      uint32_t kept = 0;
+      for (uint32_t i = 0; i < released.size(); i++) {
+        if (released[i].second + REUSE_DELAY <= frame) {
+          type_slots.free_list.push_back(released[i].first);
+        } else {
+          released[kept++] = released[i];
+        }
+      }
+      released.resize(kept);
+    }
+  }
+
+  BindlessStats BindlessHeap::get_stats() {
+    std::lock_guard guard {lock};
+    BindlessStats stats {};
+    for (uint32_t i = 0; i < BINDLESS_TYPES_COUNT; i++) {
+      const auto &type_slots = slots[i];
+      stats.used[i] = type_slots.next - type_slots.free_list.size() - type_slots.released.size();
+    }
+    stats.writes = writes;
+    return stats;
+  }
+
+  static std::optional<BindlessHeap> g_bindless_heap;
+
+  void create_bindless_heap() {
+    g_bindless_heap.emplace();
+  }
+
+  void destroy_bindless_heap() {
+    g_bindless_heap.reset();
+  }
+
+  BindlessHeap *app_bindless_heap() {
+    return g_bindless_heap.has_value()? &g_bindless_heap.value() : nullptr;
+  }
+
+}
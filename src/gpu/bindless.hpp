@@ -0,0 +1,89 @@
+#ifndef GPU_BINDLESS_HPP_INCLUDED
+#define GPU_BINDLESS_HPP_INCLUDED
+
+#include "driver.hpp"
+
+#include <array>
+#include <mutex>
+#include <vector>
+
+namespace gpu {
+
+  //set of the global heap in shaders (shaders/include/bindless.glsl), below the minimal maxBoundDescriptorSets
+  constexpr uint32_t BINDLESS_SET = 3;
+  constexpr uint32_t INVALID_BINDLESS_INDEX = UINT32_MAX;
+
+  //binding of the heap set
+  enum class BindlessType : uint32_t {
+    SampledImage = 0,
+    Sampler = 1,
+    StorageImage = 2
+  };
+
+  constexpr uint32_t BINDLESS_TYPES_COUNT = 3;
+
+  constexpr VkDescriptorType BINDLESS_DESCRIPTOR_TYPES[BINDLESS_TYPES_COUNT] {
+    VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+    VK_DESCRIPTOR_TYPE_SAMPLER,
+    VK_DESCRIPTOR_TYPE_STORAGE_IMAGE
+  };
+
+  constexpr uint32_t BINDLESS_DESCRIPTOR_COUNTS[BINDLESS_TYPES_COUNT] {8192, 256, 4096};
+
+  struct BindlessStats {
+    std::array<uint32_t, BINDLESS_TYPES_COUNT> used {};
+    //descriptors written since start, only new views and samplers are written
+    uint64_t writes = 0;
+  };
+
+  //One update-after-bind set shared by programs which declare BINDLESS_SET. Views and samplers get
+  //stable indices on creation and their descriptors are written once. Released indices are reused
+  //after REUSE_DELAY flips, so slots used by frames in flight are not rewritten
+  struct BindlessHeap {
+    static constexpr uint32_t REUSE_DELAY = 4;
+
+    BindlessHeap();
+    ~BindlessHeap();
+
+    //INVALID_BINDLESS_INDEX if the heap is full
+    uint32_t add_sampled_image(VkImageView view);
+    uint32_t add_storage_image(VkImageView view);
+    uint32_t add_sampler(VkSampler sampler);
+    void release(BindlessType type, uint32_t index);
+    //once per frame
+    void flip();
+
+    VkDescriptorSetLayout get_layout() const { return layout; }
+    VkDescriptorSet get_set() const { return set; }
+    BindlessStats get_stats();
+
+    BindlessHeap(const BindlessHeap&) = delete;
+    BindlessHeap &operator=(const BindlessHeap&) = delete;
+  private:
+    struct Slots {
+      uint32_t next = 0;
+      std::vector<uint32_t> free_list;
+      //index and frame of release
+      std::vector<std::pair<uint32_t, uint64_t>> released;
+    };
+
+    VkDescriptorPool pool {nullptr};
+    VkDescriptorSetLayout layout {nullptr};
+    VkDescriptorSet set {nullptr};
+
+    std::mutex lock;
+    std::array<Slots, BINDLESS_TYPES_COUNT> slots;
+    uint64_t frame = 0;
+    uint64_t writes = 0;
+
+    uint32_t write(BindlessType type, const VkDescriptorImageInfo &info);
+  };
+
+  void create_bindless_heap();
+  void destroy_bindless_heap();
+  //nullptr without device, images and samplers created then get no indices
+  BindlessHeap *app_bindless_heap();
+
+}
+
+#endif
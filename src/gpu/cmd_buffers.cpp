@@ -75,7 +75,10 @@ namespace gpu {
   }
   
   void CmdContext::end() {
-    end_renderpass();
+    keep_open = false;
+    close_renderpass();
+    attachment_usages.clear();
+    usages_begun.clear();
     
     fb_state.set_width(0);
 
@@ -86,6 +89,10 @@ namespace gpu {
     state.cmp_pipeline = nullptr;
     state.gfx_layout = nullptr;
     state.gfx_pipeline = nullptr;
+    state.gfx_skipped = false;
+    state.cmp_skipped = false;
+    state.gfx_heap_layout = nullptr;
+    state.cmp_heap_layout = nullptr;
 
     VKCHECK(vkEndCommandBuffer(cmd));
   }
@@ -137,7 +144,7 @@ namespace gpu {
     //recreate framebuffer
 
     if (reset_renderpass) {
-      end_renderpass();
+      close_renderpass();
 
       if (fb_state.is_dirty()) {
         flush_framebuffer_state(renderpass);
@@ -147,24 +154,17 @@ namespace gpu {
         throw std::runtime_error {"Attempt to bind graphics pipeline without framebuffer"};
       }
 
-      VkRenderPassBeginInfo info {
-        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-        .pNext = nullptr,
-        .renderPass = renderpass,
-        .framebuffer = state.framebuffer,
-        .renderArea = {{0, 0}, {fb_state.get_width(), fb_state.get_height()}},
-        .clearValueCount = 0,
-        .pClearValues = nullptr
-      };
-
-      vkCmdBeginRenderPass(cmd, &info, VK_SUBPASS_CONTENTS_INLINE);
       state.renderpass = renderpass;
     }
+    state.renderpass_ended = false;
+
+    state.gfx_layout = gfx_pipeline->get_pipeline_layout();
+    state.gfx_skipped = !api_pipeline;
+    bind_bindless_heap(VK_PIPELINE_BIND_POINT_GRAPHICS, gfx_pipeline->uses_bindless_heap(), state.gfx_layout, state.gfx_heap_layout);
 
-    if (change_pipeline) {
+    if (change_pipeline && api_pipeline) {
       vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, api_pipeline);
       state.gfx_pipeline = api_pipeline;
-      state.gfx_layout = gfx_pipeline->get_pipeline_layout();
     }
   }
   
@@ -184,27 +184,56 @@ namespace gpu {
 
     state.cmp_layout = pipeline.get_pipeline_layout();
     auto api_pipeline = cmp_pipeline->get_pipeline();
+    state.cmp_skipped = !api_pipeline;
+    bind_bindless_heap(VK_PIPELINE_BIND_POINT_COMPUTE, cmp_pipeline->uses_bindless_heap(), state.cmp_layout, state.cmp_heap_layout);
     
-    if (api_pipeline != state.cmp_pipeline) {
+    if (api_pipeline && api_pipeline != state.cmp_pipeline) {
       state.cmp_pipeline = api_pipeline;
       vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, state.cmp_pipeline);
     }
   }
 
+  //binding sets with a layout which has no heap may disturb it, so the heap is rebound after such layouts
+  void CmdContext::bind_bindless_heap(VkPipelineBindPoint bind_point, bool uses_heap, VkPipelineLayout layout, VkPipelineLayout &heap_layout) {
+    if (!uses_heap) {
+      heap_layout = nullptr;
+      return;
+    }
+    if (heap_layout == layout) {
+      return;
+    }
+
+    auto set = app_bindless_heap()->get_set();
+    vkCmdBindDescriptorSets(cmd, bind_point, layout, BINDLESS_SET, 1, &set, 0, nullptr);
+    heap_layout = layout;
+  }
+
   void CmdContext::draw(uint32_t vertex_count, uint32_t instance_count, uint32_t first_vertex, uint32_t first_instance) {
-    vkCmdDraw(cmd, vertex_count, instance_count, first_vertex, first_instance);
+    begin_renderpass();
+    if (!state.gfx_skipped) {
+      vkCmdDraw(cmd, vertex_count, instance_count, first_vertex, first_instance);
+    }
   }
 
   void CmdContext::draw_indexed(uint32_t index_count, uint32_t instance_count, uint32_t first_index, uint32_t vertex_offset, uint32_t first_instance) {
-    vkCmdDrawIndexed(cmd, index_count, instance_count, first_index, vertex_offset, first_instance);
+    begin_renderpass();
+    if (!state.gfx_skipped) {
+      vkCmdDrawIndexed(cmd, index_count, instance_count, first_index, vertex_offset, first_instance);
+    }
   }
   
   void CmdContext::dispatch(uint32_t groups_x, uint32_t groups_y, uint32_t groups_z) {
-    vkCmdDispatch(cmd, groups_x, groups_y, groups_z);
+    close_renderpass();
+    if (!state.cmp_skipped) {
+      vkCmdDispatch(cmd, groups_x, groups_y, groups_z);
+    }
   }
 
   void CmdContext::dispatch_indirect(VkBuffer buffer, VkDeviceSize offset) {
-    vkCmdDispatchIndirect(cmd, buffer, offset);
+    close_renderpass();
+    if (!state.cmp_skipped) {
+      vkCmdDispatchIndirect(cmd, buffer, offset);
+    }
   }
 
   void CmdContext::flush_framebuffer_state(VkRenderPass renderpass) {
@@ -212,9 +241,91 @@ namespace gpu {
   }
 
   void CmdContext::end_renderpass() {
-    if (state.renderpass) {
+    if (keep_open && state.renderpass) {
+      state.renderpass_ended = true;
+      return;
+    }
+    close_renderpass();
+  }
+
+  void CmdContext::close_renderpass() {
+    if (!state.renderpass) {
+      return;
+    }
+
+    //render pass without draws is skipped unless it has to clear attachments
+    if (!state.renderpass_begun && clear_mask) {
+      begin_renderpass();
+    }
+
+    if (state.renderpass_begun) {
       vkCmdEndRenderPass(cmd);
-      state.renderpass = nullptr;
+    }
+
+    state.renderpass = nullptr;
+    state.renderpass_begun = false;
+    state.renderpass_ended = false;
+    clear_mask = 0;
+  }
+
+  void CmdContext::begin_renderpass() {
+    if (!state.renderpass || state.renderpass_begun) {
+      return;
+    }
+
+    uint32_t count = fb_state.get_attachments_count();
+    renderpass_ops.assign(count, AttachmentOps {});
+    bool default_ops = true;
+
+    for (uint32_t i = 0; i < count; i++) {
+      auto &ops = renderpass_ops[i];
+      auto image = fb_state.get_attachment_id(i);
+      const auto &range = fb_state.get_attachment_range(i);
+
+      for (uint32_t u = 0; u < attachment_usages.size(); u++) {
+        const auto &usage = attachment_usages[u];
+        if (usage.image != image || usage.mip != range.base_mip || usage.layer != range.base_layer) {
+          continue;
+        }
+
+        ops = usage.ops;
+        if (usages_begun[u]) {
+          ops.load = VK_ATTACHMENT_LOAD_OP_LOAD;
+        }
+        usages_begun[u] = true;
+        break;
+      }
+
+      if (clear_mask & (1u << i)) {
+        ops.load = VK_ATTACHMENT_LOAD_OP_CLEAR;
+      }
+      default_ops &= ops.is_default();
+    }
+
+    VkRenderPassBeginInfo info {
+      .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+      .pNext = nullptr,
+      .renderPass = default_ops? state.renderpass : gfx_pipeline->get_renderpass(renderpass_ops),
+      .framebuffer = state.framebuffer,
+      .renderArea = {{0, 0}, {fb_state.get_width(), fb_state.get_height()}},
+      .clearValueCount = clear_mask? count : 0,
+      .pClearValues = clear_mask? clear_values : nullptr
+    };
+
+    vkCmdBeginRenderPass(cmd, &info, VK_SUBPASS_CONTENTS_INLINE);
+    state.renderpass_begun = true;
+  }
+
+  void CmdContext::set_attachment_ops(const std::vector<AttachmentUsage> &usages) {
+    attachment_usages = usages;
+    usages_begun.assign(usages.size(), false);
+  }
+
+  void CmdContext::flush_renderpass() {
+    if (state.renderpass_ended) {
+      close_renderpass();
+    } else {
+      begin_renderpass();
     }
   }
     
@@ -234,6 +345,35 @@ namespace gpu {
     bind_descriptors_graphics(first_set, sets, {});
   }
 
+  void CmdContext::push_descriptors(VkPipelineBindPoint bind_point, uint32_t set, VkWriteDescriptorSet *writes, uint32_t count, const std::initializer_list<uint32_t> &offsets) {
+    std::sort(writes, writes + count, [](const auto &a, const auto &b){
+      return a.dstBinding < b.dstBinding;
+    });
+
+    VkDescriptorBufferInfo buffer_info[MAX_BINDINGS];
+    auto offset = offsets.begin();
+
+    for (uint32_t i = 0; i < count; i++) {
+      auto &write = writes[i];
+      bool dynamic_ubo = write.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+      if (!dynamic_ubo && write.descriptorType != VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC) {
+        continue;
+      }
+
+      if (offset == offsets.end() || write.descriptorCount != 1 || i >= MAX_BINDINGS) {
+        throw std::runtime_error {"Dynamic offset is missing for pushed buffer"};
+      }
+
+      buffer_info[i] = *write.pBufferInfo;
+      buffer_info[i].offset += *(offset++);
+      write.pBufferInfo = &buffer_info[i];
+      write.descriptorType = dynamic_ubo? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    }
+
+    auto layout = (bind_point == VK_PIPELINE_BIND_POINT_COMPUTE)? state.cmp_layout : state.gfx_layout;
+    vkCmdPushDescriptorSetKHR(cmd, bind_point, layout, set, count, writes);
+  }
+
   void CmdContext::bind_viewport(VkViewport viewport) {
     vkCmdSetViewport(cmd, 0, 1, &viewport);
   }
@@ -251,6 +391,7 @@ namespace gpu {
   }
 
   void CmdContext::update_buffer(VkBuffer target, VkDeviceSize offset, VkDeviceSize data_size, const void *src) {
+    close_renderpass();
     vkCmdUpdateBuffer(cmd, target, offset, data_size, src);
   }
 
@@ -273,6 +414,14 @@ namespace gpu {
       count--;
     }
 
+    if (state.renderpass && !state.renderpass_begun) {
+      for (uint32_t i = 0; i < count; i++) {
+        clear_values[i].color = {{r, g, b, a}};
+        clear_mask |= 1u << i;
+      }
+      return;
+    }
+
     VkClearAttachment clear {
       .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
       .colorAttachment = 0,
@@ -300,6 +449,12 @@ namespace gpu {
 
     uint32_t index = desc.formats.size() - 1;
 
+    if (state.renderpass && !state.renderpass_begun) {
+      clear_values[index].depthStencil = {val, 0u};
+      clear_mask |= 1u << index;
+      return;
+    }
+
     VkClearAttachment clear {
       .aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT,
       .colorAttachment = index,
@@ -415,7 +570,10 @@ namespace gpu {
       .pSignalSemaphores = nullptr
     };
 
-    VKCHECK(vkQueueSubmit(api_queue, 1, &submit_info, fence));
+    {
+      std::scoped_lock lock {app_queue_lock()};
+      VKCHECK(vkQueueSubmit(api_queue, 1, &submit_info, fence));
+    }
     VKCHECK(vkWaitForFences(api_device, 1, &fence, VK_TRUE, UINT64_MAX));
     VKCHECK(vkResetFences(api_device, 1, &fence));
     VKCHECK(vkResetCommandBuffer(cmd, VK_COMMAND_BUFFER_RESET_RELEASE_RESOURCES_BIT));
@@ -439,7 +597,9 @@ namespace gpu {
     state {o.state},
     fb_state {std::move(o.fb_state)},
     ubo_pool {std::move(o.ubo_pool)},
-    delayed_free {std::move(o.delayed_free)}
+    delayed_free {std::move(o.delayed_free)},
+    attachment_usages {std::move(o.attachment_usages)},
+    usages_begun {std::move(o.usages_begun)}
   {
     o.state.framebuffer = nullptr;
     o.cmd = nullptr;
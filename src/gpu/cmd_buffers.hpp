@@ -126,6 +126,14 @@ namespace gpu {
     VkCommandBuffer cmd;
   };
 
+  //load/store ops for a framebuffer attachment, matched by image, mip and layer
+  struct AttachmentUsage {
+    DriverResourceID image;
+    uint32_t mip = 0;
+    uint32_t layer = 0;
+    AttachmentOps ops {};
+  };
+
   constexpr uint64_t UBO_POOL_SIZE = 16 * (1 << 10); //16Kb
 
   struct CmdContextPool {
@@ -169,15 +177,41 @@ namespace gpu {
 
     void set_framebuffer(uint32_t width, uint32_t height, const std::initializer_list<std::pair<DriverResourceID, ImageViewRange>> &attachments);
 
+    //with async pool compilation a pipeline may be not ready yet, then its draws or dispatches are skipped
     void bind_pipeline(const GraphicsPipeline &pipeline);
     void bind_pipeline(const ComputePipeline &pipeline);
     void end_renderpass();
 
+    //ops are applied to the first render pass using the attachment, later render passes load it.
+    //Attachments without ops are loaded and stored
+    void set_attachment_ops(const std::vector<AttachmentUsage> &usages);
+    //while set, end_renderpass leaves render pass open for the next task with the same framebuffer.
+    //Commands which are not allowed inside a render pass close it
+    void keep_renderpass(bool keep) { keep_open = keep; }
+
     void bind_descriptors_compute(uint32_t first_set, const std::initializer_list<VkDescriptorSet> &sets, const std::initializer_list<uint32_t> offsets);
     void bind_descriptors_graphics(uint32_t first_set, const std::initializer_list<VkDescriptorSet> &sets, const std::initializer_list<uint32_t> offsets);
     void bind_descriptors_compute(uint32_t first_set, const std::initializer_list<VkDescriptorSet> &sets);
     void bind_descriptors_graphics(uint32_t first_set, const std::initializer_list<VkDescriptorSet> &sets);
 
+    //set of the bound pipeline must be a push descriptor one, nothing is allocated. Dynamic buffers
+    //are pushed as plain ones, offsets are added to them in binding order like dynamic offsets
+    template <typename... Bindings>
+    void push_descriptors_compute(uint32_t set, const std::initializer_list<uint32_t> &offsets, const Bindings&... bindings) {
+      constexpr auto count = sizeof...(bindings);
+      VkWriteDescriptorSet writes[count];
+      internal::write_set_base(VK_NULL_HANDLE, VK_NULL_HANDLE, writes, bindings...);
+      push_descriptors(VK_PIPELINE_BIND_POINT_COMPUTE, set, writes, count, offsets);
+    }
+
+    template <typename... Bindings>
+    void push_descriptors_graphics(uint32_t set, const std::initializer_list<uint32_t> &offsets, const Bindings&... bindings) {
+      constexpr auto count = sizeof...(bindings);
+      VkWriteDescriptorSet writes[count];
+      internal::write_set_base(VK_NULL_HANDLE, VK_NULL_HANDLE, writes, bindings...);
+      push_descriptors(VK_PIPELINE_BIND_POINT_GRAPHICS, set, writes, count, offsets);
+    }
+
     void bind_viewport(VkViewport viewport);
     void bind_scissors(VkRect2D scissors);
     void bind_viewport(float x, float y, float w, float h, float min_d, float max_d) { bind_viewport({x, y, w, h, min_d, max_d}); }
@@ -209,6 +243,8 @@ namespace gpu {
     
     void signal_event(VkEvent event, VkPipelineStageFlags stages);
 
+    //call before raw commands: the bound render pass is begun, one which was ended but kept open is closed
+    void flush_renderpass();
     VkCommandBuffer get_command_buffer() const { return cmd; }
     void clear_resources();
 
@@ -228,12 +264,21 @@ namespace gpu {
     std::optional<ComputePipeline> cmp_pipeline {};
 
     struct BindedState {
+      //render pass is begun by the first draw, so clears recorded before become load ops
       VkRenderPass renderpass = nullptr;
+      bool renderpass_begun = false;
+      bool renderpass_ended = false;
       VkFramebuffer framebuffer = nullptr;
       VkPipeline gfx_pipeline = nullptr;
       VkPipelineLayout gfx_layout = nullptr;
       VkPipeline cmp_pipeline = nullptr;
       VkPipelineLayout cmp_layout = nullptr;
+      //layouts the bindless heap was bound with
+      VkPipelineLayout gfx_heap_layout = nullptr;
+      VkPipelineLayout cmp_heap_layout = nullptr;
+      //bound pipeline is still compiling, draws and dispatches are dropped until the next bind
+      bool gfx_skipped = false;
+      bool cmp_skipped = false;
     } state {};
 
     FramebufferState fb_state;
@@ -243,7 +288,18 @@ namespace gpu {
     std::vector<CtxResource*> delayed_free {};
     std::shared_ptr<DescriptorBinder> binder_state; 
 
+    bool keep_open = false;
+    std::vector<AttachmentUsage> attachment_usages;
+    std::vector<bool> usages_begun;
+    std::vector<AttachmentOps> renderpass_ops;
+    uint32_t clear_mask = 0;
+    VkClearValue clear_values[MAX_ATTACHMENTS] {};
+
+    void bind_bindless_heap(VkPipelineBindPoint bind_point, bool uses_heap, VkPipelineLayout layout, VkPipelineLayout &heap_layout);
+    void push_descriptors(VkPipelineBindPoint bind_point, uint32_t set, VkWriteDescriptorSet *writes, uint32_t count, const std::initializer_list<uint32_t> &offsets);
     void flush_framebuffer_state(VkRenderPass renderpass);
+    void begin_renderpass();
+    void close_renderpass();
   };
 
   struct TransferCmdPool {
@@ -16,6 +16,16 @@ namespace gpu {
     std::hash<T> h;
     s ^= h(v) + 0x9e3779b9 + (s<< 6) + (s>> 2); 
   }
+
+  //FNV-1a, stable between runs, for file contents
+  inline uint64_t hash_bytes(const void *data, std::size_t size) {
+    auto bytes = static_cast<const uint8_t*>(data);
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (std::size_t i = 0; i < size; i++) {
+      hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+    }
+    return hash;
+  }
 }
 
 #endif
\ No newline at end of file
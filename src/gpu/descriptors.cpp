@@ -1,5 +1,6 @@
 #include "descriptors.hpp"
 #include "shader.hpp"
+#include "gpu.hpp"
 
 namespace gpu {
 
@@ -271,4 +272,143 @@ namespace gpu {
 
   }
 
-}
\ No newline at end of file
+  DescriptorSetCache::DescriptorSetCache(uint32_t frames_count)
+    : frames_count {frames_count}, layouts_generation {app_pipelines().get_layouts_generation()} {}
+
+  DescriptorSetCache::~DescriptorSetCache() {
+    chain.destroy();
+  }
+
+  void DescriptorSetCache::build_key(VkDescriptorSetLayout layout, const DriverResourceID *deps, uint32_t deps_count, const VkWriteDescriptorSet *writes, uint32_t writes_count) {
+    key.clear();
+    key.push_back(uint64_t(layout));
+    key.push_back(deps_count);
+    for (uint32_t i = 0; i < deps_count; i++) {
+      key.push_back(deps[i].get_key());
+    }
+
+    for (uint32_t i = 0; i < writes_count; i++) {
+      const auto &write = writes[i];
+      key.push_back((uint64_t(write.dstBinding) << 32u) | write.dstArrayElement);
+      key.push_back((uint64_t(write.descriptorCount) << 32u) | uint32_t(write.descriptorType));
+
+      if (is_image_desc(write.descriptorType)) {
+        for (uint32_t elem = 0; elem < write.descriptorCount; elem++) {
+          const auto &info = write.pImageInfo[elem];
+          key.push_back(uint64_t(info.sampler));
+          key.push_back(uint64_t(info.imageView));
+          key.push_back(uint64_t(info.imageLayout));
+        }
+      } else if (is_bufer_desc(write.descriptorType)) {
+        for (uint32_t elem = 0; elem < write.descriptorCount; elem++) {
+          const auto &info = write.pBufferInfo[elem];
+          key.push_back(uint64_t(info.buffer));
+          key.push_back(info.offset);
+          key.push_back(info.range);
+        }
+      } else if (is_as_desc(write.descriptorType)) {
+        auto as_info = static_cast<const VkWriteDescriptorSetAccelerationStructureKHR *>(write.pNext);
+        for (uint32_t elem = 0; elem < as_info->accelerationStructureCount; elem++) {
+          key.push_back(uint64_t(as_info->pAccelerationStructures[elem]));
+        }
+      } else {
+        throw std::runtime_error {"Descriptor type is not supported by cache"};
+      }
+    }
+  }
+
+  VkDescriptorSet DescriptorSetCache::get_set(VkDescriptorSetLayout layout, const DriverResourceID *deps, uint32_t deps_count, VkWriteDescriptorSet *writes, uint32_t writes_count) {
+    //full shader reload destroys layouts, new ones may get the same handles
+    auto generation = app_pipelines().get_layouts_generation();
+    if (generation != layouts_generation) {
+      layouts_generation = generation;
+      retire_all();
+    }
+
+    build_key(layout, deps, deps_count, writes, writes_count);
+
+    auto iter = entries.find(key);
+    if (iter != entries.end()) {
+      stats.hits++;
+      iter->second.last_used = frame;
+      return iter->second.set;
+    }
+
+    stats.misses++;
+    VkDescriptorSetAllocateInfo info {
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+      .pNext = nullptr,
+      .descriptorPool = VK_NULL_HANDLE,
+      .descriptorSetCount = 1,
+      .pSetLayouts = &layout
+    };
+
+    Entry entry {};
+    entry.usage = get_layout_usage(layout);
+    entry.block = chain.allocate(info, entry.usage, {}, &entry.set);
+    entry.last_used = frame;
+    entry.deps.assign(deps, deps + deps_count);
+
+    for (uint32_t i = 0; i < writes_count; i++) {
+      writes[i].dstSet = entry.set;
+    }
+    vkUpdateDescriptorSets(internal::app_vk_device(), writes_count, writes, 0, nullptr);
+
+    auto set = entry.set;
+    entries.emplace(key, std::move(entry));
+    stats.entries = entries.size();
+    return set;
+  }
+
+  void DescriptorSetCache::flip() {
+    frame++;
+
+    //sets of frames older than frames_count are not used by gpu anymore
+    auto write_pos = retired.begin();
+    for (auto &elem : retired) {
+      if (elem.frame + frames_count < frame) {
+        VKCHECK(vkFreeDescriptorSets(internal::app_vk_device(), chain.get_block(elem.block), 1, &elem.set));
+        chain.release(elem.usage);
+      } else {
+        *write_pos++ = elem;
+      }
+    }
+    retired.erase(write_pos, retired.end());
+
+    for (auto iter = entries.begin(); iter != entries.end();) {
+      auto &entry = iter->second;
+      bool expired = entry.last_used + MAX_UNUSED_FRAMES < frame;
+      for (uint32_t i = 0; i < entry.deps.size() && !expired; i++) {
+        expired = !is_resource_alive(entry.deps[i]);
+      }
+
+      if (expired) {
+        retire(entry);
+        iter = entries.erase(iter);
+      } else {
+        ++iter;
+      }
+    }
+    stats.entries = entries.size();
+  }
+
+  void DescriptorSetCache::retire(const Entry &entry) {
+    retired.push_back(RetiredSet {entry.set, entry.block, entry.usage, entry.last_used});
+  }
+
+  void DescriptorSetCache::retire_all() {
+    for (auto &[entry_key, entry] : entries) {
+      retire(entry);
+    }
+    entries.clear();
+    stats.entries = 0;
+  }
+
+  void DescriptorSetCache::clear() {
+    chain.reset();
+    entries.clear();
+    retired.clear();
+    stats.entries = 0;
+  }
+
+}
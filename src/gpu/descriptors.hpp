@@ -5,8 +5,11 @@
 #include "dynbuffer.hpp"
 #include "pipelines.hpp"
 #include "managed_resources.hpp"
+#include "shader.hpp"
 
 #include <bitset>
+#include <cstring>
+#include <unordered_map>
 
 namespace gpu {
   struct BaseBinding;
@@ -206,6 +209,209 @@ namespace gpu {
     }
   }
 
+  //descriptor infos packed as the update template of a set layout expects, the whole set is written
+  //by one vkUpdateDescriptorSetWithTemplate, so every binding of the template must be set
+  struct DescriptorSetData {
+    explicit DescriptorSetData(const DescriptorUpdateTemplate &update_template) : desc_template {&update_template} {
+      if (!update_template.handle) {
+        throw std::runtime_error {"Set layout has no update template"};
+      }
+    }
+
+    void set_texture(uint32_t binding, VkImageView view, VkSampler sampler, uint32_t elem = 0) {
+      *get_ptr<VkDescriptorImageInfo>(binding, elem) = {sampler, view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+    }
+
+    void set_sampled_image(uint32_t binding, VkImageView view, uint32_t elem = 0) {
+      *get_ptr<VkDescriptorImageInfo>(binding, elem) = {nullptr, view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+    }
+
+    void set_storage_image(uint32_t binding, VkImageView view, uint32_t elem = 0) {
+      *get_ptr<VkDescriptorImageInfo>(binding, elem) = {nullptr, view, VK_IMAGE_LAYOUT_GENERAL};
+    }
+
+    void set_sampler(uint32_t binding, VkSampler sampler, uint32_t elem = 0) {
+      *get_ptr<VkDescriptorImageInfo>(binding, elem) = {sampler, nullptr, VK_IMAGE_LAYOUT_UNDEFINED};
+    }
+
+    void set_buffer(uint32_t binding, VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE, uint32_t elem = 0) {
+      *get_ptr<VkDescriptorBufferInfo>(binding, elem) = {buffer, offset, range};
+    }
+
+    void set_acceleration_struct(uint32_t binding, VkAccelerationStructureKHR tlas, uint32_t elem = 0) {
+      *get_ptr<VkAccelerationStructureKHR>(binding, elem) = tlas;
+    }
+
+    //copies infos of a write built by *Binding types. False if the write doesn't fill a whole binding of the template
+    bool write(const VkWriteDescriptorSet &write) {
+      auto binding = write.dstBinding;
+      if (binding >= MAX_BINDINGS || desc_template->offsets[binding] == INVALID_DESCRIPTOR_OFFSET) {
+        return false;
+      }
+      if (write.descriptorType != desc_template->types[binding] || write.dstArrayElement != 0 || write.descriptorCount != desc_template->counts[binding]) {
+        return false;
+      }
+
+      auto dst = data.data() + desc_template->offsets[binding];
+      switch (write.descriptorType) {
+      case VK_DESCRIPTOR_TYPE_SAMPLER:
+      case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+      case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+      case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+      case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
+        std::memcpy(dst, write.pImageInfo, write.descriptorCount * sizeof(VkDescriptorImageInfo));
+        break;
+      case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+      case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+      case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
+      case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
+        std::memcpy(dst, write.pBufferInfo, write.descriptorCount * sizeof(VkDescriptorBufferInfo));
+        break;
+      case VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR: {
+        auto as_write = reinterpret_cast<const VkWriteDescriptorSetAccelerationStructureKHR*>(write.pNext);
+        std::memcpy(dst, as_write->pAccelerationStructures, write.descriptorCount * sizeof(VkAccelerationStructureKHR));
+        break;
+      }
+      default:
+        return false;
+      }
+      written.set(binding);
+      return true;
+    }
+
+    //unwritten bindings of the template would be updated with null handles
+    bool is_complete() const {
+      for (uint32_t i = 0; i < MAX_BINDINGS; i++) {
+        if (desc_template->offsets[i] != INVALID_DESCRIPTOR_OFFSET && !written.test(i)) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    VkDescriptorUpdateTemplate get_template() const { return desc_template->handle; }
+    const void *get_data() const { return data.data(); }
+
+  private:
+    const DescriptorUpdateTemplate *desc_template;
+    alignas(8) std::array<uint8_t, MAX_DESCRIPTOR_DATA_SIZE> data {};
+    std::bitset<MAX_BINDINGS> written;
+
+    template <typename T>
+    T *get_ptr(uint32_t binding, uint32_t elem) {
+      if (binding >= MAX_BINDINGS || desc_template->offsets[binding] == INVALID_DESCRIPTOR_OFFSET) {
+        throw std::runtime_error {"Binding is not in update template"};
+      }
+      if (elem >= desc_template->counts[binding]) {
+        throw std::runtime_error {"Array index out of bounds"};
+      }
+      written.set(binding);
+      return reinterpret_cast<T*>(data.data() + desc_template->offsets[binding] + elem * sizeof(T));
+    }
+  };
+
+  namespace internal {
+    inline void update_set(VkDevice api_device, VkDescriptorSet set, const DescriptorSetData &data) {
+      vkUpdateDescriptorSetWithTemplate(api_device, set, data.get_template(), data.get_data());
+    }
+
+    //bindings are packed for the template when they cover it, otherwise they are written one by one
+    template <typename... Bindings>
+    void write_set(VkDevice api_device, VkDescriptorSet set, const DescriptorUpdateTemplate &update_template, const Bindings&... bindings) {
+      constexpr auto count = sizeof...(bindings);
+
+      VkWriteDescriptorSet writes[count];
+      write_set_base(api_device, set, writes, bindings...);
+
+      if (update_template.handle) {
+        DescriptorSetData data {update_template};
+        bool packed = true;
+        for (uint32_t i = 0; i < count && packed; i++) {
+          packed &= data.write(writes[i]);
+        }
+        if (packed && data.is_complete()) {
+          update_set(api_device, set, data);
+          return;
+        }
+      }
+
+      vkUpdateDescriptorSets(api_device, count, writes, 0, nullptr);
+    }
+  }
+
+  struct DescriptorCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint32_t entries = 0;
+  };
+
+  //Sets outlive frames and are written once, a hit doesn't call vkUpdateDescriptorSets.
+  //Key is the layout, contents of the writes and ids of resources the handles were taken from.
+  //Entries with dead ids are dropped, handles without ids must outlive the cache (samplers, ubo pools).
+  //Not thread safe, one cache per recorder
+  struct DescriptorSetCache {
+    DescriptorSetCache(uint32_t frames_count);
+    ~DescriptorSetCache();
+
+    //frame fence of the reused frame slot must be waited
+    void flip();
+    //device must be idle
+    void clear();
+
+    template <typename... Bindings>
+    VkDescriptorSet get_set(VkDescriptorSetLayout layout, const std::vector<DriverResourceID> &deps, const Bindings&... bindings) {
+      constexpr auto count = sizeof...(bindings);
+
+      VkWriteDescriptorSet writes[count];
+      internal::write_set_base(VK_NULL_HANDLE, VK_NULL_HANDLE, writes, bindings...);
+      return get_set(layout, deps.data(), deps.size(), writes, count);
+    }
+
+    VkDescriptorSet get_set(VkDescriptorSetLayout layout, const DriverResourceID *deps, uint32_t deps_count, VkWriteDescriptorSet *writes, uint32_t writes_count);
+
+    const DescriptorCacheStats &get_stats() const { return stats; }
+
+    DescriptorSetCache(const DescriptorSetCache &) = delete;
+    DescriptorSetCache &operator=(const DescriptorSetCache &) = delete;
+  private:
+    struct Entry {
+      VkDescriptorSet set {nullptr};
+      uint32_t block = 0;
+      DescriptorPoolUsage usage;
+      uint64_t last_used = 0;
+      std::vector<DriverResourceID> deps;
+    };
+
+    //set may be used by frames in flight
+    struct RetiredSet {
+      VkDescriptorSet set;
+      uint32_t block;
+      DescriptorPoolUsage usage;
+      uint64_t frame;
+    };
+
+    struct KeyHash {
+      std::size_t operator()(const std::vector<uint64_t> &key) const { return hash_bytes(key.data(), key.size() * sizeof(uint64_t)); }
+    };
+
+    //unused entries are freed after this many flips
+    static constexpr uint64_t MAX_UNUSED_FRAMES = 120;
+
+    uint32_t frames_count;
+    uint64_t frame = 0;
+    uint32_t layouts_generation = 0;
+
+    DescriptorBlockChain chain {VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT};
+    std::unordered_map<std::vector<uint64_t>, Entry, KeyHash> entries;
+    std::vector<RetiredSet> retired;
+    std::vector<uint64_t> key;
+    DescriptorCacheStats stats;
+
+    void build_key(VkDescriptorSetLayout layout, const DriverResourceID *deps, uint32_t deps_count, const VkWriteDescriptorSet *writes, uint32_t writes_count);
+    void retire(const Entry &entry);
+    void retire_all();
+  };
+
   inline bool operator!=(const VkDescriptorImageInfo &a, const VkDescriptorImageInfo &b) {
     return (a.sampler != b.sampler) || (a.imageView != b.imageView) || (a.imageLayout != b.imageLayout);
   } 
@@ -1,6 +1,8 @@
 #include "driver.hpp"
 
 #include <vector>
+#include <algorithm>
+#include <cstring>
 
 #define VMA_IMPLEMENTATION
 #include <lib/vk_mem_alloc.h>
@@ -90,6 +92,8 @@ namespace gpu {
     bool complete = false;
     uint32_t queue_family_index = 0;
     VkPhysicalDeviceProperties properties;
+    uint32_t queue_count = 0;
+    uint32_t timestamp_valid_bits = 0;
   };
 
   static DeviceQueryInfo pick_physical_device(VkPhysicalDevice device, const DeviceConfig &cfg) {
@@ -109,6 +113,8 @@ namespace gpu {
 
     bool queue_found = false;
     uint32_t queue_family = 0;
+    uint32_t queue_count = 0;
+    uint32_t timestamp_bits = 0;
 
     for (uint32_t i = 0; i < queues.size(); i++) {
       auto flags = queues[i].queueFlags;
@@ -130,9 +136,61 @@ namespace gpu {
 
       queue_found = true;
       queue_family = i;
+      queue_count = queues[i].queueCount;
+      timestamp_bits = queues[i].timestampValidBits;
     }
 
-    return {queue_found, queue_family, pproperties};
+    return {queue_found, queue_family, pproperties, queue_count, timestamp_bits};
+  }
+
+  static bool has_device_extension(VkPhysicalDevice device, const char *name) {
+    uint32_t count = 0;
+    VKCHECK(vkEnumerateDeviceExtensionProperties(device, nullptr, &count, nullptr));
+    std::vector<VkExtensionProperties> extensions;
+    extensions.resize(count);
+    VKCHECK(vkEnumerateDeviceExtensionProperties(device, nullptr, &count, extensions.data()));
+    
+    for (const auto &ext : extensions) {
+      if (!std::strcmp(ext.extensionName, name)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  static bool supports_synchronization2(VkPhysicalDevice device) {
+    if (!has_device_extension(device, VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME)) {
+      return false;
+    }
+
+    VkPhysicalDeviceSynchronization2FeaturesKHR sync2 {
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR,
+      .pNext = nullptr
+    };
+    VkPhysicalDeviceFeatures2 features {
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+      .pNext = &sync2
+    };
+    vkGetPhysicalDeviceFeatures2(device, &features);
+    return sync2.synchronization2 == VK_TRUE;
+  }
+
+  //0 if extension is not supported
+  static uint32_t get_max_push_descriptors(VkPhysicalDevice device) {
+    if (!has_device_extension(device, VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME)) {
+      return 0;
+    }
+
+    VkPhysicalDevicePushDescriptorPropertiesKHR push_props {
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PUSH_DESCRIPTOR_PROPERTIES_KHR,
+      .pNext = nullptr
+    };
+    VkPhysicalDeviceProperties2 props {
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+      .pNext = &push_props
+    };
+    vkGetPhysicalDeviceProperties2(device, &props);
+    return push_props.maxPushDescriptors;
   }
 
   Device::Device(VkInstance instance, const DeviceConfig &cfg) {
@@ -154,8 +212,11 @@ namespace gpu {
     }
 
     queue_family_index = query.queue_family_index;    
+    timestamp_valid_bits = query.timestamp_valid_bits;
 
-    float priority = 1.f;
+    //second queue of the same family is used for async compute, resources don't need ownership transfers
+    float priorities[] {1.f, 1.f};
+    uint32_t queues_count = std::min(query.queue_count, 2u);
     
     VkDeviceQueueCreateInfo queues[] {
       {
@@ -163,13 +224,23 @@ namespace gpu {
         .pNext = nullptr,
         .flags = 0,
         .queueFamilyIndex = queue_family_index,
-        .queueCount = 1,
-        .pQueuePriorities = &priority 
+        .queueCount = std::max(queues_count, 1u),
+        .pQueuePriorities = priorities
       }
     };
 
     auto ext_set = cfg.extensions;
     
+    synchronization2 = supports_synchronization2(physical_device);
+    if (synchronization2) {
+      ext_set.insert(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+    }
+
+    max_push_descriptors = get_max_push_descriptors(physical_device);
+    if (max_push_descriptors) {
+      ext_set.insert(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME);
+    }
+    
     if (cfg.use_ray_query) {
       //ext_set.insert(VK_KHR_SPIRV_1_4_EXTENSION_NAME);
       //ext_set.insert(VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME);
@@ -187,6 +258,7 @@ namespace gpu {
     VkPhysicalDeviceFeatures features {};
     features.fragmentStoresAndAtomics = VK_TRUE;
     features.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
+    features.shaderStorageImageArrayDynamicIndexing = VK_TRUE;
     VkPhysicalDeviceDescriptorIndexingFeatures bindless_features {
       .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES,
       .pNext = nullptr
@@ -216,11 +288,21 @@ namespace gpu {
     bindless_features.runtimeDescriptorArray = VK_TRUE;
     bindless_features.descriptorBindingPartiallyBound = VK_TRUE;
     bindless_features.descriptorBindingVariableDescriptorCount = VK_TRUE;
+    //global bindless heap
+    bindless_features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    bindless_features.descriptorBindingStorageImageUpdateAfterBind = VK_TRUE;
+    bindless_features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
     bindless_features.pNext = cfg.use_ray_query? &device_adders : nullptr;
+
+    VkPhysicalDeviceSynchronization2FeaturesKHR sync2_features {
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR,
+      .pNext = &bindless_features,
+      .synchronization2 = VK_TRUE
+    };
     
     VkDeviceCreateInfo info {
       .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
-      .pNext = &bindless_features,
+      .pNext = synchronization2? (void*)&sync2_features : (void*)&bindless_features,
       .flags = 0,
       .queueCreateInfoCount = 1,
       .pQueueCreateInfos = queues,
@@ -233,6 +315,9 @@ namespace gpu {
 
     VKCHECK(vkCreateDevice(physical_device, &info, nullptr, &logical_device));
     vkGetDeviceQueue(logical_device, queue_family_index, 0, &queue);
+    if (queues_count > 1) {
+      vkGetDeviceQueue(logical_device, queue_family_index, 1, &compute_queue);
+    }
   
     VmaVulkanFunctions vk_func {
       vkGetPhysicalDeviceProperties,
@@ -269,8 +354,9 @@ namespace gpu {
   
   Device::Device(Device &&dev)
     : physical_device {dev.physical_device}, properties {dev.properties}, logical_device {dev.logical_device},
-      allocator{dev.allocator}, queue_family_index {dev.queue_family_index},
-      queue {dev.queue}
+      allocator{dev.allocator}, queue_family_index {dev.queue_family_index}, timestamp_valid_bits {dev.timestamp_valid_bits},
+      queue {dev.queue}, compute_queue {dev.compute_queue}, synchronization2 {dev.synchronization2},
+      max_push_descriptors {dev.max_push_descriptors}
   {
     dev.logical_device = nullptr;
     dev.allocator = nullptr;
@@ -291,7 +377,11 @@ namespace gpu {
     std::swap(logical_device, dev.logical_device);
     std::swap(allocator, dev.allocator);
     std::swap(queue_family_index, dev.queue_family_index);
+    std::swap(timestamp_valid_bits, dev.timestamp_valid_bits);
     std::swap(queue, dev.queue);
+    std::swap(compute_queue, dev.compute_queue);
+    std::swap(synchronization2, dev.synchronization2);
+    std::swap(max_push_descriptors, dev.max_push_descriptors);
     return *this;
   }
 
@@ -299,6 +389,7 @@ namespace gpu {
   static std::optional<DebugMessenger> g_messenger;
   static std::optional<Surface> g_surface;
   static std::optional<Device> g_device;
+  static std::mutex g_queue_lock;
 
   void create_context(const InstanceConfig &icfg, PFN_vkDebugUtilsMessengerCallbackEXT callback, DeviceConfig dcfg, SurfaceCreateCB &&surface_cb) {
     g_instance.emplace(Instance {icfg});
@@ -343,5 +434,9 @@ namespace gpu {
     auto &dev = app_device();
     return QueueInfo {dev.api_queue(), dev.get_queue_family()};
   }
+
+  std::mutex &app_queue_lock() {
+    return g_queue_lock;
+  }
   
 }
\ No newline at end of file
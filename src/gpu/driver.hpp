@@ -6,6 +6,7 @@
 #include <set>
 #include <string>
 #include <functional>
+#include <mutex>
 
 #include "common.hpp"
 
@@ -32,6 +33,12 @@ namespace gpu {
     VkSurfaceKHR surface {nullptr};
     std::set<std::string> extensions;
     bool use_ray_query = false;
+    //pipeline cache is loaded at startup and stored on close, empty path disables it
+    std::string pipeline_cache_path;
+    //pipelines are compiled on these threads and tasks skip draws until they are ready, 0 compiles on first bind
+    uint32_t pipeline_compile_threads = 0;
+    //keys of pipelines created in this run, warmed up on the next start. Empty path disables it
+    std::string pipeline_manifest_path;
   };
 
   struct Instance {
@@ -83,8 +90,18 @@ namespace gpu {
     
     VkDevice api_device() const { return logical_device; }
     VkQueue api_queue() const { return queue; }
+    //second queue of the main family, nullptr if family has only one queue
+    VkQueue api_compute_queue() const { return compute_queue; }
+    bool has_async_compute() const { return compute_queue != nullptr; }
+    //VK_KHR_synchronization2 is enabled when device supports it
+    bool has_synchronization2() const { return synchronization2; }
+    //VK_KHR_push_descriptor is enabled when device supports it
+    bool has_push_descriptors() const { return max_push_descriptors != 0; }
+    uint32_t get_max_push_descriptors() const { return max_push_descriptors; }
     VkPhysicalDevice api_physical_device() const { return physical_device; }
     uint32_t get_queue_family() const { return queue_family_index; }
+    //0 if queue family doesn't support timestamps
+    uint32_t get_timestamp_valid_bits() const { return timestamp_valid_bits; }
     VmaAllocator get_allocator() const { return allocator; }
     const VkPhysicalDeviceProperties get_properties() const { return properties; }
 
@@ -95,7 +112,11 @@ namespace gpu {
     VmaAllocator allocator {};
 
     uint32_t queue_family_index;
+    uint32_t timestamp_valid_bits = 0;
     VkQueue queue {nullptr};
+    VkQueue compute_queue {nullptr};
+    bool synchronization2 = false;
+    uint32_t max_push_descriptors = 0;
   };
 
   struct Surface {
@@ -139,6 +160,8 @@ namespace gpu {
   };
 
   QueueInfo app_main_queue();
+  //queues are used from the render thread and the main thread. Submits, presents and device waits hold this lock
+  std::mutex &app_queue_lock();
 
   namespace internal {
     VkDevice app_vk_device();
@@ -18,7 +18,7 @@ namespace gpu {
     bool set_width(uint32_t w) {
       bool modified = width != w;
       width = w;
-      dirty |= w;
+      dirty |= modified;
       return modified;
     }
 
@@ -96,6 +96,10 @@ namespace gpu {
 
     uint32_t get_width() const { return width; }
     uint32_t get_height() const { return height; }
+
+    uint32_t get_attachments_count() const { return attachments_count; }
+    DriverResourceID get_attachment_id(uint32_t index) const { return image_ids.at(index); }
+    const ImageViewRange &get_attachment_range(uint32_t index) const { return views.at(index); }
     
     VkFramebuffer create_fb() const;
     bool operator==(const FramebufferState &st) const;
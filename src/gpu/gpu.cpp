@@ -13,18 +13,23 @@ namespace gpu {
 
   void init_all(const InstanceConfig &icfg, PFN_vkDebugUtilsMessengerCallbackEXT callback, DeviceConfig dcfg, VkExtent2D window_size, SurfaceCreateCB &&surface_cb) {
     create_context(icfg, callback, dcfg, std::move(surface_cb));
+    //views and samplers get bindless indices on creation, so the heap goes first
+    create_bindless_heap();
     
     g_swapchain.emplace(Swapchain {
       window_size,
       VK_IMAGE_USAGE_TRANSFER_DST_BIT|VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT});
 
-    g_pipeline_pool.reset(new PipelinePool {});
+    g_pipeline_pool.reset(new PipelinePool {dcfg.pipeline_cache_path, dcfg.pipeline_compile_threads, dcfg.pipeline_manifest_path});
     g_sampler_pool.emplace(SamplerPool {});
     g_static_descriptors.emplace(StaticDescriptorPool {});
   }
 
   void close() {
-    vkDeviceWaitIdle(app_device().api_device());
+    {
+      std::scoped_lock lock {app_queue_lock()};
+      vkDeviceWaitIdle(app_device().api_device());
+    }
 
     auto ptr = g_pipeline_pool.get();
     delete ptr;
@@ -35,6 +40,7 @@ namespace gpu {
     destroy_resources();
     
     g_swapchain.reset();
+    destroy_bindless_heap();
     close_context();
   }
 
@@ -63,6 +69,18 @@ namespace gpu {
   VkSampler create_sampler(const VkSamplerCreateInfo &info) {
     return g_sampler_pool->get_sampler(info);
   }
+
+  uint32_t get_sampler_index(VkSampler sampler) {
+    return g_sampler_pool->get_index(sampler);
+  }
+
+  VkDescriptorSet get_bindless_set() {
+    return app_bindless_heap()->get_set();
+  }
+
+  BindlessStats get_bindless_stats() {
+    return app_bindless_heap()->get_stats();
+  }
   
   void create_program(const std::string &name, std::initializer_list<std::string> shaders) {
     g_pipeline_pool->create_program(name, shaders);
@@ -72,6 +90,10 @@ namespace gpu {
     g_pipeline_pool->create_program(name, std::move(shaders));
   }
 
+  void create_program(const std::string &name, std::vector<std::string> &&shaders, const std::bitset<MAX_DESCRIPTORS> &push_sets) {
+    g_pipeline_pool->create_program(name, std::move(shaders), push_sets);
+  }
+
   /*std::vector<CmdContext> allocate_cmd_contexts(CmdBufferPool &pool, uint32_t count) {
     auto &dev = app_device();
     auto api_buffers = pool.allocate(count);
@@ -167,12 +189,35 @@ namespace gpu {
     return ManagedDescriptorSet {*g_static_descriptors, layout, variable_sizes.size(), variable_sizes.begin()};
   }
 
+  const DescriptorPoolStats &get_static_descriptor_stats() {
+    return g_static_descriptors->get_stats();
+  }
+
+  void warm_up_pipelines() {
+    g_pipeline_pool->warm_up_pipelines();
+  }
+
   void reload_shaders() {
-    VKCHECK(vkDeviceWaitIdle(internal::app_vk_device()));
+    {
+      std::scoped_lock lock {app_queue_lock()};
+      VKCHECK(vkDeviceWaitIdle(internal::app_vk_device()));
+    }
     g_pipeline_pool->reload_programs();
   }
 
+  bool reload_changed_shaders() {
+    if (!g_pipeline_pool->has_shader_changes()) {
+      return false;
+    }
+    {
+      std::scoped_lock lock {app_queue_lock()};
+      VKCHECK(vkDeviceWaitIdle(internal::app_vk_device()));
+    }
+    return g_pipeline_pool->reload_changed_programs() != 0;
+  }
+
   void collect_resources() {
     collect_image_buffer_resources();
+    app_bindless_heap()->flip();
   }
 }
\ No newline at end of file
@@ -11,6 +11,7 @@
 #include "descriptors.hpp"
 #include "resources.hpp"
 #include "managed_resources.hpp"
+#include "bindless.hpp"
 
 #include <functional>
 
@@ -27,16 +28,37 @@ namespace gpu {
   ComputePipeline create_compute_pipeline(const char *name);
 
   VkSampler create_sampler(const VkSamplerCreateInfo &info);
+  //bindless heap index of a sampler from create_sampler
+  uint32_t get_sampler_index(VkSampler sampler);
+  //bound by CmdContext::bind_pipeline for programs which declare BINDLESS_SET
+  VkDescriptorSet get_bindless_set();
+  BindlessStats get_bindless_stats();
 
   void reload_shaders();
+  //reloads only modified .spv files and pipelines of programs which use them. Waits for device only on changes
+  bool reload_changed_shaders();
+  //call after programs are created, before the first frame
+  void warm_up_pipelines();
 
   template <typename... Bindings> 
   void write_set(VkDescriptorSet set, const Bindings&... bindings) {
     internal::write_set(app_device().api_device(), set, bindings...);
   }
+
+  inline void update_set(VkDescriptorSet set, const DescriptorSetData &data) {
+    internal::update_set(app_device().api_device(), set, data);
+  }
+
+  //single vkUpdateDescriptorSetWithTemplate when bindings cover the template of the set layout
+  template <typename... Bindings>
+  void write_set(VkDescriptorSet set, const DescriptorUpdateTemplate &update_template, const Bindings&... bindings) {
+    internal::write_set(app_device().api_device(), set, update_template, bindings...);
+  }
   
   void create_program(const std::string &name, std::initializer_list<std::string> shaders);
   void create_program(const std::string &name, std::vector<std::string> &&shaders);
+  //push_sets fall back to regular sets without VK_KHR_push_descriptor
+  void create_program(const std::string &name, std::vector<std::string> &&shaders, const std::bitset<MAX_DESCRIPTORS> &push_sets);
 
   //std::vector<CmdContext> allocate_cmd_contexts(CmdBufferPool &pool, uint32_t count);
   
@@ -47,6 +69,7 @@ namespace gpu {
 
   ManagedDescriptorSet allocate_descriptor_set(VkDescriptorSetLayout layout);
   ManagedDescriptorSet allocate_descriptor_set(VkDescriptorSetLayout layout, const std::initializer_list<uint32_t> &variable_sizes);
+  const DescriptorPoolStats &get_static_descriptor_stats();
 
   void collect_resources();
 }
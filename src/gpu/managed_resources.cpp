@@ -52,6 +52,15 @@ namespace gpu {
     }
   }
 
+  bool DriverResourceManager::is_alive(const DriverResourceID &id) {
+    std::scoped_lock lock {heap_lock};
+    if (id.invalid() || id.index >= resources.size()) {
+      return false;
+    }
+    auto &slot = resources[id.index];
+    return slot.first != nullptr && slot.second == id.gen;
+  }
+
   void DriverResourceManager::collect_garbage() {
     std::scoped_lock lock {heap_lock};
     for (auto ptr : kill_list) {
@@ -188,7 +197,7 @@ namespace gpu {
     return vkGetBufferDeviceAddress(app_device().api_device(), &info);
   }
 
-  static VkImageAspectFlagBits get_default_aspect(VkFormat fmt) {
+  VkImageAspectFlagBits get_default_aspect(VkFormat fmt) {
     switch (fmt) {
       case VK_FORMAT_S8_UINT:
         return VK_IMAGE_ASPECT_STENCIL_BIT;
@@ -219,10 +228,22 @@ namespace gpu {
     allocation = nullptr;
   }
   
+  DriverImage::DriverImage(const VkImageCreateInfo &info, VmaAllocation memory) {
+    auto allocator = app_device().get_allocator();
+    desc = info;
+
+    VKCHECK(vkCreateImage(app_device().api_device(), &info, nullptr, &handle));
+    VKCHECK(vmaBindImageMemory(allocator, memory, handle));
+    allocation = memory;
+    aliased = true;
+  }
+  
   DriverImage::~DriverImage() {
     destroy_views();
     
-    if (allocation)
+    if (aliased) //memory is owned by the aliasing block
+      vkDestroyImage(app_device().api_device(), handle, nullptr);
+    else if (allocation)
       vmaDestroyImage(app_device().get_allocator(), handle, allocation);
   }
 
@@ -238,6 +259,18 @@ namespace gpu {
   }
 
   VkImageView DriverImage::get_view(ImageViewRange range) {
+    return get_view_entry(range).handle;
+  }
+
+  uint32_t DriverImage::get_sampled_index(ImageViewRange range) {
+    return get_view_entry(range).sampled_index;
+  }
+
+  uint32_t DriverImage::get_storage_index(ImageViewRange range) {
+    return get_view_entry(range).storage_index;
+  }
+
+  const DriverImage::View &DriverImage::get_view_entry(ImageViewRange range) {
     std::lock_guard lock {views_lock};
 
     auto device = app_device().api_device();
@@ -262,19 +295,36 @@ namespace gpu {
       .subresourceRange = {range.aspect, range.base_mip, range.mips_count, range.base_layer, range.layers_count}
     };
 
-    VkImageView view {nullptr};
-    VKCHECK(vkCreateImageView(device, &info, nullptr, &view));
-    views.insert({range, view});
-    return view;
+    View view {};
+    VKCHECK(vkCreateImageView(device, &info, nullptr, &view.handle));
+
+    //descriptors are written once here, passes only push indices
+    if (auto heap = app_bindless_heap()) {
+      bool single_aspect = (range.aspect & (range.aspect - 1)) == 0;
+      if ((desc.usage & VK_IMAGE_USAGE_SAMPLED_BIT) && single_aspect) {
+        view.sampled_index = heap->add_sampled_image(view.handle);
+      }
+      if ((desc.usage & VK_IMAGE_USAGE_STORAGE_BIT) && range.mips_count == 1) {
+        view.storage_index = heap->add_storage_image(view.handle);
+      }
+    }
+
+    return views.insert({range, view}).first->second;
   }
 
   void DriverImage::destroy_views() {
     auto vkdev = app_device().api_device();
+    auto heap = app_bindless_heap();
 
     std::lock_guard lock {views_lock};
-    for (auto [range, view] : views) {
-      vkDestroyImageView(vkdev, view, nullptr);
+    for (auto &[range, view] : views) {
+      if (heap) {
+        heap->release(BindlessType::SampledImage, view.sampled_index);
+        heap->release(BindlessType::StorageImage, view.storage_index);
+      }
+      vkDestroyImageView(vkdev, view.handle, nullptr);
     }
+    views.clear();
   }
 
   BufferPtr create_buffer(VmaMemoryUsage memory, uint64_t buffer_size, VkBufferUsageFlags usage) {
@@ -393,6 +443,12 @@ namespace gpu {
     return ImagePtr {id};
   }
 
+  ImagePtr create_aliased_image(const VkImageCreateInfo &info, VmaAllocation memory) {
+    auto *dimg = new DriverImage {info, memory};
+    auto id = g_res_manager.register_resource(dimg, false);
+    return ImagePtr {id};
+  }
+
   void collect_image_buffer_resources() {
     g_res_manager.collect_garbage();
   }
@@ -409,6 +465,10 @@ namespace gpu {
     g_res_manager.release_resource(id);
   }
 
+  bool is_resource_alive(const DriverResourceID &id) {
+    return g_res_manager.is_alive(id);
+  }
+
   ImagePtr acquire_image(DriverResourceID id) {
     return ImagePtr {id};
   }
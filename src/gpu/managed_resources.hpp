@@ -6,6 +6,7 @@
 
 #include "resource_info.hpp"
 #include "driver.hpp"
+#include "bindless.hpp"
 
 namespace gpu {
   struct DriverResourceManager;
@@ -30,6 +31,8 @@ namespace gpu {
 
     constexpr bool invalid() const { return index == UINT32_MAX || gen == UINT32_MAX; }
     constexpr bool valid() const { return index < UINT32_MAX && gen < UINT32_MAX; }
+    //unique for index and generation, for keys of caches
+    constexpr uint64_t get_key() const { return (uint64_t(gen) << 32u) | index; }
   private:
     DriverResourceID(uint32_t i, uint32_t g) : index {i}, gen {g} {}
     
@@ -58,6 +61,8 @@ namespace gpu {
     
     DriverResource *acquire_resource(const DriverResourceID &id);
     void release_resource(const DriverResourceID &id);
+    //false once the last reference is released, slot may already hold a resource of the next generation
+    bool is_alive(const DriverResourceID &id);
 
     void collect_garbage();
     void clear_all();
@@ -128,6 +133,7 @@ namespace gpu {
   struct DriverImage : DriverResource {
     DriverImage(const VkImageCreateInfo &info);
     DriverImage(VkImage vk_image, const VkImageCreateInfo &info);
+    DriverImage(const VkImageCreateInfo &info, VmaAllocation memory); //bind to memory shared with other images
     ~DriverImage();
 
     VkImage api_image() const { return handle; }
@@ -141,6 +147,9 @@ namespace gpu {
     VkImageAspectFlags get_full_aspect() const;
 
     VkImageView get_view(ImageViewRange range);
+    //indices of the view in the bindless heap, INVALID_BINDLESS_INDEX if image usage or view range doesn't allow the access
+    uint32_t get_sampled_index(ImageViewRange range);
+    uint32_t get_storage_index(ImageViewRange range);
     void destroy_views();
 
     DriverImage(const DriverImage &) = delete;
@@ -149,10 +158,19 @@ namespace gpu {
   private:
     VkImage handle {nullptr};
     VmaAllocation allocation {nullptr};
+    bool aliased = false;
     VkImageCreateInfo desc;
 
+    struct View {
+      VkImageView handle {nullptr};
+      uint32_t sampled_index = INVALID_BINDLESS_INDEX;
+      uint32_t storage_index = INVALID_BINDLESS_INDEX;
+    };
+
     std::mutex views_lock;
-    std::unordered_map<ImageViewRange, VkImageView> views;
+    std::unordered_map<ImageViewRange, View> views;
+
+    const View &get_view_entry(ImageViewRange range);
   };
 
   struct BufferPtr : ResourcePtr {
@@ -176,9 +194,13 @@ namespace gpu {
   ImagePtr create_cubemap(VkFormat fmt, uint32_t size, uint32_t mips, VkImageUsageFlags usage);
   ImagePtr create_image_ref(VkImage vkimg, const VkImageCreateInfo &info);
   ImagePtr create_driver_image(const VkImageCreateInfo &info);
+  ImagePtr create_aliased_image(const VkImageCreateInfo &info, VmaAllocation memory);
+
+  VkImageAspectFlagBits get_default_aspect(VkFormat fmt);
 
   DriverResource *acquire_resource(DriverResourceID id);
   void release_resource(const DriverResourceID &id);
+  bool is_resource_alive(const DriverResourceID &id);
 
   ImagePtr acquire_image(DriverResourceID id);
   BufferPtr acquire_buffer(DriverResourceID id);
@@ -11,21 +11,257 @@
 #include <sstream>
 #include <initializer_list>
 #include <map>
+#include <filesystem>
+#include <chrono>
+#include <thread>
+#include <iterator>
+#include <algorithm>
+#include <type_traits>
 
 namespace gpu {
 
-  PipelinePool::PipelinePool() {
+  //file header, cache data follows it. Data of another device or driver is dropped
+  struct PipelineCacheFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vendor_id;
+    uint32_t device_id;
+    uint32_t driver_version;
+    uint8_t cache_uuid[VK_UUID_SIZE];
+    uint32_t reserved; //no padding, header is compared with memcmp
+    uint64_t data_size;
+    uint64_t data_hash;
+  };
+
+  constexpr uint32_t PIPELINE_CACHE_MAGIC = 0x48435050; //PPCH
+  constexpr uint32_t PIPELINE_CACHE_VERSION = 1;
+
+  static PipelineCacheFileHeader make_cache_header(const std::vector<uint8_t> &data) {
+    const auto &props = app_device().get_properties();
+    PipelineCacheFileHeader header {};
+    header.magic = PIPELINE_CACHE_MAGIC;
+    header.version = PIPELINE_CACHE_VERSION;
+    header.vendor_id = props.vendorID;
+    header.device_id = props.deviceID;
+    header.driver_version = props.driverVersion;
+    std::memcpy(header.cache_uuid, props.pipelineCacheUUID, VK_UUID_SIZE);
+    header.data_size = data.size();
+    header.data_hash = hash_bytes(data.data(), data.size());
+    return header;
+  }
+
+  //empty if file is missing or doesn't match the device
+  static std::vector<uint8_t> load_cache_data(const std::string &path) {
+    std::ifstream file {path, std::ios::binary};
+    if (!file) {
+      return {};
+    }
+
+    PipelineCacheFileHeader header {};
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+      std::cout << "Pipeline cache " << path << " is truncated\n";
+      return {};
+    }
+
+    if (header.magic != PIPELINE_CACHE_MAGIC || header.version != PIPELINE_CACHE_VERSION) {
+      std::cout << "Pipeline cache " << path << " is invalid\n";
+      return {};
+    }
+
+    //size comes from the file, don't allocate more than the file holds
+    auto data_start = file.tellg();
+    file.seekg(0, std::ios::end);
+    auto file_end = file.tellg();
+    file.seekg(data_start);
+    if (!file || data_start < 0 || static_cast<uint64_t>(file_end - data_start) < header.data_size) {
+      std::cout << "Pipeline cache " << path << " is truncated\n";
+      return {};
+    }
+
+    std::vector<uint8_t> data;
+    data.resize(header.data_size);
+    if (!file.read(reinterpret_cast<char*>(data.data()), data.size())) {
+      std::cout << "Pipeline cache " << path << " is truncated\n";
+      return {};
+    }
+
+    auto expected = make_cache_header(data);
+    if (std::memcmp(&header, &expected, sizeof(header)) != 0) {
+      std::cout << "Pipeline cache " << path << " was created for another device or driver\n";
+      return {};
+    }
+
+    //vulkan header is checked by driver too, but some drivers crash on foreign data
+    VkPipelineCacheHeaderVersionOne vk_header {};
+    if (data.size() < sizeof(vk_header)) {
+      return {};
+    }
+    std::memcpy(&vk_header, data.data(), sizeof(vk_header));
+    if (vk_header.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+      || vk_header.vendorID != expected.vendor_id || vk_header.deviceID != expected.device_id
+      || std::memcmp(vk_header.pipelineCacheUUID, expected.cache_uuid, VK_UUID_SIZE) != 0) {
+      std::cout << "Pipeline cache " << path << " has unexpected vulkan header\n";
+      return {};
+    }
+    return data;
+  }
+
+  //readers never see a partially written file
+  static bool replace_file(const std::string &path, const std::vector<uint8_t> &bytes) {
+    auto tmp_path = path + ".tmp";
+    {
+      std::ofstream file {tmp_path, std::ios::binary|std::ios::trunc};
+      file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+      file.flush();
+      if (!file) {
+        std::cout << "Failed to write " << tmp_path << "\n";
+        return false;
+      }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(tmp_path, path, error);
+    if (error) {
+      std::cout << "Failed to replace " << path << ": " << error.message() << "\n";
+      std::filesystem::remove(tmp_path, error);
+      return false;
+    }
+    return true;
+  }
+
+  constexpr uint32_t PIPELINE_MANIFEST_MAGIC = 0x464d5050; //PPMF
+  constexpr uint32_t PIPELINE_MANIFEST_VERSION = 1;
+
+  enum class ManifestEntry : uint8_t {
+    Compute,
+    Graphics
+  };
+
+  //manifest stores pipeline keys by value, pool indices differ between runs
+  struct ManifestWriter {
+    std::vector<uint8_t> bytes;
+
+    template <typename T>
+    void write(const T &val) {
+      static_assert(std::is_trivially_copyable_v<T>);
+      auto ptr = reinterpret_cast<const uint8_t*>(&val);
+      bytes.insert(bytes.end(), ptr, ptr + sizeof(T));
+    }
+
+    template <typename T>
+    void write_array(const std::vector<T> &vals) {
+      write(uint32_t(vals.size()));
+      for (const auto &val : vals) {
+        write(val);
+      }
+    }
+
+    void write_string(const std::string &str) {
+      write(uint32_t(str.size()));
+      bytes.insert(bytes.end(), str.begin(), str.end());
+    }
+  };
+
+  //any read past the end marks the rest of manifest as invalid
+  struct ManifestReader {
+    const std::vector<uint8_t> &bytes;
+    std::size_t offset = 0;
+    bool ok = true;
+
+    template <typename T>
+    T read() {
+      static_assert(std::is_trivially_copyable_v<T>);
+      T val {};
+      if (!ok || bytes.size() - offset < sizeof(T)) {
+        ok = false;
+        return val;
+      }
+      std::memcpy(&val, bytes.data() + offset, sizeof(T));
+      offset += sizeof(T);
+      return val;
+    }
+
+    template <typename T>
+    std::vector<T> read_array() {
+      auto count = read<uint32_t>();
+      if (!ok || (bytes.size() - offset)/sizeof(T) < count) {
+        ok = false;
+        return {};
+      }
+      std::vector<T> vals(count);
+      if (count) {
+        std::memcpy(vals.data(), bytes.data() + offset, count * sizeof(T));
+      }
+      offset += count * sizeof(T);
+      return vals;
+    }
+
+    std::string read_string() {
+      auto chars = read_array<char>();
+      return {chars.begin(), chars.end()};
+    }
+  };
+
+  PipelinePool::PipelinePool(const std::string &cache_path, uint32_t compile_threads_count, const std::string &manifest_path)
+    : pipeline_cache_path {cache_path}, pipeline_manifest_path {manifest_path}
+  {
+    if (compile_threads_count) {
+      compile_threads.reset(new WorkerPool {compile_threads_count});
+    }
+
+    std::vector<uint8_t> data;
+    if (!pipeline_cache_path.empty()) {
+      data = load_cache_data(pipeline_cache_path);
+    }
+
     VkPipelineCacheCreateInfo info {
       .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
       .pNext = nullptr,
       .flags = 0,
-      .initialDataSize = 0,
-      .pInitialData = nullptr
+      .initialDataSize = data.size(),
+      .pInitialData = data.empty()? nullptr : data.data()
     };
-    VKCHECK(vkCreatePipelineCache(internal::app_vk_device(), &info, nullptr, &vk_cache));
+    
+    if (vkCreatePipelineCache(internal::app_vk_device(), &info, nullptr, &vk_cache) != VK_SUCCESS && !data.empty()) {
+      std::cout << "Pipeline cache " << pipeline_cache_path << " is rejected by driver\n";
+      info.initialDataSize = 0;
+      info.pInitialData = nullptr;
+      VKCHECK(vkCreatePipelineCache(internal::app_vk_device(), &info, nullptr, &vk_cache));
+    }
+  }
+
+  void PipelinePool::save_pipeline_cache() {
+    if (pipeline_cache_path.empty() || !vk_cache) {
+      return;
+    }
+
+    std::vector<uint8_t> data;
+    {
+      std::lock_guard lock {pipelines_lock};
+      std::size_t size = 0;
+      //called from destructor, failure only skips saving
+      if (vkGetPipelineCacheData(internal::app_vk_device(), vk_cache, &size, nullptr) != VK_SUCCESS) {
+        return;
+      }
+      data.resize(size);
+      if (vkGetPipelineCacheData(internal::app_vk_device(), vk_cache, &size, data.data()) != VK_SUCCESS) {
+        return;
+      }
+      data.resize(size);
+    }
+
+    auto header = make_cache_header(data);
+    auto header_bytes = reinterpret_cast<const uint8_t*>(&header);
+    data.insert(data.begin(), header_bytes, header_bytes + sizeof(header));
+    replace_file(pipeline_cache_path, data);
   }
 
   PipelinePool::~PipelinePool() {
+    //queued jobs are finished before threads are joined
+    compile_threads.reset();
+    save_pipeline_cache();
+    save_pipeline_manifest();
+
     for (auto &[k, v] : compute_pipelines) {
       vkDestroyPipeline(internal::app_vk_device(), v.handle, nullptr);
     }
@@ -42,25 +278,262 @@ namespace gpu {
       if (!subpass.is_empty()) {
         vkDestroyRenderPass(internal::app_vk_device(), subpass.handle, nullptr);
       } 
+      for (auto &[key, handle] : subpass.variants) {
+        vkDestroyRenderPass(internal::app_vk_device(), handle, nullptr);
+      }
     }
   }
 
 
   void PipelinePool::reload_programs() {
+    if (compile_threads) {
+      try {
+        compile_threads->wait_idle();
+      } catch (...) {
+        //already reported, failed pipelines are queued again with reloaded shaders
+      }
+    }
+
+    std::lock_guard lock {pipelines_lock};
     for (auto &desc : compute_pipelines) {
-      vkDestroyPipeline(internal::app_vk_device(), desc.second.handle, nullptr);
-      desc.second.handle = nullptr;
+      vkDestroyPipeline(internal::app_vk_device(), desc.second.handle.exchange(nullptr), nullptr);
+      desc.second.queued = false;
+      desc.second.failed = false;
     }
 
     for (auto &desc : graphics_pipelines) {
-      vkDestroyPipeline(internal::app_vk_device(), desc.second.handle, nullptr);
-      desc.second.handle = nullptr;
+      vkDestroyPipeline(internal::app_vk_device(), desc.second.handle.exchange(nullptr), nullptr);
+      desc.second.queued = false;
+      desc.second.failed = false;
     }
     
     shader_programs.reload();
   }
 
+  void PipelinePool::save_pipeline_manifest() {
+    if (pipeline_manifest_path.empty()) {
+      return;
+    }
+
+    ManifestWriter entries;
+    uint32_t count = 0;
+    {
+      std::lock_guard lock {pipelines_lock};
+      for (const auto &[pipeline, slot] : compute_pipelines) {
+        if (!slot.handle.load(std::memory_order_acquire)) {
+          continue;
+        }
+        entries.write(ManifestEntry::Compute);
+        entries.write_string(shader_programs.get_program_name(pipeline.program_id.value()));
+        count++;
+      }
+
+      for (const auto &[pipeline, slot] : graphics_pipelines) {
+        if (!slot.handle.load(std::memory_order_acquire)) {
+          continue;
+        }
+        const auto &vinput = get_vinput(pipeline.vertex_input.value());
+        const auto &subpass = get_subpass_desc(pipeline.render_subpass.value());
+
+        entries.write(ManifestEntry::Graphics);
+        entries.write_string(shader_programs.get_program_name(pipeline.program_id.value()));
+        entries.write(get_registers(pipeline.regs_index.value()));
+        entries.write_array(vinput.bindings);
+        entries.write_array(vinput.attributes);
+        entries.write(uint8_t(subpass.use_depth));
+        entries.write_array(subpass.formats);
+        count++;
+      }
+    }
+
+    ManifestWriter manifest;
+    manifest.write(PIPELINE_MANIFEST_MAGIC);
+    manifest.write(PIPELINE_MANIFEST_VERSION);
+    manifest.write(uint32_t(sizeof(Registers)));
+    manifest.write(count);
+    manifest.bytes.insert(manifest.bytes.end(), entries.bytes.begin(), entries.bytes.end());
+    replace_file(pipeline_manifest_path, manifest.bytes);
+  }
+
+  uint32_t PipelinePool::warm_up_pipelines() {
+    if (pipeline_manifest_path.empty()) {
+      return 0;
+    }
+
+    std::ifstream file {pipeline_manifest_path, std::ios::binary};
+    if (!file) {
+      return 0;
+    }
+    std::vector<uint8_t> bytes {std::istreambuf_iterator<char> {file}, std::istreambuf_iterator<char> {}};
+
+    auto start = std::chrono::steady_clock::now();
+    ManifestReader reader {bytes};
+    auto magic = reader.read<uint32_t>();
+    auto version = reader.read<uint32_t>();
+    auto registers_size = reader.read<uint32_t>();
+    auto count = reader.read<uint32_t>();
+
+    if (!reader.ok || magic != PIPELINE_MANIFEST_MAGIC || version != PIPELINE_MANIFEST_VERSION || registers_size != sizeof(Registers)) {
+      std::cout << "Pipeline manifest " << pipeline_manifest_path << " is invalid\n";
+      return 0;
+    }
+
+    std::vector<ComputePipeline> compute;
+    std::vector<GraphicsPipeline> graphics;
+    uint32_t missing_programs = 0;
+
+    for (uint32_t i = 0; i < count && reader.ok; i++) {
+      auto kind = reader.read<ManifestEntry>();
+      auto program = reader.read_string();
+
+      if (kind == ManifestEntry::Compute) {
+        if (!reader.ok) {
+          break;
+        }
+        if (!shader_programs.has_program(program)) {
+          missing_programs++;
+          continue;
+        }
+        ComputePipeline pipeline {this};
+        pipeline.set_program(program);
+        compute.push_back(pipeline);
+      } else if (kind == ManifestEntry::Graphics) {
+        auto regs = reader.read<Registers>();
+        VertexInput vinput;
+        vinput.bindings = reader.read_array<VkVertexInputBindingDescription>();
+        vinput.attributes = reader.read_array<VkVertexInputAttributeDescription>();
+        RenderSubpassDesc subpass;
+        subpass.use_depth = reader.read<uint8_t>() != 0;
+        subpass.formats = reader.read_array<VkFormat>();
+
+        if (!reader.ok) {
+          break;
+        }
+        if (!shader_programs.has_program(program)) {
+          missing_programs++;
+          continue;
+        }
+        GraphicsPipeline pipeline {this};
+        pipeline.set_program(program);
+        pipeline.set_registers(regs);
+        pipeline.set_vertex_input(vinput);
+        pipeline.set_rendersubpass(subpass);
+        graphics.push_back(pipeline);
+      } else {
+        reader.ok = false;
+      }
+    }
+
+    if (!reader.ok) {
+      std::cout << "Pipeline manifest " << pipeline_manifest_path << " is truncated\n";
+    }
+
+    //all entries are compiled before the first frame, so threads are borrowed if pool has none
+    bool own_threads = !compile_threads;
+    if (own_threads) {
+      compile_threads.reset(new WorkerPool {std::max(std::thread::hardware_concurrency(), 1u)});
+    }
+
+    for (const auto &pipeline : compute) {
+      request_pipeline(pipeline);
+    }
+    for (const auto &pipeline : graphics) {
+      request_pipeline(pipeline);
+    }
+
+    try {
+      compile_threads->wait_idle();
+    } catch (...) {
+      //already reported by compilation jobs
+    }
+
+    if (own_threads) {
+      compile_threads.reset();
+    }
+
+    uint32_t requested = compute.size() + graphics.size();
+    auto ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Pipeline manifest: " << requested << " pipelines warmed up in " << ms << " ms";
+    if (missing_programs) {
+      std::cout << ", " << missing_programs << " entries with unknown programs skipped";
+    }
+    std::cout << "\n";
+    return requested;
+  }
+
+  bool PipelinePool::has_shader_changes() {
+    std::lock_guard lock {pipelines_lock};
+    return shader_programs.poll_changes();
+  }
+
+  uint32_t PipelinePool::reload_changed_programs() {
+    if (compile_threads) {
+      try {
+        compile_threads->wait_idle();
+      } catch (...) {
+        //already reported, failed pipelines are queued again with reloaded shaders
+      }
+    }
+
+    std::vector<ComputePipeline> compute;
+    std::vector<GraphicsPipeline> graphics;
+    std::vector<ShaderProgramId> programs;
+    {
+      std::lock_guard lock {pipelines_lock};
+      programs = shader_programs.reload_changed();
+      auto is_changed = [&](uint32_t program) {
+        return std::find(programs.begin(), programs.end(), program) != programs.end();
+      };
+
+      for (auto &[pipeline, slot] : compute_pipelines) {
+        if (!is_changed(pipeline.program_id.value())) {
+          continue;
+        }
+        if (auto handle = slot.handle.exchange(nullptr)) {
+          vkDestroyPipeline(internal::app_vk_device(), handle, nullptr);
+          compute.push_back(pipeline);
+        }
+        slot.queued = false;
+        slot.failed = false;
+      }
+
+      for (auto &[pipeline, slot] : graphics_pipelines) {
+        if (!is_changed(pipeline.program_id.value())) {
+          continue;
+        }
+        if (auto handle = slot.handle.exchange(nullptr)) {
+          vkDestroyPipeline(internal::app_vk_device(), handle, nullptr);
+          graphics.push_back(pipeline);
+        }
+        slot.queued = false;
+        slot.failed = false;
+      }
+    }
+
+    //without compile threads pipelines are rebuilt on first bind
+    if (compile_threads) {
+      for (const auto &pipeline : compute) {
+        request_pipeline(pipeline);
+      }
+      for (const auto &pipeline : graphics) {
+        request_pipeline(pipeline);
+      }
+    }
+
+    if (!programs.empty()) {
+      std::cout << "Reloaded " << programs.size() << " programs, " << compute.size() + graphics.size() << " pipelines are rebuilt\n";
+    }
+    return programs.size();
+  }
+
+  void PipelinePool::wait_pipelines() {
+    if (compile_threads) {
+      compile_threads->wait_idle();
+    }
+  }
+
   uint32_t PipelinePool::get_subpass_index(const RenderSubpassDesc &desc) {
+    std::lock_guard lock {pipelines_lock};
     if (!render_subpasses.count(desc)) {
       uint32_t index = allocated_subpasses.size();
       allocated_subpasses.push_back({desc, nullptr});
@@ -72,6 +545,33 @@ namespace gpu {
   }
   
   void PipelinePool::RenderSubpass::create_renderpass() {
+    handle = create_renderpass({});
+  }
+
+  VkRenderPass PipelinePool::RenderSubpass::get_variant(const std::vector<AttachmentOps> &ops) {
+    //3 bits per attachment, MAX_ATTACHMENTS fit into the key
+    uint64_t key = 0;
+    for (uint32_t i = 0; i < ops.size() && i < desc.formats.size(); i++) {
+      uint64_t load = (ops[i].load == VK_ATTACHMENT_LOAD_OP_CLEAR)? 1 : (ops[i].load == VK_ATTACHMENT_LOAD_OP_DONT_CARE)? 2 : 0;
+      uint64_t store = (ops[i].store == VK_ATTACHMENT_STORE_OP_DONT_CARE)? 1 : 0;
+      key |= (load | (store << 2)) << (3 * i);
+    }
+
+    if (!key) {
+      if (is_empty()) {
+        create_renderpass();
+      }
+      return handle;
+    }
+
+    auto iter = variants.find(key);
+    if (iter == variants.end()) {
+      iter = variants.emplace(key, create_renderpass(ops)).first;
+    }
+    return iter->second;
+  }
+
+  VkRenderPass PipelinePool::RenderSubpass::create_renderpass(const std::vector<AttachmentOps> &ops) const {
     std::vector<VkAttachmentDescription> attachments;
     
     VkAttachmentDescription attach_desc {
@@ -86,8 +586,10 @@ namespace gpu {
       VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
     };
     
-    for (auto fmt : desc.formats) {
-      attach_desc.format = fmt;
+    for (uint32_t i = 0; i < desc.formats.size(); i++) {
+      attach_desc.format = desc.formats[i];
+      attach_desc.loadOp = (i < ops.size())? ops[i].load : VK_ATTACHMENT_LOAD_OP_LOAD;
+      attach_desc.storeOp = (i < ops.size())? ops[i].store : VK_ATTACHMENT_STORE_OP_STORE;
       attachments.push_back(attach_desc);
     }
 
@@ -120,7 +622,9 @@ namespace gpu {
     info.subpassCount = 1;
     info.pSubpasses = &subpass;
     
-    VKCHECK(vkCreateRenderPass(internal::app_vk_device(), &info, nullptr, &handle));
+    VkRenderPass renderpass = nullptr;
+    VKCHECK(vkCreateRenderPass(internal::app_vk_device(), &info, nullptr, &renderpass));
+    return renderpass;
   }
 
   VkRenderPass PipelinePool::get_subpass(uint32_t subpass_index) {
@@ -141,6 +645,7 @@ namespace gpu {
   }
 
   uint32_t PipelinePool::get_vinput_index(const VertexInput &vinput) {
+    std::lock_guard lock {pipelines_lock};
     auto it = vertex_input.find(vinput);
     if (it == vertex_input.end()) {
       uint32_t index = allocated_vinput.size();
@@ -157,6 +662,7 @@ namespace gpu {
   }
 
   uint32_t PipelinePool::get_registers_index(const Registers &regs) {
+    std::lock_guard lock {pipelines_lock};
     auto it = registers.find(regs);
     
     if (it == registers.end()) {
@@ -173,8 +679,16 @@ namespace gpu {
     return allocated_registers.at(index);
   }
 
+  BasePipeline &BasePipeline::operator=(const BasePipeline &p) {
+    pool = p.pool;
+    program_id = p.program_id;
+    slot = p.slot.load(std::memory_order_relaxed);
+    return *this;
+  }
+
   void BasePipeline::set_program(const std::string &name) {
     program_id = pool->get_program_index(name);
+    slot = nullptr;
   }
 
   VkDescriptorSetLayout BasePipeline::get_layout(uint32_t index) const {
@@ -185,6 +699,27 @@ namespace gpu {
     return pool->shader_programs.get_program_descriptor_layout(program_id.value(), index);
   }
   
+  const DescriptorUpdateTemplate &BasePipeline::get_update_template(uint32_t index) const {
+    if (!program_id.has_value()) {
+      throw std::runtime_error {"Pipeline not attached to program"};
+    }
+    return pool->shader_programs.get_program_update_template(program_id.value(), index);
+  }
+  
+  bool BasePipeline::is_push_descriptor(uint32_t index) const {
+    if (!program_id.has_value()) {
+      throw std::runtime_error {"Pipeline not attached to program"};
+    }
+    return pool->shader_programs.is_push_descriptor(program_id.value(), index);
+  }
+
+  bool BasePipeline::uses_bindless_heap() const {
+    if (!program_id.has_value()) {
+      throw std::runtime_error {"Pipeline not attached to program"};
+    }
+    return pool->shader_programs.uses_bindless_heap(program_id.value());
+  }
+
   VkPipelineLayout BasePipeline::get_pipeline_layout() const {
     if (!program_id.has_value()) {
       throw std::runtime_error {"Pipeline not attached to program"};
@@ -192,13 +727,86 @@ namespace gpu {
     return pool->shader_programs.get_program_layout(program_id.value());
   }
 
-  VkPipeline PipelinePool::get_pipeline(const ComputePipeline &pipeline) {
-    auto &res = compute_pipelines[pipeline];
-    if (res.handle) {
-      return res.handle;
+  PipelineSlot &PipelinePool::get_slot(const ComputePipeline &pipeline) {
+    if (auto slot = pipeline.slot.load(std::memory_order_acquire)) {
+      return *slot;
+    }
+
+    std::lock_guard lock {pipelines_lock};
+    auto &slot = compute_pipelines[pipeline];
+    pipeline.slot.store(&slot, std::memory_order_release);
+    return slot;
+  }
+
+  PipelineSlot &PipelinePool::get_slot(const GraphicsPipeline &pipeline) {
+    if (auto slot = pipeline.slot.load(std::memory_order_acquire)) {
+      return *slot;
+    }
+
+    std::lock_guard lock {pipelines_lock};
+    auto &slot = graphics_pipelines[pipeline];
+    pipeline.slot.store(&slot, std::memory_order_release);
+    return slot;
+  }
+
+  template <typename PipelineT>
+  VkPipeline PipelinePool::get_pipeline(const PipelineT &pipeline) {
+    auto &slot = get_slot(pipeline);
+    if (auto handle = slot.handle.load(std::memory_order_acquire)) {
+      return handle;
+    }
+
+    //failed pipeline is compiled by the recording thread, so the error is thrown from bind instead of skipping draws
+    if (compile_threads && !slot.failed.load(std::memory_order_acquire)) {
+      request_pipeline(pipeline);
+      return nullptr;
+    }
+
+    std::lock_guard lock {compile_lock};
+    auto handle = slot.handle.load(std::memory_order_acquire);
+    if (!handle) {
+      handle = create_pipeline(pipeline);
+      slot.handle.store(handle, std::memory_order_release);
+    }
+    return handle;
+  }
+
+  template <typename PipelineT>
+  void PipelinePool::request_pipeline(const PipelineT &pipeline) {
+    if (!compile_threads) {
+      get_pipeline(pipeline);
+      return;
+    }
+
+    auto &slot = get_slot(pipeline);
+    //failed pipeline stays queued until shaders are reloaded, get_pipeline reports it
+    if (slot.handle.load(std::memory_order_acquire) || slot.queued.exchange(true)) {
+      return;
+    }
+
+    pending_pipelines++;
+    compile_threads->submit([this, pipeline, &slot](){
+      try {
+        slot.handle.store(create_pipeline(pipeline), std::memory_order_release);
+      } catch (const std::exception &e) {
+        std::cout << "Pipeline compilation failed: " << e.what() << "\n";
+        slot.failed.store(true, std::memory_order_release);
+        pending_pipelines--;
+        throw;
+      }
+      pending_pipelines--;
+    });
+  }
+
+  VkPipeline PipelinePool::create_pipeline(const ComputePipeline &pipeline) {
+    std::vector<VkPipelineShaderStageCreateInfo> stages;
+    VkPipelineLayout layout = nullptr;
+    {
+      std::lock_guard lock {pipelines_lock};
+      stages = shader_programs.get_stage_info(pipeline.program_id.value());
+      layout = shader_programs.get_program_layout(pipeline.program_id.value());
     }
 
-    auto stages = shader_programs.get_stage_info(pipeline.program_id.value());
     if (stages.size() != 1 || stages[0].stage != VK_SHADER_STAGE_COMPUTE_BIT) {
       throw std::runtime_error {"Not compute program"};
     }
@@ -208,28 +816,35 @@ namespace gpu {
       .pNext = nullptr,
       .flags = 0,
       .stage = stages[0],
-      .layout = shader_programs.get_program_layout(pipeline.program_id.value()),
+      .layout = layout,
       .basePipelineHandle = nullptr,
       .basePipelineIndex = 0
     };
 
-    VKCHECK(vkCreateComputePipelines(internal::app_vk_device(), vk_cache, 1, &info, nullptr, &res.handle));
-    return res.handle;
+    //pipeline cache is internally synchronized
+    VkPipeline handle = nullptr;
+    VKCHECK(vkCreateComputePipelines(internal::app_vk_device(), vk_cache, 1, &info, nullptr, &handle));
+    return handle;
   }
 
-  VkPipeline PipelinePool::get_pipeline(const GraphicsPipeline &pipeline) {
-    auto &res = graphics_pipelines[pipeline];
-    if (res.handle) {
-      return res.handle;
+  VkPipeline PipelinePool::create_pipeline(const GraphicsPipeline &pipeline) {
+    //copies, so the pipeline is compiled without holding the lock
+    Registers regs;
+    VertexInput vinput;
+    VkRenderPass renderpass = nullptr;
+    RenderSubpassDesc rp_desc;
+    std::vector<VkPipelineShaderStageCreateInfo> stages;
+    VkPipelineLayout layout = nullptr;
+    {
+      std::lock_guard lock {pipelines_lock};
+      regs = get_registers(pipeline.regs_index.value());
+      vinput = get_vinput(pipeline.vertex_input.value());
+      renderpass = get_subpass(pipeline.render_subpass.value());
+      rp_desc = get_subpass_desc(pipeline.render_subpass.value());
+      stages = shader_programs.get_stage_info(pipeline.program_id.value());
+      layout = shader_programs.get_program_layout(pipeline.program_id.value());
     }
 
-    const auto &regs = get_registers(pipeline.regs_index.value());
-    const auto &vinput = get_vinput(pipeline.vertex_input.value());
-    auto renderpass = get_renderpass(pipeline);
-    const auto &rp_desc = get_subpass_desc(pipeline.render_subpass.value());
-
-    auto stages = shader_programs.get_stage_info(pipeline.program_id.value());
-
     VkPipelineColorBlendAttachmentState blend_attachment {
       .blendEnable = VK_FALSE,
       .srcColorBlendFactor = VK_BLEND_FACTOR_ZERO,
@@ -319,43 +934,72 @@ namespace gpu {
     info.pTessellationState = nullptr;
     info.renderPass = renderpass;
     info.subpass = 0;
-    info.layout = shader_programs.get_program_layout(pipeline.program_id.value());
-
-    VKCHECK(vkCreateGraphicsPipelines(internal::app_vk_device(), vk_cache, 1, &info, nullptr, &res.handle));
+    info.layout = layout;
 
-    return res.handle;
+    VkPipeline handle = nullptr;
+    VKCHECK(vkCreateGraphicsPipelines(internal::app_vk_device(), vk_cache, 1, &info, nullptr, &handle));
+    return handle;
   }
   
   VkRenderPass PipelinePool::get_renderpass(const GraphicsPipeline &pipeline) {
+    std::lock_guard lock {pipelines_lock};
     return get_subpass(pipeline.render_subpass.value());
   }
 
-  VkPipeline ComputePipeline::get_pipeline() {
+  VkRenderPass PipelinePool::get_renderpass(const GraphicsPipeline &pipeline, const std::vector<AttachmentOps> &ops) {
+    std::lock_guard lock {pipelines_lock};
+    return allocated_subpasses.at(pipeline.render_subpass.value()).get_variant(ops);
+  }
+
+  VkPipeline ComputePipeline::get_pipeline() const {
     return pool->get_pipeline(*this);
   }
 
-  VkPipeline GraphicsPipeline::get_pipeline() {
+  bool ComputePipeline::is_ready() const {
+    return pool->get_slot(*this).handle.load(std::memory_order_acquire) != nullptr;
+  }
+
+  void ComputePipeline::request() const {
+    pool->request_pipeline(*this);
+  }
+
+  VkPipeline GraphicsPipeline::get_pipeline() const {
     return pool->get_pipeline(*this);
   }
+
+  bool GraphicsPipeline::is_ready() const {
+    return pool->get_slot(*this).handle.load(std::memory_order_acquire) != nullptr;
+  }
+
+  void GraphicsPipeline::request() const {
+    pool->request_pipeline(*this);
+  }
   
   VkRenderPass GraphicsPipeline::get_renderpass() {
     return pool->get_renderpass(*this);
   }
 
+  VkRenderPass GraphicsPipeline::get_renderpass(const std::vector<AttachmentOps> &ops) {
+    return pool->get_renderpass(*this, ops);
+  }
+
   const RenderSubpassDesc &GraphicsPipeline::get_renderpass_desc() const {
     return pool->get_subpass_desc(render_subpass.value());
   }
 
   void GraphicsPipeline::set_vertex_input(const VertexInput &vinput) {
     vertex_input = pool->get_vinput_index(vinput);
+    slot = nullptr;
   }
   
   void GraphicsPipeline::set_registers(const Registers &regs) {
     regs_index = pool->get_registers_index(regs);
+    slot = nullptr;
   }
   
   void GraphicsPipeline::set_rendersubpass(const RenderSubpassDesc &subpass) {
     render_subpass = pool->get_subpass_index(subpass);
+    slot = nullptr;
   }
 
 
@@ -3,12 +3,15 @@
 
 #include "driver.hpp"
 #include "shader_program.hpp"
+#include "worker_pool.hpp"
 
 #include <vector>
 #include <functional>
 #include <string>
 #include <optional>
 #include <memory>
+#include <mutex>
+#include <atomic>
 
 #include <lib/spirv-reflect/spirv_reflect.h>
 
@@ -38,6 +41,14 @@ namespace gpu {
     }
   };
 
+  //render passes which differ only in attachment ops are compatible, so pipelines and framebuffers are shared
+  struct AttachmentOps {
+    VkAttachmentLoadOp load = VK_ATTACHMENT_LOAD_OP_LOAD;
+    VkAttachmentStoreOp store = VK_ATTACHMENT_STORE_OP_STORE;
+
+    bool is_default() const { return load == VK_ATTACHMENT_LOAD_OP_LOAD && store == VK_ATTACHMENT_STORE_OP_STORE; }
+  };
+
   bool operator==(const VkVertexInputBindingDescription &l, const VkVertexInputBindingDescription &r);
   bool operator==(const VkVertexInputAttributeDescription &l, const VkVertexInputAttributeDescription &r);
   bool operator==(const VkPipelineInputAssemblyStateCreateInfo &l, const VkPipelineInputAssemblyStateCreateInfo &r);
@@ -168,14 +179,29 @@ namespace gpu {
   struct PipelinePool;
   struct ProgramResources;
 
+  //published by the thread which compiled the pipeline. Slots are never erased, so pipelines keep pointers to them
+  struct PipelineSlot {
+    std::atomic<VkPipeline> handle {nullptr};
+    std::atomic<bool> queued {false};
+    //set by compile thread, such pipeline is compiled again on bind to report the error
+    std::atomic<bool> failed {false};
+  };
+
   struct BasePipeline {
     BasePipeline() {}
     BasePipeline(PipelinePool *base) : pool {base} {}
+    BasePipeline(const BasePipeline &p) : pool {p.pool}, program_id {p.program_id}, slot {p.slot.load(std::memory_order_relaxed)} {}
+    BasePipeline &operator=(const BasePipeline &p);
 
-    void attach(PipelinePool &p) { pool = &p; }
+    void attach(PipelinePool &p) { pool = &p; slot = nullptr; }
     void set_program(const std::string &name);
     
     VkDescriptorSetLayout get_layout(uint32_t index) const;
+    const DescriptorUpdateTemplate &get_update_template(uint32_t index) const;
+    //set is written by CmdContext::push_descriptors_* instead of being allocated
+    bool is_push_descriptor(uint32_t index) const;
+    //BINDLESS_SET is bound by CmdContext::bind_pipeline
+    bool uses_bindless_heap() const;
     VkPipelineLayout get_pipeline_layout() const;
     
     bool is_attached() const { return pool != nullptr; }
@@ -186,13 +212,19 @@ namespace gpu {
   protected:
     PipelinePool *pool {nullptr};
     std::optional<uint32_t> program_id {};
+    //lookup result, bound pipelines are found without locking the pool
+    mutable std::atomic<PipelineSlot*> slot {nullptr};
   };
 
   struct ComputePipeline : BasePipeline {
     ComputePipeline() : BasePipeline {} {}
     ComputePipeline(PipelinePool *p) : BasePipeline {p} {}
 
-    VkPipeline get_pipeline();
+    //nullptr while compilation is queued on pool threads, throws if compilation failed
+    VkPipeline get_pipeline() const;
+    bool is_ready() const;
+    //starts compilation ahead of the first bind
+    void request() const;
 
     bool operator==(const ComputePipeline &p) const {
       return (pool == p.pool && p.program_id == program_id);
@@ -210,8 +242,14 @@ namespace gpu {
     void set_registers(const Registers &regs);
     void set_rendersubpass(const RenderSubpassDesc &subpass);
 
-    VkPipeline get_pipeline();
+    //nullptr while compilation is queued on pool threads, throws if compilation failed
+    VkPipeline get_pipeline() const;
+    bool is_ready() const;
+    //starts compilation ahead of the first bind
+    void request() const;
     VkRenderPass get_renderpass();
+    //ops per attachment in subpass order
+    VkRenderPass get_renderpass(const std::vector<AttachmentOps> &ops);
     const RenderSubpassDesc &get_renderpass_desc() const;
 
     bool operator==(const GraphicsPipeline &p) const {
@@ -257,14 +295,39 @@ namespace gpu {
   constexpr uint32_t BINDLESS_DESC_COUNT = 1024;
 
   struct PipelinePool {
-    PipelinePool();
+    //without compile threads pipelines are compiled by the recording thread on first bind
+    PipelinePool(const std::string &cache_path = {}, uint32_t compile_threads = 0, const std::string &manifest_path = {});
     ~PipelinePool();
+
+    //replaces cache file atomically, called on destruction
+    void save_pipeline_cache();
+    //keys of compiled pipelines, called on destruction
+    void save_pipeline_manifest();
+    //compiles pipelines listed in manifest in parallel and waits for them. Programs must be created
+    uint32_t warm_up_pipelines();
     
-    void create_program(const std::string &name, std::vector<std::string> &&shaders) {
-      shader_programs.create_program(name, shaders);
+    void create_program(const std::string &name, std::vector<std::string> &&shaders, const std::bitset<MAX_DESCRIPTORS> &push_sets = {}) {
+      std::lock_guard lock {pipelines_lock};
+      shader_programs.create_program(name, shaders, push_sets);
     }
 
+    //destroys every pipeline and reloads all shaders
     void reload_programs();
+    //cheap check of shader files, no waiting for device
+    bool has_shader_changes();
+    //device must be idle for pipelines of changed programs. They are queued to compile threads
+    //if pool has them, others are untouched. Returns count of reloaded programs
+    uint32_t reload_changed_programs();
+
+    //.refl sidecars next to shaders skip spirv-reflect for unchanged code
+    void enable_reflection_cache(bool enable) { shader_programs.enable_reflection_cache(enable); }
+    const ReflectionCacheStats &get_reflection_stats() const { return shader_programs.get_reflection_stats(); }
+    uint32_t get_layouts_generation() const { return shader_programs.get_layouts_generation(); }
+
+    bool is_async() const { return compile_threads != nullptr; }
+    uint32_t get_pending_pipelines() const { return pending_pipelines; }
+    //blocks until queued pipelines are compiled, rethrows the first compilation error
+    void wait_pipelines();
     
     PipelinePool(const PipelinePool &) = delete;
     const PipelinePool &operator=(const PipelinePool &) = delete;
@@ -273,15 +336,23 @@ namespace gpu {
     struct RenderSubpass {
       RenderSubpassDesc desc;
       VkRenderPass handle = nullptr;
+      std::unordered_map<uint64_t, VkRenderPass> variants;
+
       bool is_empty() const { return !handle; }
       void create_renderpass();
-    };
-
-    struct Pipeline {
-      VkPipeline handle = nullptr;
+      VkRenderPass get_variant(const std::vector<AttachmentOps> &ops);
+      VkRenderPass create_renderpass(const std::vector<AttachmentOps> &ops) const;
     };
 
     VkPipelineCache vk_cache {nullptr};
+    std::string pipeline_cache_path;
+    std::string pipeline_manifest_path;
+    //guards maps and renderpasses, pipelines are compiled outside of it
+    std::mutex pipelines_lock;
+    //serializes compilation on recording threads, so a pipeline is not created twice
+    std::mutex compile_lock;
+    std::unique_ptr<WorkerPool> compile_threads;
+    std::atomic<uint32_t> pending_pipelines {0};
 
     ShaderProgramManager shader_programs;
 
@@ -294,8 +365,8 @@ namespace gpu {
     std::unordered_map<Registers, uint32_t, HashFunc<Registers>> registers;
     std::vector<Registers> allocated_registers;
 
-    std::unordered_map<ComputePipeline, Pipeline, HashFunc<ComputePipeline>> compute_pipelines;
-    std::unordered_map<GraphicsPipeline, Pipeline, HashFunc<GraphicsPipeline>> graphics_pipelines;
+    std::unordered_map<ComputePipeline, PipelineSlot, HashFunc<ComputePipeline>> compute_pipelines;
+    std::unordered_map<GraphicsPipeline, PipelineSlot, HashFunc<GraphicsPipeline>> graphics_pipelines;
 
     uint32_t get_subpass_index(const RenderSubpassDesc &desc);
     VkRenderPass get_subpass(uint32_t subpass_index);
@@ -309,9 +380,17 @@ namespace gpu {
     uint32_t get_registers_index(const Registers &registers);
     const Registers &get_registers(uint32_t index) const ;
 
-    VkPipeline get_pipeline(const ComputePipeline &pipeline);
-    VkPipeline get_pipeline(const GraphicsPipeline &pipeline);
+    PipelineSlot &get_slot(const ComputePipeline &pipeline);
+    PipelineSlot &get_slot(const GraphicsPipeline &pipeline);
+    VkPipeline create_pipeline(const ComputePipeline &pipeline);
+    VkPipeline create_pipeline(const GraphicsPipeline &pipeline);
+
+    template <typename PipelineT>
+    VkPipeline get_pipeline(const PipelineT &pipeline);
+    template <typename PipelineT>
+    void request_pipeline(const PipelineT &pipeline);
     VkRenderPass get_renderpass(const GraphicsPipeline &pipeline);
+    VkRenderPass get_renderpass(const GraphicsPipeline &pipeline, const std::vector<AttachmentOps> &ops);
 
     friend BasePipeline;
     friend ComputePipeline;
@@ -1,4 +1,5 @@
 #include "samplers.hpp"
+#include "bindless.hpp"
 
 #include <iostream>
 #include <cstring>
@@ -52,6 +53,7 @@ namespace gpu {
 
   const SamplerPool &SamplerPool::operator=(SamplerPool &&pool) {
     samplers = std::move(pool.samplers);
+    indices = std::move(pool.indices);
     return *this;
   }
 
@@ -67,7 +69,16 @@ namespace gpu {
     VkSampler new_sampler {nullptr};
     VKCHECK(vkCreateSampler(internal::app_vk_device(), &info, nullptr, &new_sampler));
     samplers[info] = new_sampler;
+
+    if (auto heap = app_bindless_heap()) {
+      indices[new_sampler] = heap->add_sampler(new_sampler);
+    }
     return new_sampler;
   }
 
+  uint32_t SamplerPool::get_index(VkSampler sampler) const {
+    auto it = indices.find(sampler);
+    return (it != indices.end())? it->second : INVALID_BINDLESS_INDEX;
+  }
+
 }
\ No newline at end of file
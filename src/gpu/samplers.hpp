@@ -21,16 +21,19 @@ namespace gpu {
 
   struct SamplerPool {
     SamplerPool() {}
-    SamplerPool(SamplerPool &&pool) :  samplers {std::move(pool.samplers)} { }
+    SamplerPool(SamplerPool &&pool) :  samplers {std::move(pool.samplers)}, indices {std::move(pool.indices)} { }
     ~SamplerPool();
 
     VkSampler get_sampler(const VkSamplerCreateInfo &info);
+    //index in the bindless heap, assigned when the sampler is created
+    uint32_t get_index(VkSampler sampler) const;
     const SamplerPool &operator=(SamplerPool &&pool);
   private:
     SamplerPool(const SamplerPool &) = delete;
     SamplerPool &operator=(const SamplerPool &) = delete;
 
     std::unordered_map<VkSamplerCreateInfo, VkSampler, SamplerHashFunc, SamplerEqualFunc> samplers;
+    std::unordered_map<VkSampler, uint32_t> indices;
   };
 
   constexpr VkSamplerCreateInfo DEFAULT_SAMPLER {
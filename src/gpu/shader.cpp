@@ -3,6 +3,8 @@
 #include <iostream>
 #include <fstream>
 #include <cassert>
+#include <algorithm>
+#include <mutex>
 
 #include <sstream>
 #include <initializer_list>
@@ -10,101 +12,291 @@
 namespace gpu {
   
 
-  DescriptorPool::DescriptorPool(uint32_t flips_count) 
+  static DescriptorPoolUsage default_block_size() {
+    DescriptorPoolUsage size {};
+    size.sets = 512;
+    for (uint32_t i = 0; i < POOL_DESCRIPTOR_TYPES_COUNT; i++) {
+      size.descriptors[i] = (POOL_DESCRIPTOR_TYPES[i] == VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE)? 128 : 512;
+    }
+    return size;
+  }
+
+  //next blocks get headroom over the largest usage seen
+  static DescriptorPoolUsage grow_block_size(const DescriptorPoolUsage &high_water) {
+    DescriptorPoolUsage size = default_block_size();
+    size.sets = std::max(size.sets, high_water.sets + high_water.sets/2);
+    for (uint32_t i = 0; i < POOL_DESCRIPTOR_TYPES_COUNT; i++) {
+      size.descriptors[i] = std::max(size.descriptors[i], high_water.descriptors[i] + high_water.descriptors[i]/2);
+    }
+    return size;
+  }
+
+  void DescriptorPoolUsage::add(const DescriptorPoolUsage &usage) {
+    sets += usage.sets;
+    for (uint32_t i = 0; i < POOL_DESCRIPTOR_TYPES_COUNT; i++) {
+      descriptors[i] += usage.descriptors[i];
+    }
+  }
+
+  void DescriptorPoolUsage::sub(const DescriptorPoolUsage &usage) {
+    sets -= std::min(sets, usage.sets);
+    for (uint32_t i = 0; i < POOL_DESCRIPTOR_TYPES_COUNT; i++) {
+      descriptors[i] -= std::min(descriptors[i], usage.descriptors[i]);
+    }
+  }
+
+  void DescriptorPoolUsage::max(const DescriptorPoolUsage &usage) {
+    sets = std::max(sets, usage.sets);
+    for (uint32_t i = 0; i < POOL_DESCRIPTOR_TYPES_COUNT; i++) {
+      descriptors[i] = std::max(descriptors[i], usage.descriptors[i]);
+    }
+  }
+
+  bool DescriptorPoolUsage::fits(const DescriptorPoolUsage &capacity) const {
+    if (sets > capacity.sets) {
+      return false;
+    }
+    for (uint32_t i = 0; i < POOL_DESCRIPTOR_TYPES_COUNT; i++) {
+      if (descriptors[i] > capacity.descriptors[i]) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  int32_t get_pool_type_index(VkDescriptorType type) {
+    for (uint32_t i = 0; i < POOL_DESCRIPTOR_TYPES_COUNT; i++) {
+      if (POOL_DESCRIPTOR_TYPES[i] == type) {
+        return i;
+      }
+    }
+    return -1;
+  }
+
+  struct LayoutUsage {
+    DescriptorPoolUsage usage;
+    int32_t variable_type = -1;
+  };
+
+  //layouts are registered when programs are created, pools read them from recording threads
+  static std::shared_mutex g_layouts_lock;
+  static std::unordered_map<VkDescriptorSetLayout, LayoutUsage> g_layout_usage;
+
+  void register_layout_usage(VkDescriptorSetLayout layout, const DescriptorPoolUsage &usage, int32_t variable_type) {
+    std::unique_lock lock {g_layouts_lock};
+    g_layout_usage[layout] = LayoutUsage {usage, variable_type};
+  }
+
+  void unregister_layout_usage(VkDescriptorSetLayout layout) {
+    std::unique_lock lock {g_layouts_lock};
+    g_layout_usage.erase(layout);
+  }
+
+  DescriptorPoolUsage get_layout_usage(VkDescriptorSetLayout layout, uint32_t variable_size) {
+    DescriptorPoolUsage usage {};
+    {
+      std::shared_lock lock {g_layouts_lock};
+      auto iter = g_layout_usage.find(layout);
+      if (iter != g_layout_usage.end()) {
+        usage = iter->second.usage;
+        if (iter->second.variable_type >= 0) {
+          usage.descriptors[iter->second.variable_type] += variable_size;
+        }
+      }
+    }
+    usage.sets = 1;
+    return usage;
+  }
+
+  DescriptorBlockChain::DescriptorBlockChain(DescriptorBlockChain &&o)
+    : flags {o.flags}, blocks {std::move(o.blocks)}, active {o.active}, overflows {o.overflows}, usage {o.usage}
   {
-    VkDescriptorPoolSize sizes[] {
-      {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 512},
-      {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 512},
-      {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 512},
-      {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 512},
-      {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 512},
-      {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 128},
-      {VK_DESCRIPTOR_TYPE_SAMPLER, 512}
-    };
+    o.blocks.clear();
+  }
+
+  DescriptorBlockChain &DescriptorBlockChain::operator=(DescriptorBlockChain &&o) {
+    std::swap(flags, o.flags);
+    std::swap(blocks, o.blocks);
+    std::swap(active, o.active);
+    std::swap(overflows, o.overflows);
+    std::swap(usage, o.usage);
+    return *this;
+  }
+
+  void DescriptorBlockChain::push_block(const DescriptorPoolUsage &size) {
+    VkDescriptorPoolSize sizes[POOL_DESCRIPTOR_TYPES_COUNT];
+    for (uint32_t i = 0; i < POOL_DESCRIPTOR_TYPES_COUNT; i++) {
+      sizes[i] = VkDescriptorPoolSize {POOL_DESCRIPTOR_TYPES[i], std::max(size.descriptors[i], 1u)};
+    }
 
     VkDescriptorPoolCreateInfo info {
       .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
       .pNext = nullptr,
-      .flags = 0,
-      .maxSets = 512,
-      .poolSizeCount = sizeof(sizes)/sizeof(sizes[0]),
+      .flags = flags,
+      .maxSets = std::max(size.sets, 1u),
+      .poolSizeCount = POOL_DESCRIPTOR_TYPES_COUNT,
       .pPoolSizes = sizes
     };
-    
-    pools.resize(flips_count);
-    
+
+    VkDescriptorPool pool {VK_NULL_HANDLE};
+    VKCHECK(vkCreateDescriptorPool(internal::app_vk_device(), &info, nullptr, &pool));
+    blocks.push_back(pool);
+  }
+
+  uint32_t DescriptorBlockChain::allocate(VkDescriptorSetAllocateInfo info, const DescriptorPoolUsage &sets_usage, const DescriptorPoolUsage &block_size, VkDescriptorSet *sets) {
+    //freed sets leave holes in earlier blocks of free-able chains
+    uint32_t first = (flags & VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT)? 0 : active;
+
+    for (uint32_t i = first; i < blocks.size(); i++) {
+      info.descriptorPool = blocks[i];
+      auto res = vkAllocateDescriptorSets(internal::app_vk_device(), &info, sets);
+      if (res == VK_ERROR_OUT_OF_POOL_MEMORY || res == VK_ERROR_FRAGMENTED_POOL) {
+        continue;
+      }
+      VKCHECK(res);
+      active = std::max(active, i);
+      usage.add(sets_usage);
+      return i;
+    }
+
+    auto size = usage;
+    size.add(sets_usage);
+    size.max(block_size);
+    size.max(default_block_size());
+    push_block(size);
+    if (blocks.size() > 1) {
+      overflows++;
+    }
+
+    active = blocks.size() - 1;
+    info.descriptorPool = blocks.back();
+    VKCHECK(vkAllocateDescriptorSets(internal::app_vk_device(), &info, sets));
+    usage.add(sets_usage);
+    return active;
+  }
+
+  void DescriptorBlockChain::reset() {
+    for (auto block : blocks) {
+      VKCHECK(vkResetDescriptorPool(internal::app_vk_device(), block, 0));
+    }
+    active = 0;
+    usage = {};
+  }
+
+  void DescriptorBlockChain::rebuild(const DescriptorPoolUsage &block_size) {
+    destroy();
+    push_block(block_size);
+  }
+
+  void DescriptorBlockChain::destroy() {
+    for (auto block : blocks) {
+      vkDestroyDescriptorPool(internal::app_vk_device(), block, nullptr);
+    }
+    blocks.clear();
+    active = 0;
+    usage = {};
+  }
+
+  //ext may hold variable descriptor counts of the sets
+  static DescriptorPoolUsage get_set_usage(const VkDescriptorSetLayout *set_layouts, const void *ext, uint32_t index) {
+    auto variable_info = static_cast<const VkDescriptorSetVariableDescriptorCountAllocateInfo *>(ext);
+    uint32_t variable_size = (variable_info && index < variable_info->descriptorSetCount)? variable_info->pDescriptorCounts[index] : 0;
+    return get_layout_usage(set_layouts[index], variable_size);
+  }
+
+  static DescriptorPoolUsage get_sets_usage(uint32_t sets_count, const VkDescriptorSetLayout *set_layouts, const void *ext) {
+    DescriptorPoolUsage usage {};
+    for (uint32_t i = 0; i < sets_count; i++) {
+      usage.add(get_set_usage(set_layouts, ext, i));
+    }
+    return usage;
+  }
+
+  DescriptorPool::DescriptorPool(uint32_t flips_count) 
+  {
+    chains.reserve(flips_count);
     for (uint32_t i = 0; i < flips_count; i++) {
-      VKCHECK(vkCreateDescriptorPool(internal::app_vk_device(), &info, nullptr, &pools[i]));
+      chains.emplace_back(0);
+      chains.back().rebuild(default_block_size());
     }
+    stats.blocks = flips_count;
   }
   
   DescriptorPool::~DescriptorPool() {
-    for (uint32_t i = 0; i < pools.size(); i++) {
-      vkDestroyDescriptorPool(internal::app_vk_device(), pools[i], nullptr);
-    }
+    chains.clear();
   }
 
   void DescriptorPool::flip() {
-    index = (index + 1) % pools.size();
-    VKCHECK(vkResetDescriptorPool(internal::app_vk_device(), pools[index], 0));
+    stats.current = chains[index].get_usage();
+    stats.high_water.max(stats.current);
+
+    index = (index + 1) % chains.size();
+    auto &chain = chains[index];
+    if (chain.get_blocks_count() > 1) {
+      chain.rebuild(grow_block_size(stats.high_water));
+    } else {
+      chain.reset();
+    }
+
+    stats.blocks = 0;
+    stats.overflows = 0;
+    for (const auto &elem : chains) {
+      stats.blocks += elem.get_blocks_count();
+      stats.overflows += elem.get_overflows();
+    }
   }
   
   void DescriptorPool::allocate_sets(uint32_t sets_count, const VkDescriptorSetLayout *set_layouts, VkDescriptorSet *sets, void *ext) {
-    
     VkDescriptorSetAllocateInfo info {
       .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
       .pNext = ext,
-      .descriptorPool = pools[index],
+      .descriptorPool = VK_NULL_HANDLE,
       .descriptorSetCount = sets_count,
       .pSetLayouts = set_layouts
     };
 
-    VKCHECK(vkAllocateDescriptorSets(internal::app_vk_device(), &info, sets));
+    auto usage = get_sets_usage(sets_count, set_layouts, ext);
+    chains[index].allocate(info, usage, grow_block_size(stats.high_water), sets);
   }
 
-  StaticDescriptorPool::StaticDescriptorPool() {
-    VkDescriptorPoolSize sizes[] {
-      {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 512},
-      {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 512},
-      {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 512},
-      {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 512},
-      {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 512},
-      {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 128},
-      {VK_DESCRIPTOR_TYPE_SAMPLER, 512}
-    };
-
-    VkDescriptorPoolCreateInfo info {
-      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
-      .pNext = nullptr,
-      .flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT,
-      .maxSets = 512,
-      .poolSizeCount = sizeof(sizes)/sizeof(sizes[0]),
-      .pPoolSizes = sizes
-    };
-
-    VKCHECK(vkCreateDescriptorPool(internal::app_vk_device(), &info, nullptr, &pool));
+  StaticDescriptorPool::StaticDescriptorPool() : chain {VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT} {
+    chain.rebuild(default_block_size());
+    stats.blocks = 1;
   }
   
   StaticDescriptorPool::~StaticDescriptorPool() {
-    vkDestroyDescriptorPool(internal::app_vk_device(), pool, nullptr);
+    chain.destroy();
   }
 
   StaticDescriptorPool::StaticDescriptorPool(StaticDescriptorPool &&rhs)
-    : pool {rhs.pool}
+    : chain {std::move(rhs.chain)}, live_sets {std::move(rhs.live_sets)}, stats {rhs.stats}
   {
-    rhs.pool = nullptr;
+    rhs.live_sets.clear();
   }
 
-  void StaticDescriptorPool::allocate_sets(uint32_t sets_count, const VkDescriptorSetLayout *set_layouts, VkDescriptorSet *sets) {
+  void StaticDescriptorPool::allocate(const VkDescriptorSetLayout *set_layouts, VkDescriptorSet *sets, uint32_t count, void *ext) {
     VkDescriptorSetAllocateInfo info {
       .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
-      .pNext = nullptr,
-      .descriptorPool = pool,
-      .descriptorSetCount = sets_count,
+      .pNext = ext,
+      .descriptorPool = VK_NULL_HANDLE,
+      .descriptorSetCount = count,
       .pSetLayouts = set_layouts
     };
 
-    VKCHECK(vkAllocateDescriptorSets(internal::app_vk_device(), &info, sets));
+    auto usage = get_sets_usage(count, set_layouts, ext);
+    uint32_t block = chain.allocate(info, usage, grow_block_size(stats.high_water), sets);
+    for (uint32_t i = 0; i < count; i++) {
+      live_sets[sets[i]] = SetInfo {block, get_set_usage(set_layouts, ext, i)};
+    }
+
+    stats.current.add(usage);
+    stats.high_water.max(stats.current);
+    stats.blocks = chain.get_blocks_count();
+    stats.overflows = chain.get_overflows();
+  }
+
+  void StaticDescriptorPool::allocate_sets(uint32_t sets_count, const VkDescriptorSetLayout *set_layouts, VkDescriptorSet *sets) {
+    allocate(set_layouts, sets, sets_count, nullptr);
   }
   
   VkDescriptorSet StaticDescriptorPool::allocate_set(VkDescriptorSetLayout layout, uint32_t variable_sizes_count, const uint32_t *variable_sizes) {
@@ -114,22 +306,24 @@ namespace gpu {
       .descriptorSetCount = variable_sizes_count,
       .pDescriptorCounts = variable_sizes
     };
-    
-    VkDescriptorSetAllocateInfo info {
-      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
-      .pNext = variable_sizes_count? &ext : nullptr,
-      .descriptorPool = pool,
-      .descriptorSetCount = 1,
-      .pSetLayouts = &layout
-    };
 
     VkDescriptorSet set;
-    VKCHECK(vkAllocateDescriptorSets(internal::app_vk_device(), &info, &set));
+    allocate(&layout, &set, 1, variable_sizes_count? &ext : nullptr);
     return set;
   }
 
   void StaticDescriptorPool::free_sets(uint32_t sets_count, const VkDescriptorSet *sets) {
-    VKCHECK(vkFreeDescriptorSets(internal::app_vk_device(), pool, sets_count, sets));
+    for (uint32_t i = 0; i < sets_count; i++) {
+      auto iter = live_sets.find(sets[i]);
+      if (iter == live_sets.end()) {
+        throw std::runtime_error {"Descriptor set is not allocated from this pool"};
+      }
+
+      VKCHECK(vkFreeDescriptorSets(internal::app_vk_device(), chain.get_block(iter->second.block), 1, &sets[i]));
+      chain.release(iter->second.usage);
+      stats.current.sub(iter->second.usage);
+      live_sets.erase(iter);
+    }
   }
 
   ManagedDescriptorSet::ManagedDescriptorSet(StaticDescriptorPool &desc_pool, VkDescriptorSetLayout layout, uint32_t variable_sizes_count, const uint32_t *variable_sizes) {
@@ -6,15 +6,91 @@
 #include <unordered_map>
 #include <map>
 #include <optional>
+#include <shared_mutex>
 
 #include "driver.hpp"
 
 namespace gpu {
 
+  //descriptor types which pools reserve, other types are not counted
+  constexpr VkDescriptorType POOL_DESCRIPTOR_TYPES[] {
+    VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+    VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+    VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+    VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+    VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+    VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+    VK_DESCRIPTOR_TYPE_SAMPLER
+  };
+  constexpr uint32_t POOL_DESCRIPTOR_TYPES_COUNT = sizeof(POOL_DESCRIPTOR_TYPES)/sizeof(POOL_DESCRIPTOR_TYPES[0]);
+
+  //sets and descriptors in order of POOL_DESCRIPTOR_TYPES
+  struct DescriptorPoolUsage {
+    uint32_t sets = 0;
+    std::array<uint32_t, POOL_DESCRIPTOR_TYPES_COUNT> descriptors {};
+
+    void add(const DescriptorPoolUsage &usage);
+    void sub(const DescriptorPoolUsage &usage);
+    void max(const DescriptorPoolUsage &usage);
+    bool fits(const DescriptorPoolUsage &capacity) const;
+  };
+
+  struct DescriptorPoolStats {
+    //for frame pools the last finished frame, for static pools live sets
+    DescriptorPoolUsage current;
+    DescriptorPoolUsage high_water;
+    uint32_t blocks = 0;
+    //blocks chained because allocation ran out of pool memory
+    uint32_t overflows = 0;
+  };
+
+  //-1 for types which pools don't reserve
+  int32_t get_pool_type_index(VkDescriptorType type);
+
+  //descriptor counts of layouts, pools use them to learn sizes of new blocks.
+  //Layouts from DescriptorSetLayoutCache are registered, others count only as sets
+  void register_layout_usage(VkDescriptorSetLayout layout, const DescriptorPoolUsage &usage, int32_t variable_type = -1);
+  void unregister_layout_usage(VkDescriptorSetLayout layout);
+  //variable_size replaces count of variable sized binding
+  DescriptorPoolUsage get_layout_usage(VkDescriptorSetLayout layout, uint32_t variable_size = 0);
+
+  //list of VkDescriptorPool blocks, a new block is chained when allocation from the last one fails
+  struct DescriptorBlockChain {
+    DescriptorBlockChain(VkDescriptorPoolCreateFlags pool_flags) : flags {pool_flags} {}
+    ~DescriptorBlockChain() { destroy(); }
+
+    //new block is at least block_size and default size, it grows to fit usage of the chain. Returns index of block
+    uint32_t allocate(VkDescriptorSetAllocateInfo info, const DescriptorPoolUsage &sets_usage, const DescriptorPoolUsage &block_size, VkDescriptorSet *sets);
+    void reset();
+    //replaces all blocks with one block, sets must be unused
+    void rebuild(const DescriptorPoolUsage &block_size);
+    void destroy();
+
+    VkDescriptorPool get_block(uint32_t index) const { return blocks.at(index); }
+    uint32_t get_blocks_count() const { return blocks.size(); }
+    const DescriptorPoolUsage &get_usage() const { return usage; }
+    void release(const DescriptorPoolUsage &sets_usage) { usage.sub(sets_usage); }
+    uint32_t get_overflows() const { return overflows; }
+
+    DescriptorBlockChain(DescriptorBlockChain &&o);
+    DescriptorBlockChain &operator=(DescriptorBlockChain &&o);
+    DescriptorBlockChain(const DescriptorBlockChain &) = delete;
+    DescriptorBlockChain &operator=(const DescriptorBlockChain &) = delete;
+  private:
+    VkDescriptorPoolCreateFlags flags = 0;
+    std::vector<VkDescriptorPool> blocks;
+    uint32_t active = 0;
+    uint32_t overflows = 0;
+    DescriptorPoolUsage usage;
+
+    void push_block(const DescriptorPoolUsage &size);
+  };
+
   struct DescriptorPool {
     DescriptorPool(uint32_t flips_count);
     ~DescriptorPool();
 
+    //chain of the next frame is reset. If it overflowed, it is rebuilt as one block sized by the high-water mark
     void flip();
     void allocate_sets(uint32_t sets_count, const VkDescriptorSetLayout *set_layouts, VkDescriptorSet *sets, void *ext = nullptr);
     
@@ -37,19 +113,23 @@ namespace gpu {
       return out;
     }
 
-    DescriptorPool(DescriptorPool &&o) : pools {std::move(o.pools)}, index {o.index} {}
+    DescriptorPool(DescriptorPool &&o) : chains {std::move(o.chains)}, index {o.index}, stats {o.stats} {}
   
     const DescriptorPool &operator=(DescriptorPool &&o) {
-      std::swap(pools, o.pools);
+      std::swap(chains, o.chains);
       std::swap(index, o.index);
+      std::swap(stats, o.stats);
       return *this;
     }
 
-    VkDescriptorPool current_pool() const { return pools[index]; }
+    //first block of the current frame, for users which allocate from the pool directly
+    VkDescriptorPool current_pool() const { return chains[index].get_block(0); }
+    const DescriptorPoolStats &get_stats() const { return stats; }
     
   private:
-    std::vector<VkDescriptorPool> pools;
+    std::vector<DescriptorBlockChain> chains;
     uint32_t index = 0;
+    DescriptorPoolStats stats;
   
     DescriptorPool(DescriptorPool&)=delete;
     const DescriptorPool &operator=(const DescriptorPool&)=delete;
@@ -64,12 +144,22 @@ namespace gpu {
     VkDescriptorSet allocate_set(VkDescriptorSetLayout layout, uint32_t variable_sizes_count, const uint32_t *variable_sizes);
 
     void free_sets(uint32_t sets_count, const VkDescriptorSet *sets);
+    const DescriptorPoolStats &get_stats() const { return stats; }
 
     StaticDescriptorPool(StaticDescriptorPool&) = delete;
     StaticDescriptorPool &operator=(const StaticDescriptorPool &) = delete;
   private:
-    VkDescriptorPool pool;
-    
+    struct SetInfo {
+      uint32_t block;
+      DescriptorPoolUsage usage;
+    };
+
+    DescriptorBlockChain chain;
+    //sets are freed to the block they came from
+    std::unordered_map<VkDescriptorSet, SetInfo> live_sets;
+    DescriptorPoolStats stats;
+
+    void allocate(const VkDescriptorSetLayout *set_layouts, VkDescriptorSet *sets, uint32_t count, void *ext);
   };
   
   struct ManagedDescriptorSet {
@@ -1,60 +1,92 @@
 #include "shader_program.hpp"
+#include "shader.hpp"
+#include "bindless.hpp"
 
 #include <stdexcept>
 #include <fstream>
 #include <sstream>
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <lib/spirv-reflect/spirv_reflect.h>
 
 namespace gpu {
   
-  void DescriptorSetLayoutInfo::parse_resources(VkShaderStageFlagBits stage, const SpvReflectDescriptorSet *set) {
-    for (uint32_t i = 0u; i < set->binding_count; i++) {
-      const auto &spv_binding = *set->bindings[i];
-      if (spv_binding.binding >= MAX_BINDINGS)
-        throw std::runtime_error {"Too many bindings"};
+  void DescriptorSetLayoutInfo::parse_resources(VkShaderStageFlagBits stage, const ShaderBinding &spv_binding) {
+    if (spv_binding.binding >= MAX_BINDINGS)
+      throw std::runtime_error {"Too many bindings"};
 
+    uint32_t spv_binding_count = spv_binding.count;
 
-      uint32_t spv_binding_count = 1;
-      for (uint32_t i = 0; i < spv_binding.array.dims_count; i++) {
-        spv_binding_count *= spv_binding.array.dims[i];
-      }
+    auto spv_desc_type = spv_binding.type;
+    if (spv_desc_type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER)
+      spv_desc_type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 
-      auto spv_desc_type = static_cast<VkDescriptorType>(spv_binding.descriptor_type);
-      if (spv_desc_type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER)
-        spv_desc_type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    bool spv_bindless = spv_binding_count == 0;
+    if (spv_bindless) {
+      spv_binding_count = 1024;
+      bindless_bindings = true;
+    }
+
+    if (valid_bindings.test(spv_binding.binding)) {
+      auto &api_binding = bindings[spv_binding.binding];
 
-      bool spv_bindless = spv_binding_count == 0;
-      if (spv_bindless) {
-        spv_binding_count = 1024;
-        bindless_bindings = true;
+      if (api_binding.descriptorType != spv_desc_type)  {
+        throw std::runtime_error {"Incompatible desc. type"};
       }
 
-      if (valid_bindings.test(spv_binding.binding)) {
-        auto &api_binding = bindings[spv_binding.binding];
+      if (api_binding.descriptorCount != spv_binding_count) {
+        throw std::runtime_error {"Bindings count mismatch"};
+      }
 
-        if (api_binding.descriptorType != spv_desc_type)  {
-          throw std::runtime_error {"Incompatible desc. type"};
-        }
+      api_binding.stageFlags |= stage;
+      return;
+    }
 
-        if (api_binding.descriptorCount != spv_binding_count) {
-          throw std::runtime_error {"Bindings count mismatch"};
-        }
+    VkDescriptorSetLayoutBinding api_binding {};
+    api_binding.binding = spv_binding.binding;
+    api_binding.descriptorType = spv_desc_type;
+    api_binding.stageFlags = stage;
+    api_binding.descriptorCount = spv_binding_count;
+    
+    valid_bindings.set(spv_binding.binding);
+    bindings[spv_binding.binding] = api_binding;
+    flags[spv_binding.binding] = spv_bindless? (VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT|VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT) : 0;
 
-        api_binding.stageFlags |= stage;
-        continue;
+    used_bindings = ((spv_binding.binding + 1) > used_bindings)? (spv_binding.binding + 1) : used_bindings; 
+  }
+
+  uint32_t DescriptorSetLayoutInfo::get_descriptors_count() const {
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < used_bindings; i++) {
+      if (valid_bindings.test(i)) {
+        count += bindings[i].descriptorCount;
       }
+    }
+    return count;
+  }
 
-      VkDescriptorSetLayoutBinding api_binding {};
-      api_binding.binding = spv_binding.binding;
-      api_binding.descriptorType = spv_desc_type;
-      api_binding.stageFlags = stage;
-      api_binding.descriptorCount = spv_binding_count;
-      
-      valid_bindings.set(spv_binding.binding);
-      bindings[spv_binding.binding] = api_binding;
-      flags[spv_binding.binding] = spv_bindless? (VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT|VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT) : 0;
+  void DescriptorSetLayoutInfo::set_push_descriptor() {
+    if (bindless_bindings)
+      throw std::runtime_error {"Push descriptor set can't have bindless bindings"};
+
+    for (uint32_t i = 0; i < used_bindings; i++) {
+      if (!valid_bindings.test(i))
+        continue;
 
-      used_bindings = ((spv_binding.binding + 1) > used_bindings)? (spv_binding.binding + 1) : used_bindings; 
+      auto &type = bindings[i].descriptorType;
+      if (type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC)
+        type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+      else if (type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC)
+        type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
     }
+    push_descriptor = true;
   }
 
   VkDescriptorSetLayout DescriptorSetLayoutInfo::create_api_layout(VkDevice device) const {
@@ -81,7 +113,7 @@ namespace gpu {
     VkDescriptorSetLayoutCreateInfo info {
       .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
       .pNext = &flags_info,
-      .flags = 0,
+      .flags = push_descriptor? VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR : 0u,
       .bindingCount = elems_count,
       .pBindings = info_bindings.data()
     };
@@ -91,6 +123,81 @@ namespace gpu {
     return layout;
   }
 
+  static uint32_t get_descriptor_info_size(VkDescriptorType type) {
+    switch (type) {
+    case VK_DESCRIPTOR_TYPE_SAMPLER:
+    case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+    case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+    case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+    case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
+      return sizeof(VkDescriptorImageInfo);
+    case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+    case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+    case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
+    case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
+      return sizeof(VkDescriptorBufferInfo);
+    case VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR:
+      return sizeof(VkAccelerationStructureKHR);
+    default:
+      return sizeof(VkBufferView);
+    }
+  }
+
+  static DescriptorUpdateTemplate create_update_template(const DescriptorSetLayoutInfo &info, VkDescriptorSetLayout layout) {
+    DescriptorUpdateTemplate desc_template {};
+    desc_template.offsets.fill(INVALID_DESCRIPTOR_OFFSET);
+    //push templates are bound to a pipeline layout, pushed sets are written from bindings
+    if (info.is_push_descriptor()) {
+      return desc_template;
+    }
+
+    std::array<VkDescriptorUpdateTemplateEntry, MAX_BINDINGS> entries;
+    uint32_t entries_count = 0;
+
+    for (uint32_t i = 0; i < info.get_used_bindings(); i++) {
+      if (!info.has_binding(i) || (info.get_flags(i) & VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT)) {
+        continue;
+      }
+
+      const auto &binding = info.get_binding(i);
+      uint32_t stride = get_descriptor_info_size(binding.descriptorType);
+
+      desc_template.offsets[i] = desc_template.data_size;
+      desc_template.counts[i] = binding.descriptorCount;
+      desc_template.types[i] = binding.descriptorType;
+
+      entries[entries_count++] = VkDescriptorUpdateTemplateEntry {
+        .dstBinding = binding.binding,
+        .dstArrayElement = 0,
+        .descriptorCount = binding.descriptorCount,
+        .descriptorType = binding.descriptorType,
+        .offset = desc_template.data_size,
+        .stride = stride
+      };
+      desc_template.data_size += stride * binding.descriptorCount;
+    }
+
+    if (!entries_count || desc_template.data_size > MAX_DESCRIPTOR_DATA_SIZE) {
+      return desc_template;
+    }
+
+    VkDescriptorUpdateTemplateCreateInfo create_info {
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO,
+      .pNext = nullptr,
+      .flags = 0,
+      .descriptorUpdateEntryCount = entries_count,
+      .pDescriptorUpdateEntries = entries.data(),
+      .templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET,
+      .descriptorSetLayout = layout,
+      .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+      .pipelineLayout = nullptr,
+      .set = 0
+    };
+
+    VKCHECK(vkCreateDescriptorUpdateTemplate(internal::app_vk_device(), &create_info, nullptr, &desc_template.handle));
+    return desc_template;
+  }
+
   DescriptorLayoutId DescriptorSetLayoutCache::register_layout(const DescriptorSetLayoutInfo &info) {
     auto it = map.find(info);
     if (it != map.end())
@@ -100,17 +207,53 @@ namespace gpu {
     map.insert({info, id});
     desc_info.push_back(info);
     vk_layouts.push_back(info.create_api_layout(internal::app_vk_device()));
+    templates.push_back(create_update_template(info, vk_layouts.back()));
+
+    //pushed sets are never allocated from pools
+    if (info.is_push_descriptor()) {
+      return id;
+    }
+
+    DescriptorPoolUsage usage {};
+    int32_t variable_type = -1;
+    for (uint32_t i = 0; i < info.get_used_bindings(); i++) {
+      if (!info.has_binding(i)) {
+        continue;
+      }
+
+      const auto &binding = info.get_binding(i);
+      auto type_index = get_pool_type_index(binding.descriptorType);
+      if (type_index < 0) {
+        continue;
+      }
+
+      //actual count is passed when set is allocated
+      if (info.get_flags(i) & VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT) {
+        variable_type = type_index;
+      } else {
+        usage.descriptors[type_index] += binding.descriptorCount;
+      }
+    }
+    register_layout_usage(vk_layouts.back(), usage, variable_type);
     return id;
   }
   
   void DescriptorSetLayoutCache::clear() {
+    for (auto &desc_template : templates) {
+      if (desc_template.handle) {
+        vkDestroyDescriptorUpdateTemplate(internal::app_vk_device(), desc_template.handle, nullptr);
+      }
+    }
+
     for (auto layout : vk_layouts) {
+      unregister_layout_usage(layout);
       vkDestroyDescriptorSetLayout(internal::app_vk_device(), layout, nullptr);
     }
 
     map.clear();
     desc_info.clear();
     vk_layouts.clear();
+    templates.clear();
   }
 
   static std::vector<char> read_file(const std::string& filename) {
@@ -131,14 +274,172 @@ namespace gpu {
     return buffer;
   }
 
-  ShaderModule::ShaderModule(const std::string_view &prog_path)
+  #define SPVR_ASSER(res) if ((res) != SPV_REFLECT_RESULT_SUCCESS) throw std::runtime_error {"SPVReflect error"}
+
+  static ShaderReflection reflect_shader(const std::vector<char> &code) {
+    SpvReflectShaderModule spv_module {};
+    if (spvReflectCreateShaderModule(code.size(), code.data(), &spv_module) != SPV_REFLECT_RESULT_SUCCESS) {
+      throw std::runtime_error {"Shader parsing error"};
+    }
+
+    ShaderReflection reflection;
+    try {
+      reflection.stage = static_cast<VkShaderStageFlagBits>(spv_module.shader_stage);
+      reflection.entry_point = spv_module.entry_point_name;
+
+      uint32_t count = 0;
+      SPVR_ASSER(spvReflectEnumerateDescriptorSets(&spv_module, &count, nullptr));
+      std::vector<SpvReflectDescriptorSet*> sets(count);
+      SPVR_ASSER(spvReflectEnumerateDescriptorSets(&spv_module, &count, sets.data()));
+
+      for (auto set : sets) {
+        for (uint32_t i = 0; i < set->binding_count; i++) {
+          const auto &spv_binding = *set->bindings[i];
+          uint32_t binding_count = 1;
+          for (uint32_t dim = 0; dim < spv_binding.array.dims_count; dim++) {
+            binding_count *= spv_binding.array.dims[dim];
+          }
+
+          reflection.bindings.push_back(ShaderBinding {
+            set->set,
+            spv_binding.binding,
+            static_cast<VkDescriptorType>(spv_binding.descriptor_type),
+            binding_count
+          });
+        }
+      }
+
+      reflection.push_constant_blocks = spv_module.push_constant_block_count;
+      if (spv_module.push_constant_block_count) {
+        reflection.push_constant_offset = spv_module.push_constant_blocks[0].offset;
+        reflection.push_constant_size = spv_module.push_constant_blocks[0].size;
+      }
+    } catch (...) {
+      spvReflectDestroyShaderModule(&spv_module);
+      throw;
+    }
+
+    spvReflectDestroyShaderModule(&spv_module);
+    return reflection;
+  }
+
+  constexpr uint32_t REFLECTION_CACHE_MAGIC = 0x46525053; //SPRF
+  constexpr uint32_t REFLECTION_CACHE_VERSION = 1;
+
+  //entry point name and bindings follow the header
+  struct ReflectionCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t code_hash;
+    uint64_t code_size;
+    uint32_t stage;
+    uint32_t entry_point_size;
+    uint32_t bindings_count;
+    uint32_t push_constant_blocks;
+    uint32_t push_constant_offset;
+    uint32_t push_constant_size;
+  };
+
+  //read-only mapping of a whole file, empty if file can't be mapped
+  struct MappedFile {
+    MappedFile(const std::string &path) {
+      int fd = ::open(path.c_str(), O_RDONLY);
+      if (fd < 0) {
+        return;
+      }
+
+      struct stat info {};
+      if (::fstat(fd, &info) == 0 && info.st_size > 0) {
+        auto ptr = ::mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (ptr != MAP_FAILED) {
+          bytes = static_cast<const uint8_t*>(ptr);
+          size = info.st_size;
+        }
+      }
+      ::close(fd);
+    }
+
+    ~MappedFile() {
+      if (bytes) {
+        ::munmap(const_cast<uint8_t*>(bytes), size);
+      }
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    const uint8_t *bytes = nullptr;
+    std::size_t size = 0;
+  };
+
+  static std::string reflection_cache_path(const std::string &shader_path) {
+    return shader_path + ".refl";
+  }
+
+  static bool load_reflection(const std::string &path, uint64_t code_hash, uint64_t code_size, ShaderReflection &reflection) {
+    MappedFile file {path};
+    ReflectionCacheHeader header {};
+    if (file.size < sizeof(header)) {
+      return false;
+    }
+
+    std::memcpy(&header, file.bytes, sizeof(header));
+    if (header.magic != REFLECTION_CACHE_MAGIC || header.version != REFLECTION_CACHE_VERSION
+      || header.code_hash != code_hash || header.code_size != code_size) {
+      return false;
+    }
+
+    std::size_t expected_size = sizeof(header) + header.entry_point_size + std::size_t(header.bindings_count) * sizeof(ShaderBinding);
+    if (file.size != expected_size) {
+      return false;
+    }
+
+    auto ptr = file.bytes + sizeof(header);
+    reflection.stage = static_cast<VkShaderStageFlagBits>(header.stage);
+    reflection.entry_point.assign(reinterpret_cast<const char*>(ptr), header.entry_point_size);
+    ptr += header.entry_point_size;
+
+    reflection.bindings.resize(header.bindings_count);
+    if (header.bindings_count) {
+      std::memcpy(reflection.bindings.data(), ptr, header.bindings_count * sizeof(ShaderBinding));
+    }
+
+    reflection.push_constant_blocks = header.push_constant_blocks;
+    reflection.push_constant_offset = header.push_constant_offset;
+    reflection.push_constant_size = header.push_constant_size;
+    return true;
+  }
+
+  //failure to write only means that the next load reflects shader again
+  static void save_reflection(const std::string &path, uint64_t code_hash, uint64_t code_size, const ShaderReflection &reflection) {
+    ReflectionCacheHeader header {
+      REFLECTION_CACHE_MAGIC,
+      REFLECTION_CACHE_VERSION,
+      code_hash,
+      code_size,
+      uint32_t(reflection.stage),
+      uint32_t(reflection.entry_point.size()),
+      uint32_t(reflection.bindings.size()),
+      reflection.push_constant_blocks,
+      reflection.push_constant_offset,
+      reflection.push_constant_size
+    };
+
+    std::ofstream file {path, std::ios::binary|std::ios::trunc};
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reflection.entry_point.data(), reflection.entry_point.size());
+    file.write(reinterpret_cast<const char*>(reflection.bindings.data()), reflection.bindings.size() * sizeof(ShaderBinding));
+  }
+
+  ShaderModule::ShaderModule(const std::string_view &prog_path, bool use_cache)
     : path {prog_path}
   {
-    reload();
+    reload(use_cache);
   }
   
   ShaderModule::ShaderModule(ShaderModule &&mod)
-    : path {std::move(mod.path)}, api_module {mod.api_module}, spv_module {mod.spv_module}
+    : path {std::move(mod.path)}, api_module {mod.api_module}, reflection {std::move(mod.reflection)},
+      reflection_cached {mod.reflection_cached}, write_time {mod.write_time}, code_hash {mod.code_hash}
   {
     mod.api_module = nullptr;
   }
@@ -148,15 +449,17 @@ namespace gpu {
       return;
 
     vkDestroyShaderModule(internal::app_vk_device(), api_module, nullptr);
-    spvReflectDestroyShaderModule(&spv_module);
   }
 
-  void ShaderModule::reload() {
+  void ShaderModule::reload(bool use_cache) {
     if (api_module) {
       vkDestroyShaderModule(internal::app_vk_device(), api_module, nullptr);
-      spvReflectDestroyShaderModule(&spv_module);
+      api_module = nullptr;
     }
 
+    //time is taken before reading, so a write during load is noticed by the next check
+    std::error_code error;
+    write_time = std::filesystem::last_write_time(path, error);
     auto code = read_file(path);
 
     VkShaderModuleCreateInfo create_info{};
@@ -166,15 +469,42 @@ namespace gpu {
 
     VKCHECK(vkCreateShaderModule(internal::app_vk_device(), &create_info, nullptr, &api_module));
 
-    if (spvReflectCreateShaderModule(code.size(), code.data(), &spv_module) != SPV_REFLECT_RESULT_SUCCESS) {
-      throw std::runtime_error {"Shader parsing error"};
+    code_hash = hash_bytes(code.data(), code.size());
+    auto cache_path = reflection_cache_path(path);
+    reflection_cached = use_cache && load_reflection(cache_path, code_hash, code.size(), reflection);
+    if (reflection_cached) {
+      return;
+    }
+
+    reflection = reflect_shader(code);
+    if (use_cache) {
+      save_reflection(cache_path, code_hash, code.size(), reflection);
+    }
+  }
+
+  bool ShaderModule::check_modified() {
+    std::error_code error;
+    auto time = std::filesystem::last_write_time(path, error);
+    //file may be missing while shader compiler rewrites it
+    if (error || time == write_time) {
+      return false;
+    }
+
+    auto code = read_file(path);
+    if (hash_bytes(code.data(), code.size()) == code_hash) {
+      write_time = time;
+      return false;
     }
+    return true;
   }
 
   ShaderModule &ShaderModule::operator=(ShaderModule &&mod) {
     std::swap(path, mod.path);
     std::swap(api_module, mod.api_module);
-    std::swap(spv_module, mod.spv_module);
+    std::swap(reflection, mod.reflection);
+    std::swap(reflection_cached, mod.reflection_cached);
+    std::swap(write_time, mod.write_time);
+    std::swap(code_hash, mod.code_hash);
     return *this;
   }
 
@@ -186,11 +516,20 @@ namespace gpu {
     }
 
     uint32_t index = module_names.size();
-    modules.emplace_back(name);
+    modules.emplace_back(name, use_reflection_cache);
     module_names.insert({name, index});
+    count_reflection(modules.back());
     return index;
   }
 
+  void ShaderProgramManager::count_reflection(const ShaderModule &mod) {
+    if (mod.is_reflection_cached()) {
+      reflection_stats.hits++;
+    } else {
+      reflection_stats.misses++;
+    }
+  }
+
   ShaderProgramId ShaderProgramManager::get_program(const std::string &name) const {
     auto it = prog_names.find(name);
     if (it == prog_names.end()) {
@@ -229,12 +568,16 @@ namespace gpu {
     }
   }
 
-  ShaderProgramId ShaderProgramManager::create_program(const std::string &name, const std::vector<std::string> &shaders) {
+  ShaderProgramId ShaderProgramManager::create_program(const std::string &name, const std::vector<std::string> &shaders, const std::bitset<MAX_DESCRIPTORS> &push_sets) {
     if (prog_names.find(name) != prog_names.end())
       throw std::runtime_error {"Program already created"};
+    if (push_sets.count() > 1)
+      throw std::runtime_error {"Only one push descriptor set is allowed"};
     
     ShaderProgInternal prog;
+    prog.name = name;
     prog.valid_sets.reset();
+    prog.push_requested = push_sets;
     prog.modules.reserve(shaders.size());
     prog.layout = nullptr;
 
@@ -267,8 +610,6 @@ namespace gpu {
     prog.modules.clear();
   }
 
-  #define SPVR_ASSER(res) if ((res) != SPV_REFLECT_RESULT_SUCCESS) throw std::runtime_error {"SPVReflect error"}
-
   void ShaderProgramManager::reset_program(ShaderProgInternal &prog) {
     if (prog.layout)
       vkDestroyPipelineLayout(internal::app_vk_device(), prog.layout, nullptr);
@@ -276,6 +617,7 @@ namespace gpu {
     prog.layout = nullptr;
     prog.constants = VkPushConstantRange {0u, 0u, 0u};
     prog.valid_sets.reset();
+    prog.push_sets.reset();
     
     std::array<DescriptorSetLayoutInfo, MAX_DESCRIPTORS> descriptors {};
     
@@ -283,32 +625,25 @@ namespace gpu {
       auto &smod = get_module(mod_id);
       auto &resources = smod.get_resources();
 
-      uint32_t count = 0;
-      SPVR_ASSER(spvReflectEnumerateDescriptorSets(&resources, &count, nullptr));
-
-      std::vector<SpvReflectDescriptorSet*> sets(count);
-      SPVR_ASSER(spvReflectEnumerateDescriptorSets(&resources, &count, sets.data()));
-
-      for (auto &set : sets) {
-        if (set->set >= MAX_DESCRIPTORS)
+      for (const auto &binding : resources.bindings) {
+        if (binding.set >= MAX_DESCRIPTORS)
           throw std::runtime_error {"Max set should be less then MAX_DESCRIPTORS"};
-        prog.valid_sets.set(set->set);
-        descriptors[set->set].parse_resources(smod.get_stage(), set);
+        prog.valid_sets.set(binding.set);
+        descriptors[binding.set].parse_resources(smod.get_stage(), binding);
       }
 
-      if (resources.push_constant_block_count > 1) {
+      if (resources.push_constant_blocks > 1) {
         throw std::runtime_error {"Only 1 push_const block is supported"};
       }
 
-      if (resources.push_constant_block_count) {
-        auto &blk = resources.push_constant_blocks[0];
-        if (blk.offset != 0) {
+      if (resources.push_constant_blocks) {
+        if (resources.push_constant_offset != 0) {
           throw std::runtime_error {"PushConst offset n e 0"};
         }
 
         if (!prog.constants.stageFlags) {
-          prog.constants.size = blk.size;
-        } else if (prog.constants.size != blk.size) {
+          prog.constants.size = resources.push_constant_size;
+        } else if (prog.constants.size != resources.push_constant_size) {
           throw std::runtime_error {"PushConst size mismatch"};
         }
 
@@ -316,12 +651,53 @@ namespace gpu {
       }
     }
 
+    //BINDLESS_SET is the global heap, its reflected bindings are only checked against the heap layout
+    prog.bindless_heap = prog.valid_sets.test(BINDLESS_SET);
+    if (prog.bindless_heap) {
+      const auto &heap_info = descriptors[BINDLESS_SET];
+      for (uint32_t i = 0; i < heap_info.get_used_bindings(); i++) {
+        if (!heap_info.has_binding(i))
+          continue;
+        if (i >= BINDLESS_TYPES_COUNT || heap_info.get_binding(i).descriptorType != BINDLESS_DESCRIPTOR_TYPES[i])
+          throw std::runtime_error {"Incompatible bindless heap binding"};
+      }
+      if (!app_bindless_heap())
+        throw std::runtime_error {"Bindless heap is not created"};
+      prog.valid_sets.reset(BINDLESS_SET);
+    }
+
+    uint32_t sets_count = prog.bindless_heap? BINDLESS_SET + 1 : 0;
+    for (uint32_t i = 0; i < MAX_DESCRIPTORS; i++) {
+      if (prog.valid_sets.test(i))
+        sets_count = std::max(sets_count, i + 1);
+    }
+
     std::vector<VkDescriptorSetLayout> vk_layouts;
     vk_layouts.reserve(MAX_DESCRIPTORS); 
     
-    for (uint32_t i = 0; i < MAX_DESCRIPTORS; i++) {
-      if (!prog.valid_sets.test(i))
+    const auto &device = app_device();
+    for (uint32_t i = 0; i < sets_count; i++) {
+      if (prog.bindless_heap && i == BINDLESS_SET) {
+        vk_layouts.push_back(app_bindless_heap()->get_layout());
+        continue;
+      }
+
+      //layouts are indexed by set number, unused sets below the last one are empty
+      if (!prog.valid_sets.test(i)) {
+        auto id = cached_descriptors.register_layout(DescriptorSetLayoutInfo {});
+        vk_layouts.push_back(cached_descriptors.get_layout(id));
         continue;
+      }
+
+      //without the extension or for big sets the regular allocation path is used
+      bool push = prog.push_requested.test(i) && device.has_push_descriptors()
+        && !descriptors[i].has_bindless_resources()
+        && descriptors[i].get_descriptors_count() <= device.get_max_push_descriptors();
+      if (push) {
+        descriptors[i].set_push_descriptor();
+        prog.push_sets.set(i);
+      }
+
       auto id = cached_descriptors.register_layout(descriptors[i]);
       
       prog.sets[i] = id;
@@ -353,9 +729,11 @@ namespace gpu {
     }
     
     cached_descriptors.clear();
+    layouts_generation++;
 
     for (auto &mod : modules) {
-      mod.reload();
+      mod.reload(use_reflection_cache);
+      count_reflection(mod);
     }
 
     for (auto &prog : programs) {
@@ -363,6 +741,46 @@ namespace gpu {
     }
   }
 
+  bool ShaderProgramManager::poll_changes() {
+    changed_modules.clear();
+    for (uint32_t i = 0; i < modules.size(); i++) {
+      if (modules[i].check_modified()) {
+        changed_modules.push_back(i);
+      }
+    }
+    return !changed_modules.empty();
+  }
+
+  std::vector<ShaderProgramId> ShaderProgramManager::reload_changed() {
+    std::vector<ShaderProgramId> changed_programs;
+    if (changed_modules.empty()) {
+      return changed_programs;
+    }
+
+    for (auto mod_id : changed_modules) {
+      auto &mod = get_module(mod_id);
+      std::cout << "Reloading " << mod.get_path() << "\n";
+      mod.reload(use_reflection_cache);
+      count_reflection(mod);
+    }
+
+    for (ShaderProgramId id = 0; id < programs.size(); id++) {
+      auto &prog = programs[id];
+      bool uses_changed = std::any_of(prog.modules.begin(), prog.modules.end(), [&](uint32_t mod_id){
+        return std::find(changed_modules.begin(), changed_modules.end(), mod_id) != changed_modules.end();
+      });
+
+      if (uses_changed) {
+        //layouts are cached and never destroyed here, sets allocated with old layouts are still valid
+        reset_program(prog);
+        changed_programs.push_back(id);
+      }
+    }
+
+    changed_modules.clear();
+    return changed_programs;
+  }
+
   void ShaderProgramManager::clear() {
     for (auto &prog : programs) {
       vkDestroyPipelineLayout(internal::app_vk_device(), prog.layout, nullptr);
@@ -376,6 +794,10 @@ namespace gpu {
     module_names.clear();
   }
 
+  const std::string &ShaderProgramManager::get_program_name(ShaderProgramId id) const {
+    return programs.at(id).name;
+  }
+
   VkPipelineLayout ShaderProgramManager::get_program_layout(ShaderProgramId id) const {
     return programs.at(id).layout;
   }
@@ -398,6 +820,21 @@ namespace gpu {
     return cached_descriptors.get_layout(prog.sets[set]); 
   }
 
+  const DescriptorUpdateTemplate &ShaderProgramManager::get_program_update_template(ShaderProgramId id, uint32_t set) const {
+    auto &prog = programs.at(id);
+    if (!prog.valid_sets.test(set))
+      throw std::runtime_error {"Program does not have required set"};
+    return cached_descriptors.get_update_template(prog.sets[set]);
+  }
+
+  bool ShaderProgramManager::is_push_descriptor(ShaderProgramId id, uint32_t set) const {
+    return programs.at(id).push_sets.test(set);
+  }
+
+  bool ShaderProgramManager::uses_bindless_heap(ShaderProgramId id) const {
+    return programs.at(id).bindless_heap;
+  }
+
   std::vector<VkPipelineShaderStageCreateInfo> ShaderProgramManager::get_stage_info(ShaderProgramId id) const {
     auto &prog = programs.at(id);
     
@@ -3,10 +3,13 @@
 
 #include "driver.hpp"
 
+#include <array>
 #include <bitset>
 #include <unordered_map>
-
-#include <lib/spirv-reflect/spirv_reflect.h>
+#include <deque>
+#include <string>
+#include <vector>
+#include <filesystem>
 
 namespace gpu {
   constexpr uint32_t MAX_BINDINGS = 16u;
@@ -24,16 +27,41 @@ namespace gpu {
     return !(a == b);
   }
 
+  struct ShaderBinding {
+    uint32_t set;
+    uint32_t binding;
+    VkDescriptorType type;
+    //0 for runtime arrays
+    uint32_t count;
+  };
+
+  //reflected data of a shader module, stored in .refl file next to .spv
+  struct ShaderReflection {
+    VkShaderStageFlagBits stage {};
+    std::string entry_point;
+    std::vector<ShaderBinding> bindings;
+    uint32_t push_constant_blocks = 0;
+    uint32_t push_constant_offset = 0;
+    uint32_t push_constant_size = 0;
+  };
+
+  struct ReflectionCacheStats {
+    uint32_t hits = 0;
+    uint32_t misses = 0;
+  };
+
   struct DescriptorSetLayoutHash;
 
   struct DescriptorSetLayoutInfo {
-    void parse_resources(VkShaderStageFlagBits stage, const SpvReflectDescriptorSet *set);
+    void parse_resources(VkShaderStageFlagBits stage, const ShaderBinding &binding);
 
     bool operator==(const DescriptorSetLayoutInfo &info) const {
       if (used_bindings != info.used_bindings)
         return false;
       if (valid_bindings != info.valid_bindings)
         return false;
+      if (push_descriptor != info.push_descriptor)
+        return false;
 
       for (uint32_t i = 0; i < used_bindings; i++) {
         if (!valid_bindings.test(i))
@@ -52,6 +80,10 @@ namespace gpu {
     uint32_t get_used_bindings() const { return used_bindings; };
     bool has_binding(uint32_t index) const { return valid_bindings.test(index); }
     bool has_bindless_resources() const { return bindless_bindings; }
+    bool is_push_descriptor() const { return push_descriptor; }
+    uint32_t get_descriptors_count() const;
+    //dynamic buffers are not allowed in push descriptor layouts, they become plain ones
+    void set_push_descriptor();
 
     const VkDescriptorSetLayoutBinding &get_binding(uint32_t index) const { return bindings.at(index); }
     VkDescriptorBindingFlags get_flags(uint32_t index) const { return flags.at(index); }
@@ -64,6 +96,7 @@ namespace gpu {
     std::bitset<MAX_BINDINGS> valid_bindings;
 
     bool bindless_bindings = false;
+    bool push_descriptor = false;
   
     friend DescriptorSetLayoutHash;
   };
@@ -71,6 +104,7 @@ namespace gpu {
   struct DescriptorSetLayoutHash {
     std::size_t operator()(const DescriptorSetLayoutInfo &res) const {
       std::size_t h = 0;
+      hash_combine(h, res.push_descriptor);
       for (uint32_t i = 0; i < res.used_bindings; i++) {
         if (!res.valid_bindings.test(i))
           continue;
@@ -87,6 +121,19 @@ namespace gpu {
 
   using DescriptorLayoutId = uint32_t;
 
+  constexpr uint32_t MAX_DESCRIPTOR_DATA_SIZE = 2048u;
+  constexpr uint32_t INVALID_DESCRIPTOR_OFFSET = UINT32_MAX;
+
+  //packing of DescriptorSetData for one set layout. Variable sized bindings are not in the template,
+  //layouts with more than MAX_DESCRIPTOR_DATA_SIZE bytes of infos and push descriptor layouts don't get a template
+  struct DescriptorUpdateTemplate {
+    VkDescriptorUpdateTemplate handle {nullptr};
+    std::array<uint32_t, MAX_BINDINGS> offsets;
+    std::array<uint32_t, MAX_BINDINGS> counts {};
+    std::array<VkDescriptorType, MAX_BINDINGS> types {};
+    uint32_t data_size = 0;
+  };
+
   struct DescriptorSetLayoutCache {
     DescriptorSetLayoutCache() {}
     ~DescriptorSetLayoutCache() { clear(); }
@@ -102,25 +149,36 @@ namespace gpu {
       return vk_layouts.at(id);
     }
 
+    const DescriptorUpdateTemplate &get_update_template(DescriptorLayoutId id) const {
+      return templates.at(id);
+    }
+
     DescriptorSetLayoutCache(const DescriptorSetLayoutCache&) = delete;
     DescriptorSetLayoutCache &operator=(const DescriptorSetLayoutCache&) = delete; 
   private:
     std::unordered_map<DescriptorSetLayoutInfo, DescriptorLayoutId, DescriptorSetLayoutHash> map;
     std::vector<DescriptorSetLayoutInfo> desc_info;
     std::vector<VkDescriptorSetLayout> vk_layouts;
+    //references are handed to pass code, so templates are not moved by new layouts
+    std::deque<DescriptorUpdateTemplate> templates;
   };
 
   struct ShaderModule {
-    ShaderModule(const std::string_view &path);
+    ShaderModule(const std::string_view &path, bool use_cache = true);
     ShaderModule(ShaderModule &&mod);
     ~ShaderModule();
 
-    void reload();
+    //spirv-reflect runs only if .refl sidecar is missing or was made for other code
+    void reload(bool use_cache = true);
+    bool is_reflection_cached() const { return reflection_cached; }
+    //compares file time, then code hash. Touched but identical file is not reported again
+    bool check_modified();
 
-    const SpvReflectShaderModule &get_resources() const { return spv_module; }
+    const ShaderReflection &get_resources() const { return reflection; }
     VkShaderModule get_module() const { return api_module; }
-    VkShaderStageFlagBits get_stage() const { return static_cast<VkShaderStageFlagBits>(spv_module.shader_stage); }
-    std::string_view get_name() const { return spv_module.entry_point_name; }
+    VkShaderStageFlagBits get_stage() const { return reflection.stage; }
+    std::string_view get_name() const { return reflection.entry_point; }
+    const std::string &get_path() const { return path; }
 
     ShaderModule &operator=(ShaderModule &&mod);
 
@@ -129,7 +187,10 @@ namespace gpu {
   private:
     std::string path {};
     VkShaderModule api_module {nullptr};
-    SpvReflectShaderModule spv_module {};
+    ShaderReflection reflection;
+    bool reflection_cached = false;
+    std::filesystem::file_time_type write_time {};
+    uint64_t code_hash = 0;
   };
 
   using ShaderProgramId = uint32_t;
@@ -140,17 +201,36 @@ namespace gpu {
     ShaderProgramManager() {}
     ~ShaderProgramManager() { clear(); }
     
-    ShaderProgramId create_program(const std::string &name, const std::vector<std::string> &shaders); 
+    //push_sets are created as push descriptor layouts if device supports them and the set fits maxPushDescriptors,
+    //otherwise they stay regular sets. At most one set of a program may be pushed
+    ShaderProgramId create_program(const std::string &name, const std::vector<std::string> &shaders, const std::bitset<MAX_DESCRIPTORS> &push_sets = {}); 
     
     ShaderProgramId get_program(const std::string &name) const;
+    const std::string &get_program_name(ShaderProgramId id) const;
+    bool has_program(const std::string &name) const { return prog_names.count(name) != 0; }
 
     void reload();
     void clear();
 
+    //finds modules modified on disk, doesn't touch api objects
+    bool poll_changes();
+    //reloads modules found by poll_changes, returns programs which use them.
+    //Layouts of other programs stay valid
+    std::vector<ShaderProgramId> reload_changed();
+
+    void enable_reflection_cache(bool enable) { use_reflection_cache = enable; }
+    const ReflectionCacheStats &get_reflection_stats() const { return reflection_stats; }
+    //changes when descriptor set layouts are destroyed, their handles may be reused after that
+    uint32_t get_layouts_generation() const { return layouts_generation; }
+
     VkPipelineLayout get_program_layout(ShaderProgramId id) const;
     const std::bitset<MAX_DESCRIPTORS> &get_used_descriptors(ShaderProgramId id) const;
     const DescriptorSetLayoutInfo &get_program_descriptor_info(ShaderProgramId id, uint32_t set) const;
     VkDescriptorSetLayout get_program_descriptor_layout(ShaderProgramId id, uint32_t set) const;
+    const DescriptorUpdateTemplate &get_program_update_template(ShaderProgramId id, uint32_t set) const;
+    bool is_push_descriptor(ShaderProgramId id, uint32_t set) const;
+    //program declares BINDLESS_SET, its pipeline layout uses the global heap layout there
+    bool uses_bindless_heap(ShaderProgramId id) const;
     std::vector<VkPipelineShaderStageCreateInfo> get_stage_info(ShaderProgramId id) const; 
 
     ShaderProgramManager(const ShaderProgramManager&) = delete;
@@ -159,7 +239,13 @@ namespace gpu {
     DescriptorSetLayoutCache cached_descriptors;
 
     std::unordered_map<std::string, uint32_t> module_names;
-    std::vector<ShaderModule> modules;
+    //stage info points to module entry names, so modules are not moved by new loads
+    std::deque<ShaderModule> modules;
+
+    bool use_reflection_cache = true;
+    ReflectionCacheStats reflection_stats;
+    std::vector<uint32_t> changed_modules;
+    uint32_t layouts_generation = 0;
 
     struct ShaderProgInternal;
     std::unordered_map<std::string, ShaderProgramId> prog_names;
@@ -170,14 +256,20 @@ namespace gpu {
     const ShaderModule &get_module(uint32_t id) const { return modules.at(id); }
 
     void reset_program(ShaderProgInternal &prog);
+    void count_reflection(const ShaderModule &mod);
     void destroy_program(ShaderProgInternal &prog);
     void validate_program_shaders(const std::vector<uint32_t> mod_ids);
 
     struct ShaderProgInternal {
+      std::string name;
       std::vector<uint32_t> modules;
       
       std::bitset<MAX_DESCRIPTORS> valid_sets;
       std::array<DescriptorLayoutId, MAX_DESCRIPTORS> sets;
+      //requested on creation and ones which got push descriptor layouts
+      std::bitset<MAX_DESCRIPTORS> push_requested;
+      std::bitset<MAX_DESCRIPTORS> push_sets;
+      bool bindless_heap = false;
       
       VkPushConstantRange constants {0u, 0u, 0u};
       VkPipelineLayout layout {nullptr};
@@ -0,0 +1,76 @@
+#include "worker_pool.hpp"
+
+namespace gpu {
+
+  WorkerPool::WorkerPool(uint32_t threads_count) {
+    threads.reserve(threads_count);
+    for (uint32_t i = 0; i < threads_count; i++) {
+      threads.emplace_back([this](){ worker_loop(); });
+    }
+  }
+
+  WorkerPool::~WorkerPool() {
+    {
+      std::lock_guard lock {jobs_lock};
+      stop = true;
+    }
+    jobs_cv.notify_all();
+
+    for (auto &t : threads) {
+      t.join();
+    }
+  }
+
+  void WorkerPool::submit(std::function<void ()> &&job) {
+    {
+      std::lock_guard lock {jobs_lock};
+      jobs.push_back(std::move(job));
+    }
+    jobs_cv.notify_one();
+  }
+
+  void WorkerPool::wait_idle() {
+    std::unique_lock lock {jobs_lock};
+    idle_cv.wait(lock, [this](){ return jobs.empty() && !running_jobs; });
+
+    if (job_error) {
+      auto error = job_error;
+      job_error = nullptr;
+      std::rethrow_exception(error);
+    }
+  }
+
+  void WorkerPool::worker_loop() {
+    std::unique_lock lock {jobs_lock};
+    
+    while (true) {
+      jobs_cv.wait(lock, [this](){ return stop || !jobs.empty(); });
+      if (jobs.empty()) {
+        return;
+      }
+
+      auto job = std::move(jobs.front());
+      jobs.pop_front();
+      running_jobs++;
+      lock.unlock();
+
+      std::exception_ptr error;
+      try {
+        job();
+      } catch (...) {
+        error = std::current_exception();
+      }
+
+      lock.lock();
+      if (error && !job_error) {
+        job_error = error;
+      }
+      running_jobs--;
+      
+      if (jobs.empty() && !running_jobs) {
+        idle_cv.notify_all();
+      }
+    }
+  }
+
+}
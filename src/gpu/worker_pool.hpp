@@ -0,0 +1,46 @@
+#ifndef GPU_WORKER_POOL_HPP_INCLUDED
+#define GPU_WORKER_POOL_HPP_INCLUDED
+
+#include <cinttypes>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+
+namespace gpu {
+
+  //fixed set of threads, jobs are started in submission order
+  struct WorkerPool {
+    WorkerPool(uint32_t threads_count);
+    ~WorkerPool();
+
+    void submit(std::function<void ()> &&job);
+    //blocks until every submitted job is finished, rethrows first job exception
+    void wait_idle();
+
+    uint32_t get_threads_count() const { return threads.size(); }
+
+  private:
+    std::vector<std::thread> threads;
+    std::deque<std::function<void ()>> jobs;
+
+    std::mutex jobs_lock;
+    std::condition_variable jobs_cv;
+    std::condition_variable idle_cv;
+
+    uint32_t running_jobs = 0;
+    bool stop = false;
+    std::exception_ptr job_error;
+
+    void worker_loop();
+
+    WorkerPool(const WorkerPool &) = delete;
+    const WorkerPool &operator=(const WorkerPool &) = delete;
+  };
+
+}
+
+#endif
@@ -87,6 +87,7 @@ namespace gpu_transfer {
       },
       [=](Data &input, rendergraph::RenderResources &resources, gpu::CmdContext &cmd){
         
+        cmd.flush_renderpass();
         auto api_cmd = cmd.get_command_buffer();
         auto src_buffer = g_transfer_state->transfer_buffers[input.buffer_id]->api_buffer(); 
         
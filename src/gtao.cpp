@@ -29,14 +29,16 @@ GTAO::GTAO(rendergraph::RenderGraph &graph, uint32_t width, uint32_t height, boo
 
   raw = graph.create_image(VK_IMAGE_TYPE_2D, info_raw, VK_IMAGE_TILING_OPTIMAL, usage|VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT);
   filtered = graph.create_image(VK_IMAGE_TYPE_2D, info, VK_IMAGE_TILING_OPTIMAL, usage);
-  prev_frame = graph.create_image(VK_IMAGE_TYPE_2D, info, VK_IMAGE_TILING_OPTIMAL, usage);
-  output = graph.create_image(VK_IMAGE_TYPE_2D, info, VK_IMAGE_TILING_OPTIMAL, usage);
+  output_history = graph.create_history_image(VK_IMAGE_TYPE_2D, info, VK_IMAGE_TILING_OPTIMAL, usage);
+  output = graph.get_current(output_history);
+  prev_frame = graph.get_previous(output_history);
 
   random_vectors = create_random_vectors(64);
   
   info.format = VK_FORMAT_R16G16_SFLOAT;
-  accumulated_ao = graph.create_image(VK_IMAGE_TYPE_2D, info, VK_IMAGE_TILING_OPTIMAL, usage);
-  accumulated_history = graph.create_image(VK_IMAGE_TYPE_2D, info, VK_IMAGE_TILING_OPTIMAL, usage);
+  accumulation = graph.create_history_image(VK_IMAGE_TYPE_2D, info, VK_IMAGE_TILING_OPTIMAL, usage);
+  accumulated_ao = graph.get_current(accumulation);
+  accumulated_history = graph.get_previous(accumulation);
 
   uint32_t pattern_step = 1u << (uint32_t)pattern_n;
 
@@ -79,6 +81,7 @@ GTAO::GTAO(rendergraph::RenderGraph &graph, uint32_t width, uint32_t height, boo
   main_deinterleaved_pipeline.set_program("main_deinterleaved");
 
   sampler = gpu::create_sampler(gpu::DEFAULT_SAMPLER);
+  sampler_index = gpu::get_sampler_index(sampler);
 }
 
 void GTAO::add_main_pass(
@@ -104,6 +107,11 @@ void GTAO::add_main_pass(
     uint32_t use_mis;
     uint32_t two_directions;
     uint32_t reflections_only;
+    uint32_t depth_index;
+    uint32_t normal_index;
+    uint32_t material_index;
+    uint32_t out_index;
+    uint32_t sampler_index;
   };
 
   const float angle_offsets[] {60.f, 300.f, 180.f, 240.f, 120.f, 0.f, 300.f, 60.f, 180.f, 120.f, 240.f, 0.f};
@@ -111,6 +119,7 @@ void GTAO::add_main_pass(
   base_angle += rand()/float(RAND_MAX) - 0.5;
 
   PushConsts push_consts {base_angle, weight_ratio, mis_gtao, two_directions? 255u : 0u, only_reflections? 255u : 0u};
+  push_consts.sampler_index = sampler_index;
 
   frame_count += 1;
   
@@ -126,22 +135,19 @@ void GTAO::add_main_pass(
       auto block = cmd.allocate_ubo<GTAOParams>();
       *block.ptr = params;
 
-      auto set = resources.allocate_set(main_pipeline, 0);
-    
-      gpu::write_set(set,
-        gpu::TextureBinding {0, resources.get_view(input.depth), sampler},
-        gpu::UBOBinding {1, cmd.get_ubo_pool(), block},
-        gpu::TextureBinding {2, resources.get_view(input.norm), sampler},
-        gpu::TextureBinding {3, resources.get_view(input.material), sampler},
-        gpu::TextureBinding {4, resources.get_view(input.pdf), sampler},
-        gpu::StorageTextureBinding {5, resources.get_view(input.out)}
-      );
-
       const auto &extent = resources.get_image(input.out)->get_extent();
 
+      auto pc = push_consts;
+      pc.depth_index = resources.get_sampled_index(input.depth);
+      pc.normal_index = resources.get_sampled_index(input.norm);
+      pc.material_index = resources.get_sampled_index(input.material);
+      pc.out_index = resources.get_storage_index(input.out);
+
       cmd.bind_pipeline(main_pipeline);
-      cmd.bind_descriptors_compute(0, {set}, {block.offset});
-      cmd.push_constants_compute(0, sizeof(push_consts), &push_consts);
+      resources.bind_set(cmd, main_pipeline, 0, {block.offset},
+        gpu::UBOBinding {0, cmd.get_ubo_pool(), block},
+        gpu::TextureBinding {1, resources.get_view(input.pdf), sampler});
+      cmd.push_constants_compute(0, sizeof(pc), &pc);
       cmd.dispatch(extent.width/8, extent.height/4, 1);
     });
 
@@ -174,7 +180,7 @@ void GTAO::add_main_rt_pass(
 
       auto set = resources.allocate_set(rt_main_pipeline, 0);
     
-      gpu::write_set(set,
+      gpu::write_set(set, rt_main_pipeline.get_update_template(0),
         gpu::UBOBinding {0, cmd.get_ubo_pool(), block},
         gpu::TextureBinding {1, resources.get_view(input.depth), sampler},
         gpu::TextureBinding {2, resources.get_view(input.norm), sampler},
@@ -210,30 +216,30 @@ void GTAO::add_filter_pass(
   struct FilterData {
     float znear;
     float zfar;
+    uint32_t depth_index;
+    uint32_t raw_gtao_index;
+    uint32_t filtered_index;
   };
 
   FilterData filter_params {params.znear, params.zfar};
 
   graph.add_task<PassData>("GTAO_filter",
     [&](PassData &input, rendergraph::RenderGraphBuilder &builder){
+      builder.use_async_compute();
       input.depth = builder.sample_image(depth, VK_SHADER_STAGE_COMPUTE_BIT, VK_IMAGE_ASPECT_DEPTH_BIT, depth_lod, 1, 0, 1);
       input.raw_gtao = builder.sample_image(raw, VK_SHADER_STAGE_COMPUTE_BIT);
       input.out = builder.use_storage_image(filtered, VK_SHADER_STAGE_COMPUTE_BIT, 0, 0);
     },
     [=](PassData &input, rendergraph::RenderResources &resources, gpu::CmdContext &cmd){
-      auto set = resources.allocate_set(filter_pipeline, 0);
-    
-      gpu::write_set(set,
-        gpu::TextureBinding {0, resources.get_view(input.depth), sampler},
-        gpu::TextureBinding {1, resources.get_view(input.raw_gtao), sampler},
-        gpu::StorageTextureBinding {2, resources.get_view(input.out)}
-      );
-
       const auto &extent = resources.get_image(input.out)->get_extent();
 
+      auto pc = filter_params;
+      pc.depth_index = resources.get_sampled_index(input.depth);
+      pc.raw_gtao_index = resources.get_sampled_index(input.raw_gtao);
+      pc.filtered_index = resources.get_storage_index(input.out);
+
       cmd.bind_pipeline(filter_pipeline);
-      cmd.bind_descriptors_compute(0, {set}, {});
-      cmd.push_constants_compute(0, sizeof(filter_params), &filter_params);
+      cmd.push_constants_compute(0, sizeof(pc), &pc);
       cmd.dispatch(extent.width/8, extent.height/4, 1);
     });
 }
@@ -254,6 +260,7 @@ void GTAO::add_reprojection_pass(
 
   graph.add_task<PassData>("GTAO_reproject",
     [&](PassData &input, rendergraph::RenderGraphBuilder &builder){
+      builder.use_async_compute();
       input.depth = builder.sample_image(depth, VK_SHADER_STAGE_COMPUTE_BIT, VK_IMAGE_ASPECT_DEPTH_BIT, depth_lod, 1, 0, 1);
       input.prev_depth = builder.sample_image(prev_depth, VK_SHADER_STAGE_COMPUTE_BIT, VK_IMAGE_ASPECT_DEPTH_BIT, depth_lod, 1, 0, 1);
       input.gtao = builder.sample_image(filtered, VK_SHADER_STAGE_COMPUTE_BIT);
@@ -264,21 +271,30 @@ void GTAO::add_reprojection_pass(
       auto block = cmd.allocate_ubo<GTAOReprojection>();
       *block.ptr = params;
 
-      auto set = resources.allocate_set(reproject_pipeline, 0);
-    
-      gpu::write_set(set,
-        gpu::UBOBinding {0, cmd.get_ubo_pool(), block},
-        gpu::TextureBinding {1, resources.get_view(input.depth), sampler},
-        gpu::TextureBinding {2, resources.get_view(input.prev_depth), sampler},
-        gpu::TextureBinding {3, resources.get_view(input.gtao), sampler},
-        gpu::TextureBinding {4, resources.get_view(input.prev_gtao), sampler},
-        gpu::StorageTextureBinding {5, resources.get_view(input.out)}
-      );
-
       const auto &extent = resources.get_image(input.out)->get_extent();
 
+      struct PushConstants {
+        uint32_t depth_index;
+        uint32_t prev_depth_index;
+        uint32_t gtao_index;
+        uint32_t prev_gtao_index;
+        uint32_t out_index;
+        uint32_t sampler_index;
+      };
+
+      PushConstants pc {
+        resources.get_sampled_index(input.depth),
+        resources.get_sampled_index(input.prev_depth),
+        resources.get_sampled_index(input.gtao),
+        resources.get_sampled_index(input.prev_gtao),
+        resources.get_storage_index(input.out),
+        sampler_index
+      };
+
       cmd.bind_pipeline(reproject_pipeline);
-      cmd.bind_descriptors_compute(0, {set}, {block.offset});
+      resources.bind_set(cmd, reproject_pipeline, 0, {block.offset},
+        gpu::UBOBinding {0, cmd.get_ubo_pool(), block});
+      cmd.push_constants_compute(0, sizeof(pc), &pc);
       cmd.dispatch(extent.width/8, extent.height/4, 1);
     });
 }
@@ -306,14 +322,26 @@ void GTAO::add_accumulate_pass(
 
   struct PushConstants {
     uint32_t clear_history;
+    uint32_t depth_index;
+    uint32_t prev_depth_index;
+    uint32_t gtao_index;
+    uint32_t accumulated_index;
+    uint32_t velocity_index;
+    uint32_t history_index;
+    uint32_t sampler_index;
   };
 
   AccumConstants constants {glm::inverse(params.camera), glm::inverse(params.prev_camera), params.mvp, params.fovy_aspect_znear_zfar};
-  PushConstants pc {clear_history? 1u : 0u};
-  clear_history = false;
+  if (clear_history) {
+    graph.invalidate_history(accumulation);
+    clear_history = false;
+  }
+  PushConstants push_consts {graph.has_history(accumulation)? 0u : 1u};
+  push_consts.sampler_index = sampler_index;
 
   graph.add_task<PassData>("GTAO_accumulate",
     [&](PassData &input, rendergraph::RenderGraphBuilder &builder){
+      builder.use_async_compute();
       input.depth = builder.sample_image(gbuffer.depth, VK_SHADER_STAGE_COMPUTE_BIT, VK_IMAGE_ASPECT_DEPTH_BIT, depth_lod, 1, 0, 1);
       input.prev_depth = builder.sample_image(gbuffer.prev_depth, VK_SHADER_STAGE_COMPUTE_BIT, VK_IMAGE_ASPECT_DEPTH_BIT, depth_lod, 1, 0, 1);
       input.gtao = builder.sample_image(filtered, VK_SHADER_STAGE_COMPUTE_BIT);
@@ -323,24 +351,22 @@ void GTAO::add_accumulate_pass(
     },
     [=](PassData &input, rendergraph::RenderResources &resources, gpu::CmdContext &cmd){
 
-      auto set = resources.allocate_set(accumulate_pipeline, 0);
       auto blk = cmd.allocate_ubo<AccumConstants>();
       *blk.ptr = constants;
 
-      gpu::write_set(set,
-        gpu::TextureBinding {0, resources.get_view(input.depth), sampler},
-        gpu::TextureBinding {1, resources.get_view(input.prev_depth), sampler},
-        gpu::TextureBinding {2, resources.get_view(input.gtao), sampler},
-        gpu::StorageTextureBinding {3, resources.get_view(input.accumulated_ao)},
-        gpu::TextureBinding {4, resources.get_view(input.velocity), sampler},
-        gpu::TextureBinding {5, resources.get_view(input.history), sampler},
-        gpu::UBOBinding {6, cmd.get_ubo_pool(), blk}
-      );
-
       const auto &extent = resources.get_image(input.accumulated_ao)->get_extent();
 
+      auto pc = push_consts;
+      pc.depth_index = resources.get_sampled_index(input.depth);
+      pc.prev_depth_index = resources.get_sampled_index(input.prev_depth);
+      pc.gtao_index = resources.get_sampled_index(input.gtao);
+      pc.accumulated_index = resources.get_storage_index(input.accumulated_ao);
+      pc.velocity_index = resources.get_sampled_index(input.velocity);
+      pc.history_index = resources.get_sampled_index(input.history);
+
       cmd.bind_pipeline(accumulate_pipeline);
-      cmd.bind_descriptors_compute(0, {set}, {blk.offset});
+      resources.bind_set(cmd, accumulate_pipeline, 0, {blk.offset},
+        gpu::UBOBinding {0, cmd.get_ubo_pool(), blk});
       cmd.push_constants_compute(0, sizeof(pc), &pc);
       cmd.dispatch((extent.width + 7)/8, (extent.height + 3)/4, 1);
     });
@@ -388,7 +414,7 @@ void GTAO::add_main_pass_graphics(
 
       auto set = resources.allocate_set(main_pipeline_gfx, 0);
     
-      gpu::write_set(set,
+      gpu::write_set(set, main_pipeline_gfx.get_update_template(0),
         gpu::TextureBinding {0, resources.get_view(input.depth), sampler},
         gpu::UBOBinding {1, cmd.get_ubo_pool(), block},
         gpu::TextureBinding {2, resources.get_view(input.norm), sampler});
@@ -454,19 +480,22 @@ void GTAO::deinterleave_depth(rendergraph::RenderGraph &graph, rendergraph::Imag
       input.out = builder.use_storage_image_array(deinterleaved_depth, VK_SHADER_STAGE_COMPUTE_BIT);
     },
     [=](PassData &input, rendergraph::RenderResources &resources, gpu::CmdContext &cmd){
-
-      auto set = resources.allocate_set(deinterleave_pipeline, 0);
-    
-      gpu::write_set(set,
-        gpu::TextureBinding {0, resources.get_view(input.depth), sampler},
-        gpu::StorageTextureBinding {1, resources.get_view(input.out)}
-      );
+      struct PushConstants {
+        int32_t pattern_step;
+        uint32_t depth_index;
+        uint32_t out_index;
+      };
+
+      PushConstants pc {
+        deinterleave_n,
+        resources.get_sampled_index(input.depth),
+        resources.get_storage_index(input.out)
+      };
 
       const auto &extent = resources.get_image(input.out)->get_extent();
 
       cmd.bind_pipeline(deinterleave_pipeline);
-      cmd.bind_descriptors_compute(0, {set}, {});
-      cmd.push_constants_compute(0, sizeof(deinterleave_n), &deinterleave_n);
+      cmd.push_constants_compute(0, sizeof(pc), &pc);
       cmd.dispatch(extent.width/8, extent.height/4, 1);
     });
 }
@@ -480,6 +509,10 @@ void GTAO::add_main_pass_deinterleaved(
     int pattern_n;
     uint32_t layer;
     float angle_offset;
+    uint32_t depth_index;
+    uint32_t normal_index;
+    uint32_t out_index;
+    uint32_t sampler_index;
   };
 
   struct PassData {
@@ -504,21 +537,17 @@ void GTAO::add_main_pass_deinterleaved(
       auto block = cmd.allocate_ubo<GTAOParams>();
       *block.ptr = params;
 
-      auto set = resources.allocate_set(main_deinterleaved_pipeline, 0);
-    
-      gpu::write_set(set,
-        gpu::TextureBinding {0, resources.get_view(input.depth), sampler},
-        gpu::UBOBinding {1, cmd.get_ubo_pool(), block},
-        gpu::TextureBinding {2, resources.get_view(input.norm), sampler},
-        gpu::StorageTextureBinding {3, resources.get_view(input.out)}
-      );
+      auto depth_index = resources.get_sampled_index(input.depth);
+      auto normal_index = resources.get_sampled_index(input.norm);
+      auto out_index = resources.get_storage_index(input.out);
       const auto &info = resources.get_image(input.out);
       const auto &extent = info->get_extent();
 
       cmd.bind_pipeline(main_deinterleaved_pipeline);
-      cmd.bind_descriptors_compute(0, {set}, {block.offset});
+      resources.bind_set(cmd, main_deinterleaved_pipeline, 0, {block.offset},
+        gpu::UBOBinding {0, cmd.get_ubo_pool(), block});
       for (uint32_t i = 0; i < info->get_array_layers(); i++) {
-        PushConstants pc {deinterleave_n, i, base_angle};
+        PushConstants pc {deinterleave_n, i, base_angle, depth_index, normal_index, out_index, sampler_index};
         cmd.push_constants_compute(0, sizeof(pc), &pc);
         cmd.dispatch(extent.width/8, extent.height/4, 1);
       }
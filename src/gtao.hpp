@@ -81,10 +81,6 @@ struct GTAO {
 
   void draw_ui();
 
-  void remap(rendergraph::RenderGraph &graph) {
-    graph.remap(accumulated_history, accumulated_ao);
-  }
-
   rendergraph::ImageResourceId raw; //output of main pass
   rendergraph::ImageResourceId filtered; //output of filter pass
   rendergraph::ImageResourceId prev_frame; //previous frame
@@ -92,6 +88,8 @@ struct GTAO {
   rendergraph::ImageResourceId accumulated_ao;
   rendergraph::ImageResourceId accumulated_history;
   rendergraph::ImageResourceId deinterleaved_depth;
+  rendergraph::HistoryImageId output_history;
+  rendergraph::HistoryImageId accumulation;
 
 private:
 
@@ -118,6 +116,8 @@ private:
   uint32_t frame_count = 0;
 
   VkSampler sampler;
+  //bindless heap index of sampler
+  uint32_t sampler_index;
 };
 
 #endif
\ No newline at end of file
@@ -91,6 +91,7 @@ ReadBackID ReadBackSystem::read_image(rendergraph::RenderGraph &graph, rendergra
       builder.transfer_read(image, mip, 1, layer, 1);
     },
     [=](TaskData &, rendergraph::RenderResources &resources, gpu::CmdContext &ctx) {
+      ctx.flush_renderpass();
       auto api_cmd = ctx.get_command_buffer();
       auto api_image = resources.get_image(image)->api_image();
       
@@ -8,6 +8,8 @@
 #include <filesystem>
 #include <lib/json.hpp>
 #include <ctime>
+#include <chrono>
+#include <algorithm>
 
 using json = nlohmann::json; 
 namespace fs = std::filesystem;
@@ -73,6 +75,9 @@ struct AppInit {
     device_info.use_ray_query = true;
 #endif
     device_info.extensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+    device_info.pipeline_cache_path = "pipeline_cache.bin";
+    device_info.pipeline_compile_threads = 2;
+    device_info.pipeline_manifest_path = "pipeline_manifest.bin";
 
     gpu::init_all(instance_info, debug_cb, device_info, {width, height}, [&](VkInstance instance){
       VkSurfaceKHR surface;
@@ -187,16 +192,25 @@ static void load_shaders(const fs::path &config_path) {
     {"compute", VK_SHADER_STAGE_COMPUTE_BIT}
   };
 
+  auto start = std::chrono::steady_clock::now();
   for (const auto &elem : config.items()) {
     const auto prog_name = elem.key();
     const auto &prog = elem.value();
 
     std::vector<std::string> shader_names;
     shader_names.reserve(prog.size());
+    std::bitset<gpu::MAX_DESCRIPTORS> push_sets;
 
     for (const auto &shader : prog.items()) {
       const auto &key = shader.key();
       const auto &val = shader.value();
+      if (key == "push_descriptor_sets") {
+        for (const auto &set : val) {
+          push_sets.set(set.get<uint32_t>());
+        }
+        continue;
+      }
+
       auto stage = stages_map.find(key); 
       if (stage == stages_map.end()) {
         throw std::runtime_error {"Incorrect stage"};
@@ -210,8 +224,27 @@ static void load_shaders(const fs::path &config_path) {
       shader_names.push_back(file_path.string());
     }
     std::cout << "Loading " << prog_name << " program\n";
-    gpu::create_program(prog_name, std::move(shader_names));
+    gpu::create_program(prog_name, std::move(shader_names), push_sets);
+  }
+
+  const auto &stats = gpu::app_pipelines().get_reflection_stats();
+  auto ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  std::cout << "Shaders loaded in " << ms << " ms, reflection cache hits " << stats.hits << ", misses " << stats.misses << "\n";
+}
+
+static void print_descriptor_usage(const char *name, const gpu::DescriptorPoolStats &stats) {
+  std::cout << name << ": high-water " << stats.high_water.sets << " sets (";
+  for (uint32_t i = 0; i < gpu::POOL_DESCRIPTOR_TYPES_COUNT; i++) {
+    std::cout << (i? ", " : "") << stats.high_water.descriptors[i];
   }
+  std::cout << " descriptors), " << stats.blocks << " blocks, " << stats.overflows << " overflows\n";
+}
+
+static void print_bindless_usage(const gpu::BindlessStats &stats) {
+  std::cout << "Bindless heap: " << stats.used[uint32_t(gpu::BindlessType::SampledImage)] << " sampled images, "
+    << stats.used[uint32_t(gpu::BindlessType::Sampler)] << " samplers, "
+    << stats.used[uint32_t(gpu::BindlessType::StorageImage)] << " storage images, "
+    << stats.writes << " writes\n";
 }
 
 const uint32_t WIDTH = 2560;
@@ -237,12 +270,18 @@ int main(int argc, char **argv) {
   }
   
   AppInit app_init {WIDTH, HEIGHT, enable_validation};
+  //for load time comparison
+  if (std::find(params.begin(), params.end(), "--no-reflection-cache") != params.end()) {
+    gpu::app_pipelines().enable_reflection_cache(false);
+  }
   load_shaders("src/shaders/config.json");
+  gpu::warm_up_pipelines();
 
   auto sampler = gpu::create_sampler(gpu::DEFAULT_SAMPLER);
   bool use_jitter = true;
   
   rendergraph::RenderGraph render_graph {gpu::app_device(), gpu::app_swapchain()};
+  render_graph.enable_profiler(true);
   gpu_transfer::init(render_graph);
   ReadBackSystem readback_system;
 
@@ -308,6 +347,9 @@ int main(int argc, char **argv) {
   glm::mat4 prev_mvp = projection * camera.get_view_mat();
   ReadBackID image_read_back = INVALID_READBACK;
   bool reload_request = false;
+  //modified shaders are picked up without R, which reloads everything
+  const uint32_t SHADERS_CHECK_PERIOD_MS = 500;
+  auto shaders_check_ticks = ticks;
   while (!quit) {
     imgui_new_frame();
     SDL_Event event;
@@ -364,6 +406,12 @@ int main(int argc, char **argv) {
     ssr.render_ui();
     gtao.draw_ui();
     shading_pass.draw_ui();
+    render_graph.draw_profiler_ui();
+    ImGui::Begin("GPU profiler");
+    if (ImGui::Button("Export graph")) {
+      render_graph.export_next_frame("rendergraph.json", "rendergraph.dot");
+    }
+    ImGui::End();
 
     auto normal_mat = glm::transpose(glm::inverse(camera.get_view_mat()));
     auto camera_to_world = glm::inverse(camera.get_view_mat());
@@ -413,22 +461,28 @@ int main(int argc, char **argv) {
       image_read_back = INVALID_READBACK;
     }
 
-    render_graph.remap(gbuffer.depth, gbuffer.prev_depth);
-    render_graph.remap(gtao.output, gtao.prev_frame);
-    taa_pass.remap_targets(render_graph);
-    ssr.remap_images(render_graph);
-    gtao.remap(render_graph);
     prev_mvp = projection * camera.get_view_mat();
 
+    //pipelines, images and bindless slots below may still be used by the render thread
+    render_graph.wait_recording();
     if (reload_request) {
       gpu::reload_shaders();
       reload_request = false;
+    } else if (ticks_now - shaders_check_ticks >= SHADERS_CHECK_PERIOD_MS) {
+      gpu::reload_changed_shaders();
+      shaders_check_ticks = ticks_now;
     }
 
     gpu::collect_resources();
   }
   
-  vkDeviceWaitIdle(gpu::app_device().api_device());
+  {
+    std::scoped_lock lock {gpu::app_queue_lock()};
+    vkDeviceWaitIdle(gpu::app_device().api_device());
+  }
+  print_descriptor_usage("Frame descriptor pools", render_graph.get_desc_pool_stats());
+  print_descriptor_usage("Static descriptor pool", gpu::get_static_descriptor_stats());
+  print_bindless_usage(gpu::get_bindless_stats());
   gpu_transfer::close();
   imgui_close();
   return 0;
@@ -139,7 +139,7 @@ void ProbeRenderer::render_side(rendergraph::RenderGraph &graph, SceneRenderer &
       
       auto set = resources.allocate_set(cubemap_pass.get_layout(0));
       
-      gpu::write_set(set, 
+      gpu::write_set(set, cubemap_pass.get_update_template(0), 
         gpu::UBOBinding {0, cmd.get_ubo_pool(), blk},
         gpu::SSBOBinding {1, resources.get_buffer(scene_renderer.get_scene_transforms())},
         gpu::ArrayOfImagesBinding {2, scene_renderer.get_images()},
@@ -188,7 +188,7 @@ void ProbeRenderer::render_octahedral(rendergraph::RenderGraph &graph, rendergra
 
       auto set = resources.allocate_set(octprobe_pass, 0);
       
-      gpu::write_set(set,
+      gpu::write_set(set, octprobe_pass.get_update_template(0),
         gpu::TextureBinding {0, resources.get_view(input.cube_color), sampler},
         gpu::TextureBinding {1, resources.get_view(input.cube_distance), sampler},
         gpu::StorageTextureBinding {2, resources.get_view(input.oct_color)},
@@ -218,7 +218,7 @@ void ProbeRenderer::probe_downsample(rendergraph::RenderGraph &graph, rendergrap
       },
       [=](Input &input, rendergraph::RenderResources &resources, gpu::CmdContext &cmd){
         auto set = resources.allocate_set(downsample_pass, 0); 
-        gpu::write_set(set, 
+        gpu::write_set(set, downsample_pass.get_update_template(0), 
           gpu::TextureBinding {0, resources.get_view(input.depth_tex), sampler});
 
         uint32_t w = desc.width/(1 << i), h = desc.height/(1 << i);
@@ -366,7 +366,7 @@ void ProbeTracePass::run(
 
       auto set = resources.allocate_set(trace_pass, 0);
       
-      gpu::write_set(set,
+      gpu::write_set(set, trace_pass.get_update_template(0),
         gpu::TextureBinding {0, resources.get_view(input.depth), sampler},
         gpu::TextureBinding {1, resources.get_view(input.normal), sampler},
         gpu::TextureBinding {2, resources.get_view(input.probe_color), sampler},
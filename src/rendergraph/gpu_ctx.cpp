@@ -11,75 +11,168 @@ namespace rendergraph {
       nullptr, &backbuf_index));
   }
 
-  void GpuState::begin() {
+  void GpuState::skip_frame(bool present) {
+    if (!headless) {
+      throw std::runtime_error {"Only headless frames can be skipped"};
+    }
+
+    frame_index = (frame_index + 1) % frames_count;
+    if (present) {
+      backbuf_index = (backbuf_index + 1) % backbuffers_count;
+    }
+  }
 
-    auto &cmd = ctx_pool.get_ctx(); 
+  void GpuState::begin(uint32_t recorders_count) {
     VkFence cmd_fence = submit_fences[frame_index];
 
     vkWaitForFences(gpu::app_device().api_device(), 1, &cmd_fence, VK_TRUE, UINT64_MAX);
     submit_fences[frame_index].reset();
-    vkResetCommandBuffer(cmd.get_command_buffer(), VK_COMMAND_BUFFER_RESET_RELEASE_RESOURCES_BIT);
-    desc_pool.flip();
     event_pool.flip();
 
-    cmd.begin();
-    cmd.clear_resources();
+    while (recorders.size() < recorders_count) {
+      recorders.emplace_back(new Recorder {frames_count});
+    }
+    active_recorders = recorders_count;
+
+    for (uint32_t i = 0; i < active_recorders; i++) {
+      auto &rec = recorders[i];
+      auto &cmd = rec->ctx_pool.get_ctx(); 
+      vkResetCommandBuffer(cmd.get_command_buffer(), VK_COMMAND_BUFFER_RESET_RELEASE_RESOURCES_BIT);
+      rec->desc_pool.flip();
+      rec->desc_cache.flip();
+
+      cmd.begin();
+      cmd.clear_resources();
+    }
   }
-  
-  void GpuState::submit(bool present) {
-    if (!present) {
-      auto &cmd = ctx_pool.get_ctx();
-      auto api_cmd = cmd.get_command_buffer();
-      VkFence cmd_fence = submit_fences[frame_index];
-      auto queue = gpu::app_device().api_queue();
 
+  void GpuState::end_recording() {
+    submit_buffers.clear();
+    for (uint32_t i = 0; i < active_recorders; i++) {
+      auto &cmd = recorders[i]->ctx_pool.get_ctx();
       cmd.end();
+      submit_buffers.push_back(cmd.get_command_buffer());
+    }
+  }
 
-      VkSubmitInfo submit_info {
-        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-        .pNext = nullptr,
-        .waitSemaphoreCount = 0,
-        .pWaitSemaphores = nullptr,
-        .pWaitDstStageMask = nullptr,
-        .commandBufferCount = 1,
-        .pCommandBuffers = &api_cmd,
-        .signalSemaphoreCount = 0,
-        .pSignalSemaphores = nullptr
-      };
+  gpu::DescriptorCacheStats GpuState::get_desc_cache_stats() const {
+    gpu::DescriptorCacheStats total {};
+    for (const auto &rec : recorders) {
+      const auto &stats = rec->desc_cache.get_stats();
+      total.hits += stats.hits;
+      total.misses += stats.misses;
+      total.entries += stats.entries;
+    }
+    return total;
+  }
 
-      VKCHECK(vkQueueSubmit(queue, 1, &submit_info, cmd_fence));
-      frame_index = (frame_index + 1) % frames_count;
-      ctx_pool.flip();
-      return;
+  gpu::DescriptorPoolStats GpuState::get_desc_pool_stats() const {
+    gpu::DescriptorPoolStats total {};
+    for (const auto &rec : recorders) {
+      const auto &stats = rec->desc_pool.get_stats();
+      total.current.add(stats.current);
+      total.high_water.add(stats.high_water);
+      total.blocks += stats.blocks;
+      total.overflows += stats.overflows;
+    }
+    return total;
+  }
+
+  void GpuState::flip_recorders() {
+    for (uint32_t i = 0; i < active_recorders; i++) {
+      recorders[i]->ctx_pool.flip();
     }
+  }
+  
+  void GpuState::submit(bool present) {
+    submit(present, {SubmitBatch {QueueType::Main, 0, active_recorders, {}}});
+  }
 
+  void GpuState::submit(bool present, const std::vector<SubmitBatch> &batches) {
+    if (batches.empty() || batches.back().queue != QueueType::Main) {
+      throw std::runtime_error {"Frame must end with main queue batch"};
+    }
 
-    auto &cmd = ctx_pool.get_ctx();
-    auto api_cmd = cmd.get_command_buffer();
+    auto &device = gpu::app_device();
+    auto api_swapchain = gpu::app_swapchain().api_swapchain();
     VkFence cmd_fence = submit_fences[frame_index];
     
-    auto api_swapchain = gpu::app_swapchain().api_swapchain();
-    auto queue = gpu::app_device().api_queue();
+    end_recording();
 
-    cmd.end();
+    //binary semaphores, each one is signaled and waited once per frame
+    auto &semaphores = batch_semaphores[frame_index];
+    std::vector<VkSemaphore> batch_signals(batches.size(), nullptr);
+    uint32_t used_semaphores = 0;
+    
+    for (const auto &batch : batches) {
+      if (!batch.wait_batch.has_value()) {
+        continue;
+      }
+      
+      auto &signal = batch_signals.at(batch.wait_batch.value());
+      if (signal) {
+        throw std::runtime_error {"Batch is waited more than once"};
+      }
+      if (used_semaphores == semaphores.size()) {
+        semaphores.emplace_back();
+      }
+      signal = semaphores[used_semaphores++];
+    }
 
-    VkSemaphore wait_sem = image_acquire_semaphores[backbuf_sem_index];
-    VkSemaphore signal_sem = submit_done_semaphores[backbuf_sem_index];
-    VkPipelineStageFlags wait_mask = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    VkSemaphore acquire_sem = image_acquire_semaphores[backbuf_sem_index];
+    VkSemaphore present_sem = submit_done_semaphores[backbuf_sem_index];
+    bool acquire_pending = present;
+
+    //queues are shared with transfers and device waits of the main thread
+    std::unique_lock queue_lock {gpu::app_queue_lock()};
+    for (uint32_t i = 0; i < batches.size(); i++) {
+      const auto &batch = batches[i];
+      bool last = (i + 1 == batches.size());
+      bool main_queue = batch.queue == QueueType::Main || !device.has_async_compute();
+
+      VkSemaphore wait_sems[2];
+      VkPipelineStageFlags wait_stages[2] {VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT};
+      uint32_t wait_count = 0;
+      VkSemaphore signal_sems[2];
+      uint32_t signal_count = 0;
+
+      if (batch.wait_batch.has_value()) {
+        wait_sems[wait_count++] = batch_signals[batch.wait_batch.value()];
+      }
+      //backbuffer is transitioned by the first main queue batch
+      if (acquire_pending && batch.queue == QueueType::Main) {
+        wait_sems[wait_count++] = acquire_sem;
+        acquire_pending = false;
+      }
+      if (batch_signals[i]) {
+        signal_sems[signal_count++] = batch_signals[i];
+      }
+      if (present && last) {
+        signal_sems[signal_count++] = present_sem;
+      }
 
-    VkSubmitInfo submit_info {
-      .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-      .pNext = nullptr,
-      .waitSemaphoreCount = 1,
-      .pWaitSemaphores = &wait_sem,
-      .pWaitDstStageMask = &wait_mask,
-      .commandBufferCount = 1,
-      .pCommandBuffers = &api_cmd,
-      .signalSemaphoreCount = 1,
-      .pSignalSemaphores = &signal_sem
-    };
+      VkSubmitInfo submit_info {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .pNext = nullptr,
+        .waitSemaphoreCount = wait_count,
+        .pWaitSemaphores = wait_sems,
+        .pWaitDstStageMask = wait_stages,
+        .commandBufferCount = batch.recorders_count,
+        .pCommandBuffers = submit_buffers.data() + batch.first_recorder,
+        .signalSemaphoreCount = signal_count,
+        .pSignalSemaphores = signal_sems
+      };
+
+      auto queue = main_queue? device.api_queue() : device.api_compute_queue();
+      VKCHECK(vkQueueSubmit(queue, 1, &submit_info, last? cmd_fence : VK_NULL_HANDLE));
+    }
 
-    VKCHECK(vkQueueSubmit(queue, 1, &submit_info, cmd_fence));
+    frame_index = (frame_index + 1) % frames_count;
+    flip_recorders();
+
+    if (!present) {
+      return;
+    }
 
     VkResult present_result;
 
@@ -87,20 +180,19 @@ namespace rendergraph {
       .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
       .pNext = nullptr,
       .waitSemaphoreCount = 1,
-      .pWaitSemaphores = &signal_sem,
+      .pWaitSemaphores = &present_sem,
       .swapchainCount = 1,
       .pSwapchains = &api_swapchain,
       .pImageIndices = &backbuf_index,
       .pResults = &present_result
     };
 
-    VKCHECK(vkQueuePresentKHR(queue, &present_info));
+    VKCHECK(vkQueuePresentKHR(device.api_queue(), &present_info));
+    queue_lock.unlock();
     VKCHECK(present_result);
 
-    frame_index = (frame_index + 1) % frames_count;
     backbuf_sem_index = (backbuf_sem_index + 1) % backbuffers_count;
-    ctx_pool.flip();
     acquire_image();
   }
 
-}
\ No newline at end of file
+}
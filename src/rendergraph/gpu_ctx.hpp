@@ -3,21 +3,44 @@
 
 #include "gpu/driver.hpp"
 
+#include <memory>
+#include <optional>
+
 #include "resources.hpp"
 
 namespace rendergraph {
 
+  enum class QueueType {
+    Main,
+    AsyncCompute
+  };
+
+  //command buffers of consecutive recorders sent by one vkQueueSubmit
+  struct SubmitBatch {
+    QueueType queue = QueueType::Main;
+    uint32_t first_recorder = 0;
+    uint32_t recorders_count = 0;
+    std::optional<uint32_t> wait_batch {}; //earlier batch from another queue
+  };
+
+  //graph is built and compiled without device and swapchain, tasks are never recorded
+  struct HeadlessConfig {
+    uint32_t backbuffers_count = 3;
+    uint32_t width = 1920;
+    uint32_t height = 1080;
+    VkFormat backbuffer_format = VK_FORMAT_B8G8R8A8_UNORM;
+  };
+
   struct GpuState {
     GpuState()
       : backbuffers_count { gpu::app_swapchain().get_images_count()},
         frames_count {backbuffers_count},
-        desc_pool {frames_count},
-        event_pool {gpu::app_device().api_device(), frames_count},
-        ctx_pool {frames_count}
+        event_pool {gpu::app_device().api_device(), frames_count}
     {
       submit_fences.reserve(frames_count);
       image_acquire_semaphores.reserve(frames_count);
       submit_done_semaphores.reserve(frames_count);
+      batch_semaphores.resize(frames_count);
 
       for (uint32_t i = 0; i < frames_count; i++) {
         submit_fences.push_back(gpu::Fence(true));
@@ -29,21 +52,53 @@ namespace rendergraph {
       }
     }
 
-    ~GpuState() { vkDeviceWaitIdle(gpu::app_device().api_device()); }
+    explicit GpuState(const HeadlessConfig &config)
+      : backbuffers_count {config.backbuffers_count},
+        frames_count {backbuffers_count},
+        event_pool {VK_NULL_HANDLE, frames_count},
+        headless {true}
+    {
+      batch_semaphores.resize(frames_count);
+    }
+
+    ~GpuState() {
+      if (!headless) {
+        std::scoped_lock lock {gpu::app_queue_lock()};
+        vkDeviceWaitIdle(gpu::app_device().api_device());
+      }
+    }
 
     void acquire_image();
-    void begin();
+    //starts frame with given count of recorders, each recorder fills one command buffer
+    void begin(uint32_t recorders_count = 1);
+    //all recorders are sent to the main queue in order
     void submit(bool present);
-
-    gpu::CmdContext &get_cmdbuff() { return ctx_pool.get_ctx(); }
+    //last batch must be on the main queue and run after every other batch
+    void submit(bool present, const std::vector<SubmitBatch> &batches);
+
+    //each recorder owns command pool, ubo pool and descriptor pool, so recorders may be filled from different threads
+    gpu::CmdContext &get_cmdbuff(uint32_t recorder = 0) { return recorders.at(recorder)->ctx_pool.get_ctx(); }
+    gpu::DescriptorPool &get_desc_pool(uint32_t recorder = 0) { return recorders.at(recorder)->desc_pool; }
+    gpu::DescriptorSetCache &get_desc_cache(uint32_t recorder = 0) { return recorders.at(recorder)->desc_cache; }
+    //summed over recorders
+    gpu::DescriptorCacheStats get_desc_cache_stats() const;
+    gpu::DescriptorPoolStats get_desc_pool_stats() const;
+    uint32_t get_active_recorders() const { return active_recorders; }
+
+    bool has_async_compute() const { return !headless && gpu::app_device().has_async_compute(); }
+    bool has_synchronization2() const { return !headless && gpu::app_device().has_synchronization2(); }
+    
+    bool is_headless() const { return headless; }
+    //advances frame and backbuffer indices as submit does
+    void skip_frame(bool present);
     
     uint32_t get_frame_index() const { return frame_index; }
     uint32_t get_backbuf_index() const { return backbuf_index; }
 
     std::vector<gpu::ImagePtr> take_backbuffers() { return gpu::get_swapchain_image_ptr(); }
 
-    VkDescriptorSet allocate_set(VkDescriptorSetLayout layout) { return desc_pool.allocate_set(layout); }
-    VkDescriptorSet allocate_set(VkDescriptorSetLayout layout, const std::vector<uint32_t> &variable_sizes) { return desc_pool.allocate_set(layout, variable_sizes); }
+    VkDescriptorSet allocate_set(VkDescriptorSetLayout layout) { return get_desc_pool().allocate_set(layout); }
+    VkDescriptorSet allocate_set(VkDescriptorSetLayout layout, const std::vector<uint32_t> &variable_sizes) { return get_desc_pool().allocate_set(layout, variable_sizes); }
     
     VkEvent allocate_event() { return event_pool.allocate(); }
     
@@ -54,22 +109,36 @@ namespace rendergraph {
     uint32_t backbuffers_count = 0;
     uint32_t frames_count = 0;
 
+    struct Recorder {
+      Recorder(uint32_t frames_count) : desc_pool {frames_count}, desc_cache {frames_count}, ctx_pool {frames_count} {}
+      
+      gpu::DescriptorPool desc_pool;
+      gpu::DescriptorSetCache desc_cache;
+      gpu::CmdContextPool ctx_pool;
+    };
+
     //gpu::CmdBufferPool cmdbuffer_pool;
-    gpu::DescriptorPool desc_pool;
     gpu::EventPool event_pool;
 
-    //std::vector<gpu::CmdContext> cmd_buffers;
-    gpu::CmdContextPool ctx_pool;
+    //recorders are created on demand and flipped only in frames where they are used
+    std::vector<std::unique_ptr<Recorder>> recorders;
+    uint32_t active_recorders = 0;
+    std::vector<VkCommandBuffer> submit_buffers;
+    
     std::vector<gpu::Fence> submit_fences;
     std::vector<gpu::Semaphore> image_acquire_semaphores;
     std::vector<gpu::Semaphore> submit_done_semaphores;  
-
+    std::vector<std::vector<gpu::Semaphore>> batch_semaphores;
     
     uint32_t frame_index = 0;
     uint32_t backbuf_index = 0;
     uint32_t backbuf_sem_index = 0;
+    bool headless = false;
+
+    void end_recording();
+    void flip_recorders();
   };
 
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,215 @@
+#include "gpu_profiler.hpp"
+
+#include <algorithm>
+#include <lib/imgui/imgui.h>
+
+namespace rendergraph {
+
+  GpuProfiler::~GpuProfiler() {
+    for (auto &frame : frames) {
+      if (frame.pool) {
+        vkDestroyQueryPool(gpu::app_device().api_device(), frame.pool, nullptr);
+      }
+    }
+  }
+
+  void GpuProfiler::begin_frame(uint32_t frame_index, uint32_t frames_count, uint32_t tasks_count) {
+    active = nullptr;
+
+    if (!is_active()) {
+      for (auto &frame : frames) {
+        frame.pending = false;
+      }
+      return;
+    }
+
+    if (frames.size() < frames_count) {
+      frames.resize(frames_count);
+    }
+
+    auto &queries = frames.at(frame_index);
+    if (queries.pending) {
+      collect(queries);
+    }
+
+    reserve(queries, tasks_count);
+    queries.tasks_count = 0;
+    queries.pending = true;
+    active = &queries;
+  }
+
+  void GpuProfiler::add_task(const char *name) {
+    if (!active) {
+      return;
+    }
+
+    if (active->names.size() <= active->tasks_count) {
+      active->names.emplace_back();
+    }
+    active->names[active->tasks_count++] = name;
+  }
+
+  void GpuProfiler::reserve(FrameQueries &queries, uint32_t tasks_count) {
+    uint32_t required = 2 * tasks_count;
+    if (queries.pool && queries.capacity >= required) {
+      return;
+    }
+
+    auto device = gpu::app_device().api_device();
+    if (queries.pool) {
+      vkDestroyQueryPool(device, queries.pool, nullptr);
+      queries.pool = nullptr;
+    }
+
+    queries.capacity = std::max(required, 2 * queries.capacity);
+
+    VkQueryPoolCreateInfo info {
+      .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+      .pNext = nullptr,
+      .flags = 0,
+      .queryType = VK_QUERY_TYPE_TIMESTAMP,
+      .queryCount = queries.capacity,
+      .pipelineStatistics = 0
+    };
+    VKCHECK(vkCreateQueryPool(device, &info, nullptr, &queries.pool));
+  }
+
+  void GpuProfiler::reset_queries(VkCommandBuffer cmd, uint32_t first_task, uint32_t last_task) {
+    if (!active || first_task >= last_task) {
+      return;
+    }
+    //reset is recorded into the same command buffer, so queries don't depend on other queues
+    vkCmdResetQueryPool(cmd, active->pool, 2 * first_task, 2 * (last_task - first_task));
+  }
+
+  void GpuProfiler::write_begin(VkCommandBuffer cmd, uint32_t task) {
+    if (!active) {
+      return;
+    }
+    vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, active->pool, 2 * task);
+  }
+
+  void GpuProfiler::write_end(VkCommandBuffer cmd, uint32_t task) {
+    if (!active) {
+      return;
+    }
+    vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, active->pool, 2 * task + 1);
+  }
+
+  float GpuProfiler::push_sample(History &history, float value) {
+    history.samples[history.next] = value;
+    history.next = (history.next + 1) % HISTORY_SIZE;
+    history.count = std::min(history.count + 1, HISTORY_SIZE);
+
+    float sum = 0.f;
+    for (uint32_t i = 0; i < history.count; i++) {
+      sum += history.samples[i];
+    }
+    return sum/history.count;
+  }
+
+  void GpuProfiler::collect(FrameQueries &queries) {
+    queries.pending = false;
+    uint32_t count = 2 * queries.tasks_count;
+    if (!count) {
+      return;
+    }
+
+    results.resize(count);
+    auto res = vkGetQueryPoolResults(
+      gpu::app_device().api_device(),
+      queries.pool,
+      0,
+      count,
+      results.size() * sizeof(uint64_t),
+      results.data(),
+      sizeof(uint64_t),
+      VK_QUERY_RESULT_64_BIT);
+
+    //frame fence is signaled, so results are expected to be ready. Otherwise frame is skipped
+    if (res == VK_NOT_READY) {
+      return;
+    }
+    VKCHECK(res);
+
+    const auto &device = gpu::app_device();
+    uint32_t valid_bits = device.get_timestamp_valid_bits();
+    uint64_t mask = (valid_bits >= 64)? ~0ull : ((1ull << valid_bits) - 1);
+    float period_ms = device.get_properties().limits.timestampPeriod * 1e-6f;
+
+    collected_frames++;
+    frame_order.clear();
+
+    uint64_t frame_start = results[0] & mask;
+    uint64_t frame_end = frame_start;
+
+    for (uint32_t i = 0; i < queries.tasks_count; i++) {
+      uint64_t start = results[2 * i] & mask;
+      uint64_t end = results[2 * i + 1] & mask;
+      float ms = float((end - start) & mask) * period_ms;
+
+      frame_start = std::min(frame_start, start);
+      frame_end = std::max(frame_end, end);
+
+      auto iter = history.find(queries.names[i]);
+      if (iter == history.end()) {
+        iter = history.emplace(queries.names[i], History {}).first;
+      }
+
+      auto &task_history = iter->second;
+      if (task_history.frame != collected_frames) {
+        task_history.frame = collected_frames;
+        task_history.current = 0.f;
+        frame_order.push_back(&*iter);
+      }
+      task_history.current += ms;
+    }
+
+    timings.resize(frame_order.size());
+    for (uint32_t i = 0; i < frame_order.size(); i++) {
+      auto &[name, task_history] = *frame_order[i];
+      auto &timing = timings[i];
+
+      timing.name = name;
+      timing.last_ms = task_history.current;
+      timing.avg_ms = push_sample(task_history, task_history.current);
+      timing.max_ms = *std::max_element(task_history.samples.begin(), task_history.samples.begin() + task_history.count);
+    }
+
+    frame_ms = push_sample(frame_history, float((frame_end - frame_start) & mask) * period_ms);
+  }
+
+  void GpuProfiler::draw_ui() const {
+    ImGui::Begin("GPU profiler");
+    if (!enabled) {
+      ImGui::Text("Profiler is disabled");
+      ImGui::End();
+      return;
+    }
+
+    ImGui::Text("Frame %.3f ms (avg of %u frames)", frame_ms, HISTORY_SIZE);
+
+    if (ImGui::BeginTable("Tasks", 4, ImGuiTableFlags_Borders|ImGuiTableFlags_RowBg)) {
+      ImGui::TableSetupColumn("Task");
+      ImGui::TableSetupColumn("Last, ms");
+      ImGui::TableSetupColumn("Avg, ms");
+      ImGui::TableSetupColumn("Max, ms");
+      ImGui::TableHeadersRow();
+
+      for (const auto &timing : timings) {
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::TextUnformatted(timing.name.c_str());
+        ImGui::TableNextColumn();
+        ImGui::Text("%.3f", timing.last_ms);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.3f", timing.avg_ms);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.3f", timing.max_ms);
+      }
+      ImGui::EndTable();
+    }
+    ImGui::End();
+  }
+
+}
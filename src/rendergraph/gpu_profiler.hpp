@@ -0,0 +1,85 @@
+#ifndef RENDERGRAPH_GPU_PROFILER_HPP_INCLUDED
+#define RENDERGRAPH_GPU_PROFILER_HPP_INCLUDED
+
+#include "gpu/driver.hpp"
+
+#include <array>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace rendergraph {
+
+  struct TaskTiming {
+    std::string name;
+    float last_ms = 0.f;
+    float avg_ms = 0.f;
+    float max_ms = 0.f;
+  };
+
+  //timestamps are written around task commands of frame N and read when frame slot N is reused,
+  //after its fence is signaled, so reading never stalls. Tasks with the same name are summed
+  struct GpuProfiler {
+    static constexpr uint32_t HISTORY_SIZE = 64;
+
+    GpuProfiler() {}
+    ~GpuProfiler();
+
+    void enable(bool enable) { enabled = enable; }
+    bool is_active() const { return enabled && gpu::app_device().get_timestamp_valid_bits() != 0; }
+
+    //frame fence must be waited. Task names are added in recording order
+    void begin_frame(uint32_t frame_index, uint32_t frames_count, uint32_t tasks_count);
+    void add_task(const char *name);
+
+    //may be called from recording threads, each task has own queries.
+    //Queries are reset outside of render passes, before the first task of the range
+    void reset_queries(VkCommandBuffer cmd, uint32_t first_task, uint32_t last_task);
+    void write_begin(VkCommandBuffer cmd, uint32_t task);
+    void write_end(VkCommandBuffer cmd, uint32_t task);
+
+    //task order of the last collected frame
+    const std::vector<TaskTiming> &get_timings() const { return timings; }
+    float get_frame_ms() const { return frame_ms; }
+    void draw_ui() const;
+
+    GpuProfiler(const GpuProfiler &) = delete;
+    GpuProfiler &operator=(const GpuProfiler &) = delete;
+
+  private:
+    struct FrameQueries {
+      VkQueryPool pool {nullptr};
+      uint32_t capacity = 0;
+      bool pending = false;
+      std::vector<std::string> names;
+      uint32_t tasks_count = 0;
+    };
+
+    struct History {
+      std::array<float, HISTORY_SIZE> samples {};
+      uint32_t count = 0;
+      uint32_t next = 0;
+      float current = 0.f;
+      uint64_t frame = ~0ull;
+    };
+
+    bool enabled = false;
+    std::vector<FrameQueries> frames;
+    FrameQueries *active = nullptr;
+
+    std::vector<uint64_t> results;
+    std::unordered_map<std::string, History> history;
+    std::vector<std::pair<const std::string, History>*> frame_order;
+    std::vector<TaskTiming> timings;
+    uint64_t collected_frames = 0;
+    float frame_ms = 0.f;
+    History frame_history;
+
+    void collect(FrameQueries &queries);
+    void reserve(FrameQueries &queries, uint32_t tasks_count);
+    static float push_sample(History &history, float value);
+  };
+
+}
+
+#endif
@@ -0,0 +1,315 @@
+#include "graph_dump.hpp"
+
+#include <algorithm>
+#include <map>
+#include <sstream>
+#include <lib/json.hpp>
+
+using json = nlohmann::json;
+
+namespace rendergraph {
+
+  enum class SyncKind {
+    None,
+    Pipeline,
+    Events,
+    Queue
+  };
+
+  static const char *sync_kind_name(SyncKind kind) {
+    switch (kind) {
+    case SyncKind::Pipeline: return "pipeline";
+    case SyncKind::Events: return "events";
+    case SyncKind::Queue: return "queue";
+    default: return "none";
+    }
+  }
+
+  //the same choice as RenderGraph::record_tasks
+  static SyncKind get_sync_kind(const GraphDump &dump, uint32_t index) {
+    const auto &barrier = dump.barriers[index];
+    if (barrier.is_empty()) {
+      return SyncKind::None;
+    }
+
+    if (!dump.task_queues.empty()) {
+      for (auto task : barrier.wait_tasks) {
+        if (dump.task_queues.at(task) != dump.task_queues.at(index)) {
+          return SyncKind::Queue;
+        }
+      }
+    }
+
+    if (!dump.use_events || index == 0 || barrier.max_wait_task_index == index - 1 || barrier.wait_tasks.empty()) {
+      return SyncKind::Pipeline;
+    }
+    return SyncKind::Events;
+  }
+
+  //unordered set, sorted for stable diffs between builds
+  static std::vector<uint32_t> sorted_waits(const Barrier &barrier) {
+    std::vector<uint32_t> tasks {barrier.wait_tasks.begin(), barrier.wait_tasks.end()};
+    std::sort(tasks.begin(), tasks.end());
+    return tasks;
+  }
+
+  static uint32_t count_transitions(const ImageBarrierState &barrier) {
+    return (barrier.src.layout != barrier.dst.layout)? barrier.mip_count * barrier.layer_count : 0;
+  }
+
+  //image index -> subresource layout transitions
+  static std::map<uint32_t, uint32_t> get_image_transitions(const GraphDump &dump) {
+    std::map<uint32_t, uint32_t> transitions;
+    for (const auto &input : dump.inputs.images) {
+      transitions.emplace(input.id.id.get_index(), 0);
+    }
+
+    for (const auto &barrier : dump.barriers) {
+      for (const auto &image : barrier.image_barriers) {
+        transitions[image.id.id.get_index()] += count_transitions(image);
+      }
+    }
+    return transitions;
+  }
+
+  BarrierStats get_barrier_stats(const GraphDump &dump) {
+    BarrierStats stats {};
+    for (uint32_t i = 0; i < dump.barriers.size(); i++) {
+      const auto &barrier = dump.barriers[i];
+      switch (get_sync_kind(dump, i)) {
+      case SyncKind::Pipeline: stats.pipeline_barriers++; break;
+      case SyncKind::Events: stats.event_waits++; break;
+      case SyncKind::Queue: stats.queue_waits++; break;
+      default: break;
+      }
+
+      if (dump.use_events && barrier.signal_mask) {
+        stats.signaled_events++;
+      }
+      stats.image_barriers += barrier.image_barriers.size();
+      stats.buffer_barriers += barrier.buffer_barriers.size();
+      for (const auto &image : barrier.image_barriers) {
+        stats.layout_transitions += count_transitions(image);
+      }
+    }
+    return stats;
+  }
+
+  static void write_string(std::ostream &out, const std::string &str) {
+    out << '"';
+    for (char c : str) {
+      if (c == '"' || c == '\\') {
+        out << '\\' << c;
+      } else if (uint8_t(c) < 0x20) {
+        out << ' ';
+      } else {
+        out << c;
+      }
+    }
+    out << '"';
+  }
+
+  template <typename T, typename Writer>
+  static std::string flags_str(T flags, Writer writer) {
+    std::ostringstream out;
+    writer(out, flags);
+    return out.str();
+  }
+
+  static const char *queue_name(const GraphDump &dump, uint32_t task) {
+    if (dump.task_queues.empty() || dump.task_queues.at(task) == QueueType::Main) {
+      return "main";
+    }
+    return "async_compute";
+  }
+
+  static int64_t task_index(uint32_t task) {
+    return (task == INVALID_BARRIER_INDEX)? -1 : int64_t(task);
+  }
+
+  void write_graph_json(std::ostream &out, const GraphDump &dump) {
+    json root;
+
+    auto &tasks = root["tasks"] = json::array();
+    for (uint32_t i = 0; i < dump.tasks.size(); i++) {
+      tasks.push_back({{"index", i}, {"name", dump.tasks[i]}, {"queue", queue_name(dump, i)}});
+    }
+    root["culled_tasks"] = dump.culled_tasks;
+
+    auto &resources = root["resources"] = json::array();
+    for (const auto &[image, transitions] : get_image_transitions(dump)) {
+      resources.push_back({{"type", "image"}, {"id", image}, {"layout_transitions", transitions}});
+    }
+    std::map<uint32_t, uint32_t> buffers;
+    for (const auto &input : dump.inputs.buffers) {
+      buffers.emplace(input.id.get_index(), 0);
+    }
+    for (const auto &[buffer, unused] : buffers) {
+      resources.push_back({{"type", "buffer"}, {"id", buffer}});
+    }
+
+    auto &edges = root["edges"] = json::array();
+    for (const auto &input : dump.inputs.images) {
+      edges.push_back({
+        {"task", input.task},
+        {"type", "image"},
+        {"id", input.id.id.get_index()},
+        {"mip", input.id.mip},
+        {"mip_count", input.mip_count},
+        {"layer", input.id.layer},
+        {"layer_count", input.layer_count},
+        {"write", is_write_access(input.state.access)},
+        {"stages", flags_str(input.state.stages, write_stages)},
+        {"access", flags_str(input.state.access, write_access)},
+        {"layout", flags_str(input.state.layout, write_layout)}
+      });
+    }
+    for (const auto &input : dump.inputs.buffers) {
+      edges.push_back({
+        {"task", input.task},
+        {"type", "buffer"},
+        {"id", input.id.get_index()},
+        {"write", is_write_access(input.state.access)},
+        {"stages", flags_str(input.state.stages, write_stages)},
+        {"access", flags_str(input.state.access, write_access)}
+      });
+    }
+
+    auto &barriers = root["barriers"] = json::array();
+    for (uint32_t i = 0; i < dump.barriers.size(); i++) {
+      const auto &barrier = dump.barriers[i];
+      auto kind = get_sync_kind(dump, i);
+      if (kind == SyncKind::None && !barrier.signal_mask) {
+        continue;
+      }
+
+      json image_barriers = json::array();
+      for (const auto &image : barrier.image_barriers) {
+        image_barriers.push_back({
+          {"id", image.id.id.get_index()},
+          {"mip", image.id.mip},
+          {"mip_count", image.mip_count},
+          {"layer", image.id.layer},
+          {"layer_count", image.layer_count},
+          {"wait_for", task_index(image.wait_for)},
+          {"src_stages", flags_str(image.src.stages, write_stages)},
+          {"src_access", flags_str(image.src.access, write_access)},
+          {"src_layout", flags_str(image.src.layout, write_layout)},
+          {"dst_stages", flags_str(image.dst.stages, write_stages)},
+          {"dst_access", flags_str(image.dst.access, write_access)},
+          {"dst_layout", flags_str(image.dst.layout, write_layout)}
+        });
+      }
+
+      json buffer_barriers = json::array();
+      for (const auto &buffer : barrier.buffer_barriers) {
+        buffer_barriers.push_back({
+          {"id", buffer.id.get_index()},
+          {"wait_for", task_index(buffer.wait_for)},
+          {"src_stages", flags_str(buffer.src.stages, write_stages)},
+          {"src_access", flags_str(buffer.src.access, write_access)},
+          {"dst_stages", flags_str(buffer.dst.stages, write_stages)},
+          {"dst_access", flags_str(buffer.dst.access, write_access)}
+        });
+      }
+
+      barriers.push_back({
+        {"task", i},
+        {"sync", sync_kind_name(kind)},
+        {"wait_tasks", sorted_waits(barrier)},
+        {"signal_stages", flags_str(dump.use_events? barrier.signal_mask : 0, write_stages)},
+        {"image_barriers", std::move(image_barriers)},
+        {"buffer_barriers", std::move(buffer_barriers)}
+      });
+    }
+
+    auto stats = get_barrier_stats(dump);
+    root["stats"] = {
+      {"tasks", dump.tasks.size()},
+      {"culled_tasks", dump.culled_tasks.size()},
+      {"pipeline_barriers", stats.pipeline_barriers},
+      {"event_waits", stats.event_waits},
+      {"queue_waits", stats.queue_waits},
+      {"signaled_events", stats.signaled_events},
+      {"image_barriers", stats.image_barriers},
+      {"buffer_barriers", stats.buffer_barriers},
+      {"layout_transitions", stats.layout_transitions}
+    };
+
+    out << root.dump(2) << "\n";
+  }
+
+  //tasks are boxes, resources are ellipses. Reads point into the task, writes out of it,
+  //dashed edges are execution dependencies resolved by barriers or events
+  void write_graph_dot(std::ostream &out, const GraphDump &dump) {
+    auto stats = get_barrier_stats(dump);
+
+    out << "digraph rendergraph {\n"
+      << "  rankdir=LR;\n"
+      << "  label=\"tasks " << dump.tasks.size()
+      << ", pipeline barriers " << stats.pipeline_barriers
+      << ", event waits " << stats.event_waits
+      << ", queue waits " << stats.queue_waits
+      << ", layout transitions " << stats.layout_transitions << "\";\n";
+
+    for (uint32_t i = 0; i < dump.tasks.size(); i++) {
+      out << "  t" << i << " [shape=box, label=";
+      write_string(out, std::to_string(i) + ": " + dump.tasks[i]);
+      if (!dump.task_queues.empty() && dump.task_queues.at(i) == QueueType::AsyncCompute) {
+        out << ", style=filled, fillcolor=lightblue";
+      }
+      out << "];\n";
+    }
+
+    for (const auto &[image, transitions] : get_image_transitions(dump)) {
+      out << "  img" << image << " [shape=ellipse, label=\"image " << image << "\\n" << transitions << " transitions\"];\n";
+    }
+
+    std::map<uint32_t, uint32_t> buffers;
+    for (const auto &input : dump.inputs.buffers) {
+      buffers.emplace(input.id.get_index(), 0);
+    }
+    for (const auto &[buffer, unused] : buffers) {
+      out << "  buf" << buffer << " [shape=ellipse, style=dashed, label=\"buffer " << buffer << "\"];\n";
+    }
+
+    for (const auto &input : dump.inputs.images) {
+      std::string label = "mip " + std::to_string(input.id.mip) + "+" + std::to_string(input.mip_count)
+        + " layer " + std::to_string(input.id.layer) + "+" + std::to_string(input.layer_count);
+
+      if (is_write_access(input.state.access)) {
+        out << "  t" << input.task << " -> img" << input.id.id.get_index();
+      } else {
+        out << "  img" << input.id.id.get_index() << " -> t" << input.task;
+      }
+      out << " [label=\"" << label << "\"];\n";
+    }
+
+    for (const auto &input : dump.inputs.buffers) {
+      if (is_write_access(input.state.access)) {
+        out << "  t" << input.task << " -> buf" << input.id.get_index() << ";\n";
+      } else {
+        out << "  buf" << input.id.get_index() << " -> t" << input.task << ";\n";
+      }
+    }
+
+    for (uint32_t i = 0; i < dump.barriers.size(); i++) {
+      auto kind = get_sync_kind(dump, i);
+      if (kind == SyncKind::None) {
+        continue;
+      }
+
+      uint32_t transitions = 0;
+      for (const auto &image : dump.barriers[i].image_barriers) {
+        transitions += count_transitions(image);
+      }
+
+      for (auto task : sorted_waits(dump.barriers[i])) {
+        out << "  t" << task << " -> t" << i << " [style=dashed, constraint=false, label=\""
+          << sync_kind_name(kind) << ", " << transitions << " transitions\"];\n";
+      }
+    }
+    out << "}\n";
+  }
+
+}
@@ -0,0 +1,43 @@
+#ifndef RENDERGRAPH_GRAPH_DUMP_HPP_INCLUDED
+#define RENDERGRAPH_GRAPH_DUMP_HPP_INCLUDED
+
+#include "resources.hpp"
+#include "gpu_ctx.hpp"
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace rendergraph {
+
+  //compiled frame for external tools. Barrier i is recorded before task i, inputs refer to live tasks
+  struct GraphDump {
+    std::vector<std::string> tasks;
+    //empty if all tasks are on the main queue
+    std::vector<QueueType> task_queues;
+    std::vector<std::string> culled_tasks;
+    GraphInputs inputs;
+    std::vector<Barrier> barriers;
+    //split barriers are recorded as events, otherwise every barrier is a pipeline barrier
+    bool use_events = true;
+  };
+
+  struct BarrierStats {
+    uint32_t pipeline_barriers = 0;
+    uint32_t event_waits = 0;
+    //semaphore between queue batches covers execution dependency
+    uint32_t queue_waits = 0;
+    uint32_t signaled_events = 0;
+    uint32_t image_barriers = 0;
+    uint32_t buffer_barriers = 0;
+    //counted per subresource
+    uint32_t layout_transitions = 0;
+  };
+
+  BarrierStats get_barrier_stats(const GraphDump &dump);
+  void write_graph_json(std::ostream &out, const GraphDump &dump);
+  void write_graph_dot(std::ostream &out, const GraphDump &dump);
+
+}
+
+#endif
@@ -1,5 +1,8 @@
 #include "rendergraph.hpp"
 #include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <lib/imgui/imgui.h>
 
 namespace rendergraph {
   
@@ -28,6 +31,7 @@ namespace rendergraph {
   }
 
   ImageViewId RenderGraphBuilder::use_color_attachment(ImageResourceId id, uint32_t mip, uint32_t layer) {
+    uses_attachments = true;
     ImageSubresourceId subres {id, mip, layer};
     ImageSubresourceState state {
       VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
@@ -39,6 +43,7 @@ namespace rendergraph {
   }
   
   ImageViewId RenderGraphBuilder::use_depth_attachment(ImageResourceId id, uint32_t mip, uint32_t layer) {
+    uses_attachments = true;
     ImageSubresourceId subres {id, mip, layer};
     ImageSubresourceState state {
       VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT|VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
@@ -50,12 +55,12 @@ namespace rendergraph {
     return ImageViewId {id, gpu::ImageViewRange {VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_DEPTH_BIT, mip, 1, layer, 1}};
   }
   
-  ImageViewId RenderGraphBuilder::use_storage_image(ImageResourceId id, VkShaderStageFlags stages, uint32_t mip, uint32_t layer) {
+  ImageViewId RenderGraphBuilder::use_storage_image(ImageResourceId id, VkShaderStageFlags stages, uint32_t mip, uint32_t layer, bool readonly) {
     auto pipeline_stages = get_pipeline_flags(stages);
     ImageSubresourceId subres {id, mip, layer};
     ImageSubresourceState state {
       pipeline_stages,
-      VK_ACCESS_SHADER_READ_BIT|VK_ACCESS_SHADER_WRITE_BIT,
+      readonly? VK_ACCESS_SHADER_READ_BIT : (VK_ACCESS_SHADER_READ_BIT|VK_ACCESS_SHADER_WRITE_BIT),
       VK_IMAGE_LAYOUT_GENERAL
     };
     
@@ -63,20 +68,17 @@ namespace rendergraph {
     return ImageViewId {id, gpu::ImageViewRange {VK_IMAGE_VIEW_TYPE_2D, mip, 1, layer, 1}};
   }
 
-  ImageViewId RenderGraphBuilder::use_storage_image_array(ImageResourceId id, VkShaderStageFlags stages) {
+  ImageViewId RenderGraphBuilder::use_storage_image_array(ImageResourceId id, VkShaderStageFlags stages, bool readonly) {
     auto pipeline_stages = get_pipeline_flags(stages);
     const auto &desc = resources.get_info(id);
     
     ImageSubresourceState state {
       pipeline_stages,
-      VK_ACCESS_SHADER_READ_BIT|VK_ACCESS_SHADER_WRITE_BIT,
+      readonly? VK_ACCESS_SHADER_READ_BIT : (VK_ACCESS_SHADER_READ_BIT|VK_ACCESS_SHADER_WRITE_BIT),
       VK_IMAGE_LAYOUT_GENERAL
     };
 
-    for (uint32_t layer = 0; layer < desc.arrayLayers; layer++) {
-      ImageSubresourceId subres {id, 0, layer};
-      tracking_state.add_input(resources, subres, state);
-    }
+    tracking_state.add_input(resources, ImageSubresourceId {id, 0, 0}, 1, desc.arrayLayers, state);
     
     return ImageViewId {id, gpu::ImageViewRange {VK_IMAGE_VIEW_TYPE_2D_ARRAY, 0, 1, 0, desc.arrayLayers}};
   }
@@ -95,12 +97,7 @@ namespace rendergraph {
       VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
     };
 
-    for (uint32_t layer = base_layer; layer < base_layer + layer_count; layer++) {
-      for (uint32_t mip = base_mip; mip < base_mip + mip_count; mip++) {
-        ImageSubresourceId subres {id, mip, layer};
-        tracking_state.add_input(resources, subres, state);
-      }
-    }
+    tracking_state.add_input(resources, ImageSubresourceId {id, base_mip, base_layer}, mip_count, layer_count, state);
     auto type = (layer_count > 1)? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D; 
     return ImageViewId {id, {type, aspect, base_mip, mip_count, base_layer, layer_count}};
   }
@@ -115,12 +112,7 @@ namespace rendergraph {
       VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
     };
 
-    for (uint32_t layer = 0; layer < desc.arrayLayers; layer++) {
-      for (uint32_t mip = 0; mip < desc.mipLevels; mip++) {
-        ImageSubresourceId subres {id, mip, layer};
-        tracking_state.add_input(resources, subres, state);
-      }
-    }
+    tracking_state.add_input(resources, ImageSubresourceId {id, 0, 0}, desc.mipLevels, desc.arrayLayers, state);
 
     return ImageViewId {id, {VK_IMAGE_VIEW_TYPE_CUBE, aspect, 0, desc.mipLevels, 0, desc.arrayLayers}};
   }
@@ -132,12 +124,7 @@ namespace rendergraph {
       VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
     };
 
-    for (uint32_t layer = base_layer; layer < base_layer + layer_count; layer++) {
-      for (uint32_t mip = base_mip; mip < base_mip + mip_count; mip++) {
-        ImageSubresourceId subres {id, mip, layer};
-        tracking_state.add_input(resources, subres, state);
-      }
-    }
+    tracking_state.add_input(resources, ImageSubresourceId {id, base_mip, base_layer}, mip_count, layer_count, state);
 
   }
   
@@ -148,12 +135,7 @@ namespace rendergraph {
       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
     };
 
-    for (uint32_t layer = base_layer; layer < base_layer + layer_count; layer++) {
-      for (uint32_t mip = base_mip; mip < base_mip + mip_count; mip++) {
-        ImageSubresourceId subres {id, mip, layer};
-        tracking_state.add_input(resources, subres, state);
-      }
-    }
+    tracking_state.add_input(resources, ImageSubresourceId {id, base_mip, base_layer}, mip_count, layer_count, state);
   }
 
   void RenderGraphBuilder::transfer_write(BufferResourceId id) {
@@ -199,6 +181,7 @@ namespace rendergraph {
   }
 
   ImageViewId RenderGraphBuilder::use_backbuffer_attachment() {
+    uses_attachments = true;
 
     ImageSubresourceState state {
       VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
@@ -225,7 +208,7 @@ namespace rendergraph {
     
     res.format = info.format;
     
-    res.aspect = resources.get_image(id)->get_default_aspect();
+    res.aspect = gpu::get_default_aspect(info.format);
     return res;
   }
   
@@ -242,7 +225,7 @@ namespace rendergraph {
     
     res.format = info.format;
     
-    res.aspect = resources.get_image(id)->get_default_aspect();
+    res.aspect = gpu::get_default_aspect(info.format);
     return res;
   }
 
@@ -264,80 +247,225 @@ namespace rendergraph {
     }
   }
 
+  RenderGraph::RenderGraph(const HeadlessConfig &config)
+    : gpu {config},
+      resources {true}
+  {
+    backbuffers.reserve(config.backbuffers_count);
+    for (uint32_t i = 0; i < config.backbuffers_count; i++) {
+      auto id = resources.create_global_image(ImageDescriptor {
+        VK_IMAGE_TYPE_2D,
+        config.backbuffer_format,
+        VK_IMAGE_ASPECT_COLOR_BIT,
+        VK_IMAGE_TILING_OPTIMAL,
+        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT|VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+        config.width,
+        config.height
+      });
+      resources.mark_persistent(id);
+      backbuffers.push_back(id);
+    }
+  }
+
   RenderGraph::~RenderGraph() {
-    vkDeviceWaitIdle(gpu::app_device().api_device());
+    render_thread.reset(); //joins the last recorded frame
+    if (!gpu.is_headless()) {
+      std::scoped_lock lock {gpu::app_queue_lock()};
+      vkDeviceWaitIdle(gpu::app_device().api_device());
+    }
+    for (auto &frame : frames) {
+      for (auto task : frame.tasks) {
+        task->~BaseTask();
+      }
+    }
   }
 
   void RenderGraph::submit() {
-    static int once = 2;
+    //tracking state is final after compile of the previous frame, so this frame is compiled while
+    //the previous one is recorded. Aliasing re-plan recreates images and waits for the device
+    if (frame_in_flight && !resources.needs_aliasing_update()) {
+      begin_overlapped_compile();
+    } else {
+      finish_frame();
+      if (!gpu.is_headless()) {
+        resources.update_aliasing();
+      }
+    }
+
+    auto &frame = frames[build_frame];
     tracking_state.flush(resources);
+    remove_culled_tasks(frame);
+    if (print_culled_tasks) {
+      dump_culled_tasks();
+    }
 #if RENDERGRAPH_DEBUG
     tracking_state.dump_barriers();
 #endif
-    if (once) {
-      tracking_state.dump_barriers();
-      once--;
+    frame.barriers = tracking_state.take_barriers();
+    frame.renderpasses = tracking_state.get_renderpasses();
+    auto dependencies = tracking_state.take_dependencies();
+    tracking_state.clear();
+
+    schedule_tasks(frame, dependencies);
+#if RENDERGRAPH_DEBUG
+    dump_async_tasks(frame);
+#endif
+    if (!export_json_path.empty() || !export_dot_path.empty()) {
+      export_frame(frame);
     }
 
-    auto barriers = tracking_state.take_barriers();
-    tracking_state.clear();
+    //gpu frame and backbuffer indices are advanced by the previous submit
+    finish_frame();
+    if (!gpu.is_headless()) {
+      gpu.begin(frame.record_ranges.size());
 
-    gpu.begin();
+      profiler.begin_frame(gpu.get_frame_index(), gpu.get_frames_count(), frame.tasks.size());
+      for (auto task : frame.tasks) {
+        profiler.add_task(task->get_name());
+      }
 
-    auto &api_cmd = gpu.get_cmdbuff(); 
-    RenderResources res {resources, gpu};
-    api_cmd.push_label("Rendergraph");
 #if RENDERGRAPH_USE_EVENTS
-    for (uint32_t i = 0; i < tasks.size(); i++) {
-      api_cmd.push_label(tasks[i]->get_name().c_str());
-      if (barriers.size() > i) {
-        resolve_barrier(barriers, i, api_cmd.get_command_buffer());
+      //events are created before recording, so recording threads only read barriers
+      for (uint32_t i = 0; i < frame.tasks.size() && i < frame.barriers.size(); i++) {
+        if (frame.barriers[i].signal_mask) {
+          frame.barriers[i].release_event = gpu.allocate_event();
+        }
       }
+#endif
+    }
+    find_event_waiters(frame);
 
-      tasks[i]->write_commands(res, api_cmd);
-      api_cmd.end_renderpass(); //to be sure about barriers
-      if (barriers.size() > i && barriers[i].signal_mask) {
-        auto event = gpu.allocate_event();
-        barriers[i].release_event = event;
-        api_cmd.signal_event(event, barriers[i].signal_mask);
-      }
-      api_cmd.pop_label();
+    frame.backbuffer_index = gpu.get_backbuf_index();
+    frame_index = (gpu.get_frame_index() + 1) % gpu.get_frames_count();
+    for (auto &history : history_images) {
+      history.valid_frames = std::min<uint32_t>(history.valid_frames + 1, history.images.size() - 1);
     }
-#else
-    for (uint32_t i = 0; i < tasks.size(); i++) {
-      api_cmd.push_label(tasks[i]->get_name().c_str());
-      if (barriers.size() > i) {
-        write_barrier(barriers[i], api_cmd.get_command_buffer());
+
+    build_frame ^= 1;
+    frame_in_flight = true;
+
+    if (!render_thread || gpu.is_headless()) {
+      record_frame(frame);
+      finish_frame();
+      return;
+    }
+    render_thread->submit([this, &frame](){
+      record_frame(frame);
+    });
+  }
+
+  void RenderGraph::record_frame(FrameTasks &frame) {
+    if (gpu.is_headless()) {
+      gpu.skip_frame(frame.present_backbuffer);
+      return;
+    }
+
+    const auto &record_ranges = frame.record_ranges;
+    if (!workers || record_ranges.size() <= 1) {
+      for (uint32_t recorder = 0; recorder < record_ranges.size(); recorder++) {
+        record_tasks(frame, record_ranges[recorder].first, record_ranges[recorder].second, recorder);
+      }
+    } else {
+      for (uint32_t recorder = 1; recorder < record_ranges.size(); recorder++) {
+        workers->submit([this, &frame, recorder](){
+          record_tasks(frame, frame.record_ranges[recorder].first, frame.record_ranges[recorder].second, recorder);
+        });
       }
 
-      tasks[i]->write_commands(res, api_cmd);
-      api_cmd.end_renderpass(); //to be sure about barriers
-      api_cmd.pop_label();
+      std::exception_ptr error;
+      try {
+        record_tasks(frame, record_ranges[0].first, record_ranges[0].second, 0);
+      } catch (...) {
+        error = std::current_exception();
+      }
+      
+      workers->wait_idle();
+      if (error) {
+        std::rethrow_exception(error);
+      }
     }
-#endif
-    tasks.clear();
-    api_cmd.pop_label();
-    
-    if (!present_backbuffer) {
-      gpu.submit(false);
+
+    gpu.submit(frame.present_backbuffer, frame.submit_batches);
+  }
+
+  void RenderGraph::finish_frame() {
+    if (!frame_in_flight) {
       return;
     }
+    frame_in_flight = false;
+    
+    if (render_thread) {
+      render_thread->wait_idle();
+    }
+
+    auto &frame = frames[build_frame ^ 1];
+    release_tasks(frame);
+    resources.apply_remaps();
+    if (!history_tracking_rotated) {
+      rotate_history();
+    }
+    history_tracking_rotated = false;
 
-    if (gpu.get_backbuf_index() != 0) { //remap back to restore order
-      resources.remap(backbuffers[0], backbuffers[gpu.get_backbuf_index()]);
+    if (frame.present_backbuffer) {
+      if (frame.backbuffer_index != 0) { //remap back to restore order
+        resources.remap(backbuffers[0], backbuffers[frame.backbuffer_index]);
+      }
+
+      auto backbuffer_index = gpu.get_backbuf_index(); 
+      if (backbuffer_index != 0) {
+        resources.remap(backbuffers[0], backbuffers[backbuffer_index]);
+      }
+      frame.present_backbuffer = false;
+    }
+
+    discard_history();
+  }
+
+  void RenderGraph::begin_overlapped_compile() {
+    //history images of the recorded frame keep their driver images until finish_frame
+    for (auto &history : history_images) {
+      for (uint32_t i = history.images.size() - 1; i > 0; i--) {
+        resources.remap_tracking(history.images[i], history.images[i - 1]);
+      }
     }
+    history_tracking_rotated = true;
+    discard_history();
 
-    gpu.submit(true);
+    //swapchain image of this frame is acquired by the previous submit, its layout is unknown
+    resources.discard_content(get_backbuffer());
+  }
 
-    auto backbuffer_index = gpu.get_backbuf_index(); 
-    if (backbuffer_index != 0) {
-      resources.remap(backbuffers[0], backbuffers[backbuffer_index]);
+  void RenderGraph::enable_pipelining(bool enable) {
+    finish_frame();
+    if (!enable) {
+      render_thread.reset();
+    } else if (!render_thread) {
+      render_thread.reset(new gpu::WorkerPool {1});
+    }
+  }
+
+  void RenderGraph::release_tasks(FrameTasks &frame) {
+    for (auto task : frame.tasks) {
+      task->~BaseTask();
+    }
+    frame.tasks.clear();
+
+    //both slots count as one arena in stats
+    uint64_t heap_allocations = task_list_allocations;
+    uint64_t reserved_bytes = 0;
+    for (const auto &slot : frames) {
+      heap_allocations += slot.arena.get_heap_allocations();
+      reserved_bytes += slot.arena.get_reserved_bytes();
     }
-    present_backbuffer = false;
+    task_alloc_stats.frame_heap_allocations = heap_allocations - task_alloc_stats.total_heap_allocations;
+    task_alloc_stats.total_heap_allocations = heap_allocations;
+    task_alloc_stats.frame_arena_bytes = frame.arena.get_used_bytes();
+    task_alloc_stats.arena_reserved_bytes = reserved_bytes;
+    frame.arena.reset();
   }
 
   ImageResourceId RenderGraph::create_image(VkImageType type, const gpu::ImageInfo &info, VkImageTiling tiling, VkImageUsageFlags usage, gpu::ImageCreateOptions options) {
-    return resources.create_global_image(ImageDescriptor {
+    return create_image(ImageDescriptor {
       type,
       info.format,
       info.aspect,
@@ -353,10 +481,12 @@ namespace rendergraph {
   }
 
   ImageResourceId RenderGraph::create_image(const ImageDescriptor &desc, gpu::ImageCreateOptions options) {
+    finish_frame(); //resource storage may be reallocated
     return resources.create_global_image(desc, options);
   }
 
   BufferResourceId RenderGraph::create_buffer(VmaMemoryUsage mem, uint64_t size, VkBufferUsageFlags usage) {
+    finish_frame();
     return resources.create_global_buffer(BufferDescriptor {size, usage, mem});
   }
 
@@ -369,9 +499,404 @@ namespace rendergraph {
   }*/
 
   void RenderGraph::remap(ImageResourceId src, ImageResourceId dst) {
+    finish_frame();
     resources.remap(src, dst);
   }
 
+  HistoryImageId RenderGraph::create_history_image(const ImageDescriptor &desc, uint32_t depth, gpu::ImageCreateOptions options) {
+    if (!depth) {
+      throw std::runtime_error {"History image without previous frames"};
+    }
+
+    finish_frame();
+    HistoryImage history {};
+    for (uint32_t i = 0; i <= depth; i++) {
+      auto id = resources.create_global_image(desc, options);
+      resources.mark_persistent(id);
+      history.images.push_back(id);
+    }
+
+    HistoryImageId result;
+    result.index = history_images.size();
+    history_images.push_back(std::move(history));
+    return result;
+  }
+
+  HistoryImageId RenderGraph::create_history_image(VkImageType type, const gpu::ImageInfo &info, VkImageTiling tiling, VkImageUsageFlags usage, uint32_t depth) {
+    return create_history_image(ImageDescriptor {
+      type,
+      info.format,
+      info.aspect,
+      tiling,
+      usage,
+      info.width,
+      info.height,
+      info.depth,
+      info.mip_levels,
+      info.array_layers
+    },
+    depth);
+  }
+
+  void RenderGraph::invalidate_history(HistoryImageId id) {
+    auto &history = history_images.at(id.index);
+    history.valid_frames = 0;
+    //previous images are known after rotation of the submitted frame
+    history.discard_pending = true;
+    if (!frame_in_flight) {
+      discard_history();
+    }
+  }
+
+  void RenderGraph::discard_history() {
+    for (auto &history : history_images) {
+      if (!history.discard_pending) {
+        continue;
+      }
+      history.discard_pending = false;
+      for (uint32_t i = 1; i < history.images.size(); i++) {
+        resources.discard_content(history.images[i]);
+      }
+    }
+  }
+
+  void RenderGraph::rotate_history() {
+    //current -> previous 1 -> ... -> previous N -> current
+    for (auto &history : history_images) {
+      for (uint32_t i = history.images.size() - 1; i > 0; i--) {
+        resources.remap(history.images[i], history.images[i - 1]);
+      }
+    }
+  }
+
+  void RenderGraph::remove_culled_tasks(FrameTasks &frame) {
+    culled_task_names.clear();
+    
+    const auto &culled = tracking_state.get_culled_tasks();
+    if (culled.empty()) {
+      return;
+    }
+
+    uint32_t culled_index = 0;
+    uint32_t live_count = 0;
+    auto &tasks = frame.tasks;
+    for (uint32_t i = 0; i < tasks.size(); i++) {
+      if (culled_index < culled.size() && culled[culled_index] == i) {
+        culled_task_names.push_back(tasks[i]->get_name());
+        tasks[i]->~BaseTask();
+        culled_index++;
+        continue;
+      }
+
+      if (live_count != i) {
+        tasks[live_count] = tasks[i];
+      }
+      live_count++;
+    }
+    tasks.resize(live_count);
+  }
+
+  void build_submit_batches(const std::vector<QueueType> &task_queues, const std::vector<std::vector<uint32_t>> &dependencies,
+    std::vector<std::pair<uint32_t, uint32_t>> &record_ranges, std::vector<SubmitBatch> &submit_batches)
+  {
+    //batch starts when queue changes or when task waits for a batch from another queue.
+    //Queue waits are ordered, so a batch from another queue is waited once
+    const uint32_t tasks_count = task_queues.size();
+    std::vector<uint32_t> task_batch(tasks_count, 0);
+    std::optional<uint32_t> last_waited[2] {};
+    std::optional<uint32_t> last_async_batch;
+
+    for (uint32_t i = 0; i < tasks_count; i++) {
+      auto queue = task_queues[i];
+      auto &waited = last_waited[uint32_t(queue)];
+      std::optional<uint32_t> wait_batch;
+      
+      if (i < dependencies.size()) {
+        for (auto dep : dependencies[i]) {
+          if (task_queues[dep] != queue && (!wait_batch.has_value() || wait_batch.value() < task_batch[dep])) {
+            wait_batch = task_batch[dep];
+          }
+        }
+      }
+
+      if (wait_batch.has_value() && waited.has_value() && wait_batch.value() <= waited.value()) {
+        wait_batch.reset();
+      }
+
+      if (submit_batches.empty() || submit_batches.back().queue != queue || wait_batch.has_value()) {
+        submit_batches.push_back(SubmitBatch {queue, uint32_t(record_ranges.size()), 1, wait_batch});
+        record_ranges.push_back({i, i});
+        if (wait_batch.has_value()) {
+          waited = wait_batch;
+        }
+      }
+
+      record_ranges.back().second = i + 1;
+      task_batch[i] = submit_batches.size() - 1;
+
+      if (queue == QueueType::AsyncCompute) {
+        last_async_batch = task_batch[i];
+      }
+    }
+
+    //frame fence is signaled by the last main queue batch, it must wait for async work
+    auto &main_waited = last_waited[uint32_t(QueueType::Main)];
+    if (last_async_batch.has_value() && (!main_waited.has_value() || main_waited.value() < last_async_batch.value())) {
+      submit_batches.push_back(SubmitBatch {QueueType::Main, uint32_t(record_ranges.size()), 0, last_async_batch});
+    }
+  }
+
+  void RenderGraph::schedule_tasks(FrameTasks &frame, const std::vector<std::vector<uint32_t>> &dependencies) {
+    const auto &tasks = frame.tasks;
+    auto &task_queues = frame.task_queues;
+    auto &record_ranges = frame.record_ranges;
+    auto &submit_batches = frame.submit_batches;
+    uint32_t tasks_count = tasks.size();
+    
+    task_queues.clear();
+    record_ranges.clear();
+    submit_batches.clear();
+    async_task_names.clear();
+
+    bool use_async = false;
+    if (async_compute_enabled && gpu.has_async_compute()) {
+      task_queues.resize(tasks_count, QueueType::Main);
+      //task 0 performs frame acquire barriers, so it stays on the main queue
+      for (uint32_t i = 1; i < tasks_count; i++) {
+        if (tasks[i]->async_compute) {
+          task_queues[i] = QueueType::AsyncCompute;
+          use_async = true;
+        }
+      }
+    }
+
+    if (!use_async) {
+      task_queues.clear();
+      uint32_t threads_count = std::max(std::min(get_recording_threads(), tasks_count), 1u);
+      for (uint32_t thread = 0; thread < threads_count; thread++) {
+        record_ranges.push_back({tasks_count * thread / threads_count, tasks_count * (thread + 1) / threads_count});
+      }
+      submit_batches.push_back(SubmitBatch {QueueType::Main, 0, threads_count, {}});
+      return;
+    }
+
+    build_submit_batches(task_queues, dependencies, record_ranges, submit_batches);
+    for (uint32_t i = 0; i < tasks_count; i++) {
+      if (task_queues[i] == QueueType::AsyncCompute) {
+        async_task_names.push_back(tasks[i]->get_name());
+      }
+    }
+  }
+
+  bool RenderGraph::waits_other_queue(const FrameTasks &frame, const Barrier &barrier, uint32_t index) const {
+    if (frame.task_queues.empty()) {
+      return false;
+    }
+
+    for (auto task : barrier.wait_tasks) {
+      if (frame.task_queues.at(task) != frame.task_queues.at(index)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void RenderGraph::record_tasks(FrameTasks &frame, uint32_t first, uint32_t last, uint32_t recorder) {
+    const auto &barriers = frame.barriers;
+    const auto &tasks = frame.tasks;
+    auto &api_cmd = gpu.get_cmdbuff(recorder);
+    RenderResources res {resources, gpu, recorder};
+    const bool sync2 = uses_synchronization2();
+    //render pass may stay open between merged tasks, raw buffer doesn't close it
+    auto cmd = api_cmd.get_command_buffer();
+    std::vector<gpu::AttachmentUsage> usages;
+
+    api_cmd.push_label("Rendergraph");
+    profiler.reset_queries(cmd, first, last);
+#if RENDERGRAPH_USE_EVENTS
+    for (uint32_t i = first; i < last; i++) {
+      api_cmd.push_label(tasks[i]->get_name());
+      //events can't be waited across queues, semaphore between batches already covers execution dependency
+      if (barriers.size() > i && waits_other_queue(frame, barriers[i], i)) {
+        if (sync2) {
+          write_barrier2(barriers[i], cmd);
+        } else {
+          write_barrier(barriers[i], cmd);
+        }
+      } else if (barriers.size() > i) {
+        if (sync2) {
+          resolve_barrier2(barriers, i, cmd);
+        } else {
+          resolve_barrier(barriers, i, cmd);
+        }
+      }
+
+      set_attachment_ops(frame, api_cmd, usages, i, first, last);
+      profiler.write_begin(cmd, i);
+      res.begin_task();
+      tasks[i]->write_commands(res, api_cmd);
+      api_cmd.end_renderpass(); //to be sure about barriers
+      profiler.write_end(cmd, i);
+      if (barriers.size() > i && barriers[i].signal_mask) {
+        if (sync2) {
+          signal_event2(frame, i, cmd);
+        } else {
+          api_cmd.signal_event(barriers[i].release_event, barriers[i].signal_mask);
+        }
+      }
+      api_cmd.pop_label();
+    }
+#else
+    for (uint32_t i = first; i < last; i++) {
+      api_cmd.push_label(tasks[i]->get_name());
+      if (barriers.size() > i && sync2) {
+        write_barrier2(barriers[i], cmd);
+      } else if (barriers.size() > i) {
+        write_barrier(barriers[i], cmd);
+      }
+
+      set_attachment_ops(frame, api_cmd, usages, i, first, last);
+      profiler.write_begin(cmd, i);
+      res.begin_task();
+      tasks[i]->write_commands(res, api_cmd);
+      api_cmd.end_renderpass(); //to be sure about barriers
+      profiler.write_end(cmd, i);
+      api_cmd.pop_label();
+    }
+#endif
+    api_cmd.keep_renderpass(false);
+    api_cmd.pop_label();
+  }
+
+  void RenderGraph::set_attachment_ops(const FrameTasks &frame, gpu::CmdContext &cmd, std::vector<gpu::AttachmentUsage> &usages, uint32_t task, uint32_t first, uint32_t last) {
+    const auto &plan = frame.renderpasses;
+    if (task >= plan.tasks.size()) {
+      cmd.keep_renderpass(false);
+      return;
+    }
+
+    const auto &renderpass = plan.tasks[task];
+    cmd.keep_renderpass(renderpass.merge_with_next && task + 1 < last);
+
+    //ops of the open render pass
+    if (task > first && plan.tasks[task - 1].merge_with_next) {
+      return;
+    }
+
+    //render pass split between recorders loads and stores content at the cut
+    bool split_begin = task > 0 && plan.tasks[task - 1].merge_with_next;
+    uint32_t group_last = task;
+    while (group_last + 1 < plan.tasks.size() && plan.tasks[group_last].merge_with_next) {
+      group_last++;
+    }
+    bool split_end = group_last >= last;
+
+    usages.clear();
+    for (uint32_t i = 0; i < renderpass.attachments_count; i++) {
+      const auto &attachment = plan.attachments[renderpass.first_attachment + i];
+      auto ops = attachment.ops;
+      if (split_begin) {
+        ops.load = VK_ATTACHMENT_LOAD_OP_LOAD;
+      }
+      if (split_end) {
+        ops.store = VK_ATTACHMENT_STORE_OP_STORE;
+      }
+      usages.push_back(gpu::AttachmentUsage {resources.get_driver_id(attachment.id.id), attachment.id.mip, attachment.id.layer, ops});
+    }
+    cmd.set_attachment_ops(usages);
+  }
+
+  void RenderGraph::draw_profiler_ui() const {
+    profiler.draw_ui();
+
+    const auto &stats = get_renderpass_stats();
+    ImGui::Begin("GPU profiler");
+    ImGui::Text("Render passes %u, merged tasks %u", stats.renderpasses, stats.merged_tasks);
+    ImGui::Text("Attachment traffic avoided: load %.2f MB, store %.2f MB",
+      stats.load_bytes_avoided/double(1 << 20), stats.store_bytes_avoided/double(1 << 20));
+    ImGui::End();
+  }
+
+  void RenderGraph::set_recording_threads(uint32_t count) {
+    finish_frame(); //workers are used by the render thread
+    count = std::max(count, 1u);
+
+    if (count == 1) {
+      workers.reset();
+    } else if (!workers || workers->get_threads_count() != count - 1) {
+      workers.reset(new gpu::WorkerPool {count - 1});
+    }
+  }
+
+  void RenderGraph::export_next_frame(const std::string &json_path, const std::string &dot_path) {
+    export_json_path = json_path;
+    export_dot_path = dot_path;
+    tracking_state.request_inputs();
+  }
+
+  void RenderGraph::export_frame(const FrameTasks &frame) {
+    GraphDump dump {};
+    if (!tracking_state.take_inputs(dump.inputs)) {
+      return;
+    }
+
+    for (auto task : frame.tasks) {
+      dump.tasks.push_back(task->get_name());
+    }
+    dump.task_queues = frame.task_queues;
+    dump.culled_tasks = culled_task_names;
+    dump.barriers = frame.barriers;
+    dump.use_events = RENDERGRAPH_USE_EVENTS;
+
+    auto write_file = [&](const std::string &path, void (*writer)(std::ostream &, const GraphDump &)) {
+      if (path.empty()) {
+        return;
+      }
+      std::ofstream file {path};
+      if (!file) {
+        throw std::runtime_error {"Can't open " + path};
+      }
+      writer(file, dump);
+    };
+
+    auto json_path = std::move(export_json_path);
+    auto dot_path = std::move(export_dot_path);
+    export_json_path.clear();
+    export_dot_path.clear();
+
+    write_file(json_path, write_graph_json);
+    write_file(dot_path, write_graph_dot);
+  }
+
+  void RenderGraph::dump_culled_tasks() {
+    //plan is usually the same for many frames
+    if (culled_task_names == printed_culled_names) {
+      return;
+    }
+    printed_culled_names = culled_task_names;
+
+    if (culled_task_names.empty()) {
+      std::cout << "Culled tasks: none\n";
+      return;
+    }
+
+    std::cout << "Culled tasks\n";
+    for (const auto &name : culled_task_names) {
+      std::cout << " - " << name << "\n";
+    }
+  }
+
+  void RenderGraph::dump_async_tasks(const FrameTasks &frame) {
+    if (async_task_names.empty()) {
+      return;
+    }
+
+    std::cout << "Async compute tasks (" << frame.submit_batches.size() << " batches)\n";
+    for (const auto &name : async_task_names) {
+      std::cout << " - " << name << "\n";
+    }
+  }
+
   void RenderGraph::write_barrier(const Barrier &barrier, VkCommandBuffer cmd) {
     if (barrier.is_empty()) {
       return;
@@ -387,7 +912,7 @@ namespace rendergraph {
       auto &image = resources.get_image(state.id.id);
       const auto &desc = resources.get_info(state.id.id);
       
-      if (state.id.mip >= desc.mipLevels || state.id.layer >= desc.arrayLayers) {
+      if (state.id.mip + state.mip_count > desc.mipLevels || state.id.layer + state.layer_count > desc.arrayLayers) {
         throw std::runtime_error {"Image subresource out of range"};
       }
       
@@ -404,7 +929,7 @@ namespace rendergraph {
         VK_QUEUE_FAMILY_IGNORED,
         VK_QUEUE_FAMILY_IGNORED,
         image->api_image(),
-        {image->get_full_aspect(), state.id.mip, 1, state.id.layer, 1}
+        {image->get_full_aspect(), state.id.mip, state.mip_count, state.id.layer, state.layer_count}
       };
       image_barriers.push_back(img_barrier);
     }
@@ -454,7 +979,7 @@ namespace rendergraph {
       auto &image = resources.get_image(state.id.id);
       const auto &desc = resources.get_info(state.id.id);
       
-      if (state.id.mip >= desc.mipLevels || state.id.layer >= desc.arrayLayers) {
+      if (state.id.mip + state.mip_count > desc.mipLevels || state.id.layer + state.layer_count > desc.arrayLayers) {
         throw std::runtime_error {"Image subresource out of range"};
       }
       
@@ -471,7 +996,7 @@ namespace rendergraph {
         VK_QUEUE_FAMILY_IGNORED,
         VK_QUEUE_FAMILY_IGNORED,
         image->api_image(),
-        {image->get_full_aspect(), state.id.mip, 1, state.id.layer, 1}
+        {image->get_full_aspect(), state.id.mip, state.mip_count, state.id.layer, state.layer_count}
       };
       
       image_barriers.push_back(img_barrier);
@@ -548,7 +1073,7 @@ namespace rendergraph {
       auto &image = resources.get_image(state.id.id);
       const auto &desc = resources.get_info(state.id.id);
       
-      if (state.id.mip >= desc.mipLevels || state.id.layer >= desc.arrayLayers) {
+      if (state.id.mip + state.mip_count > desc.mipLevels || state.id.layer + state.layer_count > desc.arrayLayers) {
         throw std::runtime_error {"Image subresource out of range"};
       }
       
@@ -565,7 +1090,7 @@ namespace rendergraph {
         VK_QUEUE_FAMILY_IGNORED,
         VK_QUEUE_FAMILY_IGNORED,
         image->api_image(),
-        {image->get_full_aspect(), state.id.mip, 1, state.id.layer, 1}
+        {image->get_full_aspect(), state.id.mip, state.mip_count, state.id.layer, state.layer_count}
       };
       
       image_barriers.push_back(img_barrier);
@@ -634,15 +1159,166 @@ namespace rendergraph {
       image_barriers.data());
   }
 
+  VkDependencyInfoKHR RenderGraph::DependencyInfo2::get_info() const {
+    return VkDependencyInfoKHR {
+      .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR,
+      .pNext = nullptr,
+      .dependencyFlags = 0,
+      .memoryBarrierCount = (uint32_t)mem_barriers.size(),
+      .pMemoryBarriers = mem_barriers.data(),
+      .bufferMemoryBarrierCount = 0,
+      .pBufferMemoryBarriers = nullptr,
+      .imageMemoryBarrierCount = (uint32_t)image_barriers.size(),
+      .pImageMemoryBarriers = image_barriers.data()
+    };
+  }
+
+  void RenderGraph::find_event_waiters(FrameTasks &frame) {
+    const auto &barriers = frame.barriers;
+    auto &event_waiters = frame.event_waiters;
+    event_waiters.clear();
+    event_waiters.resize(barriers.size(), INVALID_BARRIER_INDEX);
+
+    //the same rule as TrackingState::gen_event_sync, every task is released by one barrier
+    for (uint32_t index = 1; index < barriers.size(); index++) {
+      const auto &barrier = barriers[index];
+      if (barrier.max_wait_task_index == index - 1) {
+        continue;
+      }
+      for (auto task_id : barrier.wait_tasks) {
+        event_waiters.at(task_id) = index;
+      }
+    }
+  }
+
+  void RenderGraph::build_dependency2(const Barrier &barrier, uint32_t wait_for, DependencyInfo2 &out) {
+    for (const auto &state : barrier.image_barriers) {
+      if (wait_for != INVALID_BARRIER_INDEX && state.wait_for != wait_for) {
+        continue;
+      }
+
+      auto &image = resources.get_image(state.id.id);
+      const auto &desc = resources.get_info(state.id.id);
+      
+      if (state.id.mip + state.mip_count > desc.mipLevels || state.id.layer + state.layer_count > desc.arrayLayers) {
+        throw std::runtime_error {"Image subresource out of range"};
+      }
+
+      VkImageMemoryBarrier2KHR img_barrier {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR,
+        .pNext = nullptr,
+        .srcStageMask = state.src.stages? VkPipelineStageFlags2KHR(state.src.stages) : VK_PIPELINE_STAGE_2_NONE_KHR,
+        .srcAccessMask = state.src.access,
+        .dstStageMask = state.dst.stages,
+        .dstAccessMask = state.dst.access,
+        .oldLayout = state.src.layout,
+        .newLayout = state.dst.layout,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = image->api_image(),
+        .subresourceRange = {image->get_full_aspect(), state.id.mip, state.mip_count, state.id.layer, state.layer_count}
+      };
+      out.image_barriers.push_back(img_barrier);
+    }
+
+    for (const auto &state : barrier.buffer_barriers) {
+      if (wait_for != INVALID_BARRIER_INDEX && state.wait_for != wait_for) {
+        continue;
+      }
+
+      VkMemoryBarrier2KHR mem_barrier {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2_KHR,
+        .pNext = nullptr,
+        .srcStageMask = state.src.stages? VkPipelineStageFlags2KHR(state.src.stages) : VK_PIPELINE_STAGE_2_NONE_KHR,
+        .srcAccessMask = state.src.access,
+        .dstStageMask = state.dst.stages,
+        .dstAccessMask = state.dst.access
+      };
+      out.mem_barriers.push_back(mem_barrier);
+    }
+  }
+
+  void RenderGraph::write_barrier2(const Barrier &barrier, VkCommandBuffer cmd) {
+    if (barrier.is_empty()) {
+      return;
+    }
+
+    DependencyInfo2 dependency;
+    build_dependency2(barrier, INVALID_BARRIER_INDEX, dependency);
+    auto info = dependency.get_info();
+    vkCmdPipelineBarrier2KHR(cmd, &info);
+  }
+
+  void RenderGraph::signal_event2(const FrameTasks &frame, uint32_t task, VkCommandBuffer cmd) {
+    const auto &barriers = frame.barriers;
+    auto waiter = frame.event_waiters.at(task);
+    if (waiter == INVALID_BARRIER_INDEX) {
+      throw std::runtime_error {"Signaled event has no waiter"};
+    }
+    //dependency info must be identical to the one passed to vkCmdWaitEvents2KHR
+    DependencyInfo2 dependency;
+    build_dependency2(barriers.at(waiter), task, dependency);
+    auto info = dependency.get_info();
+    vkCmdSetEvent2KHR(cmd, barriers[task].release_event, &info);
+  }
+
+  void RenderGraph::resolve_barrier2(const std::vector<Barrier> &barriers, uint32_t index, VkCommandBuffer cmd) {
+    auto &barrier = barriers[index];
+    if (barrier.is_empty()) {
+      return;
+    }
+
+    if (index == 0 || barrier.max_wait_task_index == index - 1 || barrier.wait_tasks.empty()) {
+      write_barrier2(barrier, cmd);
+      return;
+    }
+
+    //storage must not move while infos point into it
+    std::vector<DependencyInfo2> dependencies {barrier.wait_tasks.size()};
+    std::vector<VkDependencyInfoKHR> infos;
+    std::vector<VkEvent> events;
+    
+    uint32_t dep_index = 0;
+    for (auto task_id : barrier.wait_tasks) {
+      auto &src_barrier = barriers[task_id];
+      if (!src_barrier.release_event) {
+        throw std::runtime_error {"Event is not created!"};
+      }
+
+      auto &dependency = dependencies[dep_index++];
+      build_dependency2(barrier, task_id, dependency);
+      infos.push_back(dependency.get_info());
+      events.push_back(src_barrier.release_event);
+    }
+
+    vkCmdWaitEvents2KHR(cmd, events.size(), events.data(), infos.data());
+  }
+
+  void RenderResources::track_resource(const gpu::DriverResourceID &id) {
+    if (std::find(used_resources.begin(), used_resources.end(), id) == used_resources.end()) {
+      used_resources.push_back(id);
+    }
+  }
+
   gpu::BufferPtr &RenderResources::get_buffer(BufferResourceId id) {
+    track_resource(resources.get_driver_id(id));
     return resources.get_buffer(id);
   }
   
   gpu::ImagePtr &RenderResources::get_image(ImageResourceId id) {
+    track_resource(resources.get_driver_id(id));
     return resources.get_image(id);
   }
   
   VkImageView RenderResources::get_view(const ImageViewId &ref) {
     return get_image(ref.get_id())->get_view(ref.get_range());
   }
+
+  uint32_t RenderResources::get_sampled_index(const ImageViewId &ref) {
+    return get_image(ref.get_id())->get_sampled_index(ref.get_range());
+  }
+
+  uint32_t RenderResources::get_storage_index(const ImageViewId &ref) {
+    return get_image(ref.get_id())->get_storage_index(ref.get_range());
+  }
 }
\ No newline at end of file
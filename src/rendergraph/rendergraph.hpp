@@ -3,10 +3,16 @@
 
 #include <cinttypes>
 #include <unordered_map>
+#include <string_view>
+#include <type_traits>
 
 #include "resources.hpp"
 #include "gpu_ctx.hpp"
+#include "task_arena.hpp"
+#include "gpu_profiler.hpp"
+#include "graph_dump.hpp"
 #include "gpu/descriptors.hpp"
+#include "gpu/worker_pool.hpp"
 
 #define RENDERGRAPH_DEBUG 0
 #define RENDERGRAPH_USE_EVENTS 1
@@ -23,8 +29,8 @@ namespace rendergraph {
     
     ImageViewId use_color_attachment(ImageResourceId id, uint32_t mip, uint32_t layer);
     ImageViewId use_depth_attachment(ImageResourceId id, uint32_t mip, uint32_t layer);
-    ImageViewId use_storage_image(ImageResourceId id, VkShaderStageFlags stages, uint32_t mip, uint32_t layer);
-    ImageViewId use_storage_image_array(ImageResourceId id, VkShaderStageFlags stages);
+    ImageViewId use_storage_image(ImageResourceId id, VkShaderStageFlags stages, uint32_t mip, uint32_t layer, bool readonly = false);
+    ImageViewId use_storage_image_array(ImageResourceId id, VkShaderStageFlags stages, bool readonly = false);
 
     ImageViewId sample_image(ImageResourceId id, VkShaderStageFlags stages, VkImageAspectFlags aspect, uint32_t base_mip, uint32_t mip_count, uint32_t base_layer, uint32_t layer_count);
     ImageViewId sample_image(ImageResourceId id, VkShaderStageFlags stages, VkImageAspectFlags aspect = 0);
@@ -38,6 +44,9 @@ namespace rendergraph {
     void transfer_write(ImageResourceId id, uint32_t base_mip, uint32_t mip_count, uint32_t base_layer, uint32_t layer_count);
     void transfer_write(BufferResourceId id);
 
+    //task may run on async compute queue, it must not use attachments
+    void use_async_compute() { async_compute = true; }
+
     gpu::ImageInfo get_image_info(ImageResourceId id);
 
     uint32_t get_frames_count() const { return gpu.get_frames_count(); }
@@ -50,27 +59,71 @@ namespace rendergraph {
     ImageResourceId backbuffer;
 
     bool present_backbuffer = false;
+    bool async_compute = false;
+    bool uses_attachments = false;
 
     friend struct RenderGraph;
   };
 
   struct RenderResources {
-    RenderResources(GraphResources &res, GpuState &state) : resources {res}, gpu {state} {}
+    RenderResources(GraphResources &res, GpuState &state, uint32_t recorder = 0)
+      : resources {res}, gpu {state}, desc_pool {state.get_desc_pool(recorder)}, desc_cache {state.get_desc_cache(recorder)} {}
 
     gpu::BufferPtr &get_buffer(BufferResourceId id);
     gpu::ImagePtr &get_image(ImageResourceId id);
     VkImageView get_view(const ImageViewId &ref);
+    //indices of the view in the bindless heap
+    uint32_t get_sampled_index(const ImageViewId &ref);
+    uint32_t get_storage_index(const ImageViewId &ref);
 
     std::pair<gpu::DriverResourceID, gpu::ImageViewRange> get_image_range(const ImageViewId &ref) const {
       return {resources.get_driver_id(ref.get_id()), ref.get_range()};
     }
 
-    VkDescriptorSet allocate_set(VkDescriptorSetLayout layout) { return gpu.allocate_set(layout); }
-    VkDescriptorSet allocate_set(VkDescriptorSetLayout layout, const std::vector<uint32_t> &sizes) { return gpu.allocate_set(layout, sizes); }
-    VkDescriptorSet allocate_set(const gpu::GraphicsPipeline &p, uint32_t index) { return gpu.allocate_set(p.get_layout(index)); }
-    VkDescriptorSet allocate_set(const gpu::ComputePipeline &p, uint32_t index) { return gpu.allocate_set(p.get_layout(index)); }
-    VkDescriptorSet allocate_set(const gpu::GraphicsPipeline &p, uint32_t index, const std::vector<uint32_t> &sizes) { return gpu.allocate_set(p.get_layout(index), sizes); }
-    VkDescriptorSet allocate_set(const gpu::ComputePipeline &p, uint32_t index, const std::vector<uint32_t> &sizes) { return gpu.allocate_set(p.get_layout(index), sizes); }
+    VkDescriptorSet allocate_set(VkDescriptorSetLayout layout) { return desc_pool.allocate_set(layout); }
+    VkDescriptorSet allocate_set(VkDescriptorSetLayout layout, const std::vector<uint32_t> &sizes) { return desc_pool.allocate_set(layout, sizes); }
+    VkDescriptorSet allocate_set(const gpu::GraphicsPipeline &p, uint32_t index) { return desc_pool.allocate_set(p.get_layout(index)); }
+    VkDescriptorSet allocate_set(const gpu::ComputePipeline &p, uint32_t index) { return desc_pool.allocate_set(p.get_layout(index)); }
+    VkDescriptorSet allocate_set(const gpu::GraphicsPipeline &p, uint32_t index, const std::vector<uint32_t> &sizes) { return desc_pool.allocate_set(p.get_layout(index), sizes); }
+    VkDescriptorSet allocate_set(const gpu::ComputePipeline &p, uint32_t index, const std::vector<uint32_t> &sizes) { return desc_pool.allocate_set(p.get_layout(index), sizes); }
+
+    //written once and reused by later frames while bindings are the same. Images and buffers taken from
+    //this object since the task start are tracked, the set is dropped when one of them is destroyed.
+    //Other handles in bindings must be long-lived
+    template <typename... Bindings>
+    VkDescriptorSet get_cached_set(VkDescriptorSetLayout layout, const Bindings&... bindings) {
+      return desc_cache.get_set(layout, used_resources, bindings...);
+    }
+
+    template <typename... Bindings>
+    VkDescriptorSet get_cached_set(const gpu::GraphicsPipeline &p, uint32_t index, const Bindings&... bindings) {
+      return desc_cache.get_set(p.get_layout(index), used_resources, bindings...);
+    }
+
+    template <typename... Bindings>
+    VkDescriptorSet get_cached_set(const gpu::ComputePipeline &p, uint32_t index, const Bindings&... bindings) {
+      return desc_cache.get_set(p.get_layout(index), used_resources, bindings...);
+    }
+
+    //pushed when the set has a push descriptor layout, otherwise taken from the set cache and bound.
+    //offsets are dynamic offsets of the set in binding order
+    template <typename... Bindings>
+    void bind_set(gpu::CmdContext &cmd, const gpu::GraphicsPipeline &p, uint32_t index, const std::initializer_list<uint32_t> &offsets, const Bindings&... bindings) {
+      if (p.is_push_descriptor(index)) {
+        cmd.push_descriptors_graphics(index, offsets, bindings...);
+        return;
+      }
+      cmd.bind_descriptors_graphics(index, {get_cached_set(p, index, bindings...)}, offsets);
+    }
+
+    template <typename... Bindings>
+    void bind_set(gpu::CmdContext &cmd, const gpu::ComputePipeline &p, uint32_t index, const std::initializer_list<uint32_t> &offsets, const Bindings&... bindings) {
+      if (p.is_push_descriptor(index)) {
+        cmd.push_descriptors_compute(index, offsets, bindings...);
+        return;
+      }
+      cmd.bind_descriptors_compute(index, {get_cached_set(p, index, bindings...)}, offsets);
+    }
 
     uint32_t get_frames_count() const { return gpu.get_frames_count(); }
     uint32_t get_backbuffers_count() const { return gpu.get_backbuffers_count();}
@@ -80,57 +133,98 @@ namespace rendergraph {
   private:
     GraphResources &resources;
     GpuState &gpu;
+    gpu::DescriptorPool &desc_pool;
+    gpu::DescriptorSetCache &desc_cache;
+    std::vector<gpu::DriverResourceID> used_resources;
+
+    void begin_task() { used_resources.clear(); }
+    void track_resource(const gpu::DriverResourceID &id);
+
+    friend struct RenderGraph;
   };
 
+  //tasks live in the frame arena, name points to arena memory too
   struct BaseTask {
-    BaseTask(const std::string &task_name) : name {task_name} {}
+    BaseTask(const char *task_name) : name {task_name} {}
     virtual void write_commands(RenderResources &, gpu::CmdContext &) = 0;
     virtual ~BaseTask() {}
 
-    const std::string &get_name() const { return name; }
-    std::string name;
+    const char *get_name() const { return name; }
+    const char *name;
+    bool async_compute = false;
   };
 
-  template <typename TaskData>
-  using TaskRunCB = std::function<void (TaskData &, RenderResources &, gpu::CmdContext &)>;
-
-  template <typename TaskData>
-  using TaskCreateCB = std::function<void (TaskData &, RenderGraphBuilder &)>;
-
-  template <typename TaskData>
+  //callback is stored by value, lambda captures don't go through std::function
+  template <typename TaskData, typename RunCB>
   struct Task : BaseTask {
-    Task(const std::string &name) : BaseTask {name} {}
+    Task(const char *name, RunCB &&cb) : BaseTask {name}, data {}, callback {std::move(cb)} {}
+    Task(const char *name, const RunCB &cb) : BaseTask {name}, data {}, callback {cb} {}
 
     TaskData data;
-    TaskRunCB<TaskData> callback;
+    RunCB callback;
 
     void write_commands(RenderResources &resources, gpu::CmdContext &cmd) override {
       callback(data, resources, cmd);
     }
   };
 
+  struct TaskAllocStats {
+    uint64_t frame_heap_allocations = 0; //heap allocations made to store tasks of the last submitted frame
+    uint64_t total_heap_allocations = 0;
+    uint64_t frame_arena_bytes = 0;
+    uint64_t arena_reserved_bytes = 0;
+  };
+
+  //image with copies from previous frames
+  struct HistoryImageId {
+    HistoryImageId() {}
+    uint32_t get_index() const { return index; }
+
+  private:
+    uint32_t index = INVALID_BARRIER_INDEX;
+    friend struct RenderGraph;
+  };
+
+  //splits tasks into batches of consecutive tasks on one queue, one recorder per batch. Task waits for a batch
+  //from another queue through a semaphore, the last main queue batch waits for async work
+  void build_submit_batches(const std::vector<QueueType> &task_queues, const std::vector<std::vector<uint32_t>> &dependencies,
+    std::vector<std::pair<uint32_t, uint32_t>> &record_ranges, std::vector<SubmitBatch> &submit_batches);
+
   struct RenderGraph {
     RenderGraph(gpu::Device &device, gpu::Swapchain &swapchain);
+    //barriers and schedule are planned on submit, but nothing is recorded or sent to gpu
+    explicit RenderGraph(const HeadlessConfig &config);
     ~RenderGraph();
 
-    template <typename TaskData>
-    void add_task(const std::string &name, TaskCreateCB<TaskData> create_cb, TaskRunCB<TaskData> run_cb) {
+    template <typename TaskData, typename CreateCB, typename RunCB>
+    void add_task(std::string_view name, CreateCB &&create_cb, RunCB &&run_cb) {
+      using TaskType = Task<TaskData, std::decay_t<RunCB>>;
       RenderGraphBuilder builder {resources, gpu, tracking_state, get_backbuffer()};
+      auto &frame = frames[build_frame];
       
-      std::unique_ptr<Task<TaskData>> ptr {new Task<TaskData> {name}};
+      if (frame.tasks.size() == frame.tasks.capacity()) {
+        task_list_allocations++;
+      }
+      auto ptr = frame.arena.create<TaskType>(frame.arena.copy_string(name), std::forward<RunCB>(run_cb));
+      frame.tasks.push_back(ptr);
+
       create_cb(ptr->data, builder);
-      ptr->callback = run_cb;
-      tasks.push_back(std::move(ptr));
+      if (builder.async_compute && builder.uses_attachments) {
+        throw std::runtime_error {"Async compute task " + std::string {name} + " uses attachments"};
+      }
+      ptr->async_compute = builder.async_compute;
       
-      present_backbuffer |= builder.present_backbuffer;
+      frame.present_backbuffer |= builder.present_backbuffer;
 
-      tracking_state.next_task();
+      tracking_state.next_task(name);
     }
 
     void submit();
 
     uint32_t get_frames_count() const { return gpu.get_frames_count(); }
-    uint32_t get_frame_index() const { return gpu.get_frame_index(); }
+    //gpu frame slot of the frame being built
+    uint32_t get_frame_index() const { return frame_index; }
+    bool is_headless() const { return gpu.is_headless(); }
     
     ImageResourceId create_image(VkImageType type, const gpu::ImageInfo &info, VkImageTiling tiling, VkImageUsageFlags usage, gpu::ImageCreateOptions options = gpu::ImageCreateOptions::None);
     ImageResourceId create_image(const ImageDescriptor &desc, gpu::ImageCreateOptions options = gpu::ImageCreateOptions::None);
@@ -141,18 +235,169 @@ namespace rendergraph {
 
     void remap(ImageResourceId src, ImageResourceId dst);
 
+    //depth previous frames are kept. Content is rotated at submit, so ids of current and
+    //previous images stay the same and their tracking state follows the content
+    HistoryImageId create_history_image(const ImageDescriptor &desc, uint32_t depth = 1, gpu::ImageCreateOptions options = gpu::ImageCreateOptions::None);
+    HistoryImageId create_history_image(VkImageType type, const gpu::ImageInfo &info, VkImageTiling tiling, VkImageUsageFlags usage, uint32_t depth = 1);
+    ImageResourceId get_current(HistoryImageId id) const { return history_images.at(id.index).images.at(0); }
+    ImageResourceId get_previous(HistoryImageId id, uint32_t age = 1) const { return history_images.at(id.index).images.at(age); }
+    //previous image of this age was written by an earlier frame
+    bool has_history(HistoryImageId id, uint32_t age = 1) const { return age <= history_images.at(id.index).valid_frames; }
+    //previous content is dropped by the next layout transition, no clear is needed after resize or camera cut
+    void invalidate_history(HistoryImageId id);
+    
+    //transient images share memory when their lifetimes in frame don't overlap. Images which first
+    //access in frame reads and writes previous content must be marked persistent
+    void mark_persistent(ImageResourceId id) { resources.mark_persistent(id); }
+    void enable_aliasing(bool enable) { resources.enable_aliasing(enable); }
+    const AliasingStats &get_aliasing_stats() const { return resources.get_aliasing_stats(); }
+    const GraphCacheStats &get_cache_stats() const { return tracking_state.get_cache_stats(); }
+    
+    //drop tasks which writes are not consumed by backbuffer, readbacks, buffers or persistent images.
+    //print_culled writes names of culled tasks when the culled set changes
+    void enable_culling(bool enable, bool print_culled = false) { tracking_state.enable_culling(enable); print_culled_tasks = enable && print_culled; }
+    //reads of undefined or stale image content, unread writes and read-only storage images are reported
+    //when the graph is compiled. New warnings are printed once
+    void enable_validation(bool enable) { tracking_state.enable_validation(enable); }
+    const std::vector<std::string> &get_validation_warnings() const { return tracking_state.get_validation_warnings(); }
+    //images consumed outside of the graph
+    void export_image(ImageResourceId id) { resources.mark_persistent(id); }
+
+    //record tasks on several threads, each thread fills own command buffer with a contiguous range of tasks.
+    //Task callbacks must not share mutable state. 1 - record on the submitting thread
+    void set_recording_threads(uint32_t count);
+    uint32_t get_recording_threads() const { return workers? (workers->get_threads_count() + 1) : 1; }
+
+    //submit hands recording and queue submission to the render thread, so building and compile of the next
+    //frame overlap them. Run callbacks of frame N run concurrently with create callbacks of frame N+1.
+    //History rotation of frame N is applied to tracking state before compile of frame N+1 and to driver images
+    //after frame N is recorded. Aliasing re-plan waits for the recorded frame before compile.
+    //Shader reload and gpu::collect_resources destroy objects used by recording, call wait_recording before them
+    void enable_pipelining(bool enable);
+    bool is_pipelined() const { return render_thread != nullptr; }
+    //returns when the submitted frame is recorded and sent to the queue, nothing to wait without pipelining
+    void wait_recording() { finish_frame(); }
+
+    //tasks marked with use_async_compute() go to the second queue if device has one
+    void enable_async_compute(bool enable) { async_compute_enabled = enable; }
+    //tasks which were sent to async compute queue in the last frame
+    const std::vector<std::string> &get_async_tasks() const { return async_task_names; }
+
+    //tasks and their data are placed in arena which is reset after submit
+    const TaskAllocStats &get_task_alloc_stats() const { return task_alloc_stats; }
+    //sets requested by RenderResources::get_cached_set
+    gpu::DescriptorCacheStats get_desc_cache_stats() const { return gpu.get_desc_cache_stats(); }
+    //per-frame descriptor pools of recorders, high-water marks are summed over recorders
+    gpu::DescriptorPoolStats get_desc_pool_stats() const { return gpu.get_desc_pool_stats(); }
+
+    //timestamps around each task, results are a few frames late
+    void enable_profiler(bool enable) { profiler.enable(enable); }
+    const std::vector<TaskTiming> &get_task_timings() const { return profiler.get_timings(); }
+    float get_gpu_frame_ms() const { return profiler.get_frame_ms(); }
+    void draw_profiler_ui() const;
+
+    //the next submitted frame is compiled from scratch and written as JSON and Graphviz DOT,
+    //empty path skips the format. Files are written by submit
+    void export_next_frame(const std::string &json_path, const std::string &dot_path = {});
+
+    //render passes of the last submitted frame, attachment ops are inferred from the frame accesses
+    const RenderpassStats &get_renderpass_stats() const { return tracking_state.get_renderpasses().stats; }
+
+    //record barriers with VK_KHR_synchronization2, ignored if device doesn't support it
+    void enable_synchronization2(bool enable) { synchronization2_enabled = enable; }
+    bool uses_synchronization2() const { return synchronization2_enabled && gpu.has_synchronization2(); }
+
   private:
     GpuState gpu;
     GraphResources resources;
     TrackingState tracking_state;
-    bool present_backbuffer = false;
 
-    std::vector<std::unique_ptr<BaseTask>> tasks;
+    //tasks of one frame and the plan to record them. One slot is built while the other is recorded
+    struct FrameTasks {
+      TaskArena arena;
+      std::vector<BaseTask*> tasks;
+      bool present_backbuffer = false;
+
+      std::vector<Barrier> barriers;
+      RenderpassPlan renderpasses;
+      //empty if all tasks are on the main queue
+      std::vector<QueueType> task_queues;
+      //tasks range of each recorder
+      std::vector<std::pair<uint32_t, uint32_t>> record_ranges;
+      std::vector<SubmitBatch> submit_batches;
+      //barrier which waits for event signaled by task
+      std::vector<uint32_t> event_waiters;
+      //backbuffer mapped to backbuffers[0] while frame is recorded
+      uint32_t backbuffer_index = 0;
+    };
+    FrameTasks frames[2];
+    uint32_t build_frame = 0;
+    //other slot is submitted, but not finished yet
+    bool frame_in_flight = false;
+    //tracking state of history images was rotated before compile, driver images are rotated by finish_frame
+    bool history_tracking_rotated = false;
+    uint32_t frame_index = 0;
+    std::unique_ptr<gpu::WorkerPool> render_thread;
+
+    uint64_t task_list_allocations = 0;
+    TaskAllocStats task_alloc_stats;
+    GpuProfiler profiler;
     std::vector<ImageResourceId> backbuffers;
 
+    struct HistoryImage {
+      std::vector<ImageResourceId> images; //0 - current frame
+      uint32_t valid_frames = 0;
+      bool discard_pending = false;
+    };
+    std::vector<HistoryImage> history_images;
+    std::vector<std::string> culled_task_names;
+    std::vector<std::string> printed_culled_names;
+    bool print_culled_tasks = false;
+    std::string export_json_path;
+    std::string export_dot_path;
+    std::unique_ptr<gpu::WorkerPool> workers;
+
+    bool async_compute_enabled = true;
+    std::vector<std::string> async_task_names;
+
+    bool synchronization2_enabled = false;
+
+    void remove_culled_tasks(FrameTasks &frame);
+    void release_tasks(FrameTasks &frame);
+    void rotate_history();
+    void discard_history();
+    void dump_culled_tasks();
+    void dump_async_tasks(const FrameTasks &frame);
+    void export_frame(const FrameTasks &frame);
+    void schedule_tasks(FrameTasks &frame, const std::vector<std::vector<uint32_t>> &dependencies);
+    //may run on the render thread, reads only the frame slot and resource mappings
+    void record_frame(FrameTasks &frame);
+    //waits for the submitted frame and applies its remaps on the calling thread
+    void finish_frame();
+    //applies remaps of the submitted frame to tracking state only, driver images are still used by the render thread
+    void begin_overlapped_compile();
+    void record_tasks(FrameTasks &frame, uint32_t first, uint32_t last, uint32_t recorder);
+    void set_attachment_ops(const FrameTasks &frame, gpu::CmdContext &cmd, std::vector<gpu::AttachmentUsage> &usages, uint32_t task, uint32_t first, uint32_t last);
+    bool waits_other_queue(const FrameTasks &frame, const Barrier &barrier, uint32_t index) const;
+
     void write_barrier(const Barrier &barrier, VkCommandBuffer cmd);
     void write_wait_events(const std::vector<Barrier> &barriers, const Barrier &barrier, VkCommandBuffer cmd);
     void resolve_barrier(const std::vector<Barrier> &barriers, uint32_t index, VkCommandBuffer cmd);
+
+    struct DependencyInfo2 {
+      std::vector<VkImageMemoryBarrier2KHR> image_barriers;
+      std::vector<VkMemoryBarrier2KHR> mem_barriers;
+
+      bool is_empty() const { return image_barriers.empty() && mem_barriers.empty(); }
+      VkDependencyInfoKHR get_info() const;
+    };
+
+    void find_event_waiters(FrameTasks &frame);
+    //wait_for == INVALID_BARRIER_INDEX takes all entries of barrier
+    void build_dependency2(const Barrier &barrier, uint32_t wait_for, DependencyInfo2 &out);
+    void write_barrier2(const Barrier &barrier, VkCommandBuffer cmd);
+    void signal_event2(const FrameTasks &frame, uint32_t task, VkCommandBuffer cmd);
+    void resolve_barrier2(const std::vector<Barrier> &barriers, uint32_t index, VkCommandBuffer cmd);
     //ImageResourceId get_backbuffer() const;
     friend struct RenderGraphBuilder;
   };
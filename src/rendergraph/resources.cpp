@@ -1,5 +1,6 @@
 #include "resources.hpp"
 
+#include <algorithm>
 #include <iostream>
 
 namespace rendergraph {
@@ -15,17 +16,17 @@ namespace rendergraph {
     }
   }
 
+  //whole image in one range
+  static std::vector<ImageTrackingRange> make_ranges(const VkImageCreateInfo &info) {
+    ImageTrackingRange range {};
+    range.mip_count = info.mipLevels;
+    range.layer_count = info.arrayLayers;
+    return {range};
+  }
+
   ImageResourceId GraphResources::create_global_image(const ImageDescriptor &desc, gpu::ImageCreateOptions options) {
     uint32_t image_index = global_images.size();
-    
-    uint32_t count = desc.array_layers * desc.mip_levels;
-    std::unique_ptr<ImageTrackingState[]> ptr;
-    ptr.reset(new ImageTrackingState[count]);
-
-    global_images.emplace_back(GlobalImage {
-      {}, 
-      std::move(ptr)
-    });
+    global_images.emplace_back(GlobalImage {});
 
     VkImageCreateInfo info {
       .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
@@ -45,7 +46,11 @@ namespace rendergraph {
       .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
     };
 
-    global_images.back().vk_image = gpu::create_driver_image(info); //create(desc.type, desc.get_vk_info(), desc.tiling, desc.usage, options);
+    global_images.back().info = info;
+    global_images.back().ranges = make_ranges(info);
+    if (!headless) {
+      global_images.back().vk_image = gpu::create_driver_image(info); //create(desc.type, desc.get_vk_info(), desc.tiling, desc.usage, options);
+    }
     
     ImageResourceId id {};
     id.index = image_index;
@@ -54,17 +59,12 @@ namespace rendergraph {
 
   ImageResourceId GraphResources::create_global_image_ref(const gpu::ImagePtr &image) {
     uint32_t image_index = global_images.size();
-
-    uint32_t count = image->get_array_layers() * image->get_mip_levels();
-    std::unique_ptr<ImageTrackingState[]> ptr;
-    ptr.reset(new ImageTrackingState[count]);
-
-    global_images.emplace_back(GlobalImage {
-      {}, 
-      std::move(ptr)
-    });
+    global_images.emplace_back(GlobalImage {});
 
     global_images.back().vk_image = gpu::create_image_ref(image->api_image(), image->get_info());// create_reference(image.get_image(), desc);
+    global_images.back().info = image->get_info();
+    global_images.back().ranges = make_ranges(image->get_info());
+    global_images.back().persistent = true;
     
     ImageResourceId id {};
     id.index = image_index;
@@ -79,7 +79,9 @@ namespace rendergraph {
       {}
     });
 
-    global_buffers.back().vk_buffer = gpu::create_buffer(desc.memory_type, desc.size, desc.usage);
+    if (!headless) {
+      global_buffers.back().vk_buffer = gpu::create_buffer(desc.memory_type, desc.size, desc.usage);
+    }
 
     BufferResourceId id {};
     id.index = buffer_index;
@@ -87,16 +89,43 @@ namespace rendergraph {
   }
   
   void GraphResources::remap(ImageResourceId src, ImageResourceId dst) {
+    mark_persistent(src);
+    mark_persistent(dst);
     std::swap(global_images.at(src.index), global_images.at(dst.index));
   }
   
+  void GraphResources::remap_tracking(ImageResourceId src, ImageResourceId dst) {
+    mark_persistent(src);
+    mark_persistent(dst);
+
+    auto &src_image = global_images.at(src.index);
+    auto &dst_image = global_images.at(dst.index);
+    std::swap(src_image.ranges, dst_image.ranges);
+    std::swap(src_image.persistent, dst_image.persistent);
+    std::swap(src_image.frame_lifetime, dst_image.frame_lifetime);
+    std::swap(src_image.observed_lifetime, dst_image.observed_lifetime);
+    pending_remaps.push_back({src.index, dst.index});
+  }
+
+  void GraphResources::apply_remaps() {
+    //memory of alias block is bound to the driver image
+    for (auto [src, dst] : pending_remaps) {
+      auto &src_image = global_images.at(src);
+      auto &dst_image = global_images.at(dst);
+      std::swap(src_image.vk_image, dst_image.vk_image);
+      std::swap(src_image.info, dst_image.info);
+      std::swap(src_image.alias_block, dst_image.alias_block);
+    }
+    pending_remaps.clear();
+  }
+
   void GraphResources::remap(BufferResourceId src, BufferResourceId dst) {
     //std::swap(buffer_remap.at(src.index), buffer_remap.at(dst.index));
     std::swap(global_buffers.at(src.index), global_buffers.at(dst.index));
   }
 
   const VkImageCreateInfo &GraphResources::get_info(ImageResourceId id) const {
-    return global_images.at(id.index).vk_image->get_info(); 
+    return global_images.at(id.index).info;
   }
 
   gpu::ImagePtr &GraphResources::get_image(ImageResourceId id) {
@@ -118,21 +147,132 @@ namespace rendergraph {
   }
   
   const ImageTrackingState &GraphResources::get_resource_state(ImageSubresourceId id) const {
-    auto &img = global_images.at(id.id.index); 
-    auto mip_count = img.vk_image->get_mip_levels(); 
-    return img.states[id.layer * mip_count + id.mip];
+    for (const auto &range : global_images.at(id.id.index).ranges) {
+      if (range.contains(id.mip, id.layer)) {
+        return range.state;
+      }
+    }
+    throw std::runtime_error {"Subresource is outside of image"};
   }
     
   BufferTrackingState &GraphResources::get_resource_state(BufferResourceId id) {
     //auto index = buffer_remap.at(id.index);
     return global_buffers.at(id.index).state;
   }
-  
-  ImageTrackingState &GraphResources::get_resource_state(ImageSubresourceId id) {
-    auto &img = global_images.at(id.id.index); 
-    auto mip_count = img.vk_image->get_mip_levels(); 
 
-    return img.states[id.layer * mip_count + id.mip];
+  static bool range_inside(const ImageTrackingRange &range, const ImageSubresourceId &base, uint32_t mip_count, uint32_t layer_count) {
+    return range.mip >= base.mip && range.mip + range.mip_count <= base.mip + mip_count
+      && range.layer >= base.layer && range.layer + range.layer_count <= base.layer + layer_count;
+  }
+
+  static bool range_overlaps(const ImageTrackingRange &range, const ImageSubresourceId &base, uint32_t mip_count, uint32_t layer_count) {
+    return range.mip < base.mip + mip_count && base.mip < range.mip + range.mip_count
+      && range.layer < base.layer + layer_count && base.layer < range.layer + range.layer_count;
+  }
+
+  void GraphResources::split_ranges(const ImageSubresourceId &base, uint32_t mip_count, uint32_t layer_count) {
+    auto &ranges = get_ranges(base.id);
+    const uint32_t mip_end = base.mip + mip_count;
+    const uint32_t layer_end = base.layer + layer_count;
+
+    //parts outside of the rect are appended, intersection stays in place
+    for (uint32_t i = 0; i < ranges.size(); i++) {
+      auto range = ranges[i];
+      if (!range_overlaps(range, base, mip_count, layer_count) || range_inside(range, base, mip_count, layer_count)) {
+        continue;
+      }
+
+      if (range.layer < base.layer) {
+        auto part = range;
+        part.layer_count = base.layer - range.layer;
+        ranges.push_back(part);
+        range.layer_count -= part.layer_count;
+        range.layer = base.layer;
+      }
+
+      if (range.layer + range.layer_count > layer_end) {
+        auto part = range;
+        part.layer = layer_end;
+        part.layer_count = range.layer + range.layer_count - layer_end;
+        ranges.push_back(part);
+        range.layer_count -= part.layer_count;
+      }
+
+      if (range.mip < base.mip) {
+        auto part = range;
+        part.mip_count = base.mip - range.mip;
+        ranges.push_back(part);
+        range.mip_count -= part.mip_count;
+        range.mip = base.mip;
+      }
+
+      if (range.mip + range.mip_count > mip_end) {
+        auto part = range;
+        part.mip = mip_end;
+        part.mip_count = range.mip + range.mip_count - mip_end;
+        ranges.push_back(part);
+        range.mip_count -= part.mip_count;
+      }
+
+      ranges[i] = range;
+    }
+  }
+
+  static bool equal_states(const ImageSubresourceState &a, const ImageSubresourceState &b) {
+    return a.stages == b.stages && a.access == b.access && a.layout == b.layout;
+  }
+
+  static bool equal_states(const ImageTrackingState &a, const ImageTrackingState &b) {
+    return a.barrier_id == b.barrier_id && a.last_access == b.last_access && a.wait_for == b.wait_for
+      && equal_states(a.src, b.src) && equal_states(a.dst, b.dst);
+  }
+
+  //joins r into l if they form a rect
+  static bool join_ranges(ImageTrackingRange &l, const ImageTrackingRange &r) {
+    if (l.layer == r.layer && l.layer_count == r.layer_count) {
+      if (l.mip + l.mip_count == r.mip || r.mip + r.mip_count == l.mip) {
+        l.mip = std::min(l.mip, r.mip);
+        l.mip_count += r.mip_count;
+        return true;
+      }
+    }
+
+    if (l.mip == r.mip && l.mip_count == r.mip_count) {
+      if (l.layer + l.layer_count == r.layer || r.layer + r.layer_count == l.layer) {
+        l.layer = std::min(l.layer, r.layer);
+        l.layer_count += r.layer_count;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void GraphResources::merge_ranges(ImageResourceId id) {
+    auto &ranges = get_ranges(id);
+    bool merged = true;
+    
+    while (merged && ranges.size() > 1) {
+      merged = false;
+      for (uint32_t i = 0; i < ranges.size() && !merged; i++) {
+        for (uint32_t j = i + 1; j < ranges.size(); j++) {
+          if (equal_states(ranges[i].state, ranges[j].state) && join_ranges(ranges[i], ranges[j])) {
+            ranges.erase(ranges.begin() + j);
+            merged = true;
+            break;
+          }
+        }
+      }
+    }
+  }
+
+  void GraphResources::set_range_state(const ImageSubresourceId &base, uint32_t mip_count, uint32_t layer_count, const ImageSubresourceState &state) {
+    split_ranges(base, mip_count, layer_count);
+    for (auto &range : get_ranges(base.id)) {
+      if (range_inside(range, base, mip_count, layer_count)) {
+        range.state.src = state;
+      }
+    }
+    merge_ranges(base.id);
   }
 
   static inline bool is_ro_access(VkAccessFlags flags) {
@@ -151,7 +291,7 @@ namespace rendergraph {
     return (flags & read_msk);
   }
 
-  static inline bool is_write_access(VkAccessFlags flags) {
+  bool is_write_access(VkAccessFlags flags) {
     const auto write_msk = 
       VK_ACCESS_SHADER_WRITE_BIT|
       VK_ACCESS_TRANSFER_WRITE_BIT|
@@ -162,6 +302,276 @@ namespace rendergraph {
     return (flags & write_msk);
   }
 
+  //history images are marked by remap only after the first frames
+  constexpr uint32_t ALIASING_WARMUP_FRAMES = 3;
+
+  GraphResources::~GraphResources() {
+    if (alias_blocks.empty()) {
+      return;
+    }
+
+    //aliased images may be used by frames in flight and have to be destroyed before their memory
+    {
+      std::scoped_lock lock {gpu::app_queue_lock()};
+      vkDeviceWaitIdle(gpu::app_device().api_device());
+    }
+    for (auto &image : global_images) {
+      if (image.alias_block != INVALID_BARRIER_INDEX) {
+        image.vk_image.release();
+        image.alias_block = INVALID_BARRIER_INDEX;
+      }
+    }
+    gpu::collect_image_buffer_resources();
+
+    for (auto &block : alias_blocks) {
+      vmaFreeMemory(gpu::app_device().get_allocator(), block.memory);
+    }
+  }
+
+  void GraphResources::mark_persistent(ImageResourceId id) {
+    auto &image = global_images.at(id.index);
+    if (image.persistent) {
+      return;
+    }
+
+    image.persistent = true;
+    if (is_aliased(id)) {
+      aliasing_dirty = true;
+    }
+  }
+
+  void GraphResources::discard_content(ImageResourceId id) {
+    auto &image = global_images.at(id.index);
+    for (auto &range : image.ranges) {
+      range.state.src.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    }
+    merge_ranges(id);
+  }
+
+  void GraphResources::track_image_use(ImageResourceId id, uint32_t task, VkAccessFlags access, VkPipelineStageFlags stages, bool first_access) {
+    auto &image = global_images.at(id.index);
+    auto &lifetime = image.frame_lifetime;
+
+    if (lifetime.is_empty()) {
+      lifetime.first_task = task;
+    }
+    lifetime.last_task = task;
+
+    //reading content left from previous frame. Default storage access is read-write too, images
+    //which really read-modify-write previous content are declared with mark_persistent
+    if (first_access && !image.persistent && is_ro_access(access) && !is_write_access(access)) {
+      if (is_aliased(id)) {
+        std::cout << "Rendergraph: aliased image " << id.index << " is read before write, excluding it from aliasing\n";
+      }
+      mark_persistent(id);
+    }
+
+    if (!is_aliased(id)) {
+      return;
+    }
+
+    auto &block = alias_blocks.at(image.alias_block);
+    if (block.owner != id.index) {
+      if (!aliasing_dirty) {
+        std::cout << "Rendergraph: aliased image " << id.index << " is used after its memory was taken by image " << block.owner << "\n";
+      }
+      aliasing_dirty = true;
+      return;
+    }
+
+    block.usage.task = task;
+    block.usage.stages |= stages;
+    block.usage.access |= access;
+  }
+
+  AliasHandoff GraphResources::acquire_alias_memory(ImageResourceId id, uint32_t task) {
+    auto &image = global_images.at(id.index);
+    auto &block = alias_blocks.at(image.alias_block);
+
+    if (block.owner == id.index) {
+      return block.handoff;
+    }
+
+    if (block.owner != INVALID_BARRIER_INDEX) {
+      block.handoff = block.usage;
+    }
+
+    if (!image.frame_lifetime.is_empty() || block.handoff.task == task) {
+      if (!aliasing_dirty) {
+        std::cout << "Rendergraph: aliased image " << id.index << " lifetime overlaps image " << block.owner << "\n";
+      }
+      aliasing_dirty = true;
+    }
+
+    block.owner = id.index;
+    block.usage = {};
+    return block.handoff;
+  }
+
+  void GraphResources::flush_lifetimes() {
+    for (auto &image : global_images) {
+      auto &frame = image.frame_lifetime;
+      auto &observed = image.observed_lifetime;
+      if (frame.is_empty()) {
+        continue;
+      }
+
+      if (observed.is_empty()) {
+        observed = frame;
+      } else {
+        observed.first_task = std::min(observed.first_task, frame.first_task);
+        observed.last_task = std::max(observed.last_task, frame.last_task);
+      }
+      frame = {};
+    }
+
+    for (auto &block : alias_blocks) {
+      if (block.owner != INVALID_BARRIER_INDEX) {
+        block.handoff = block.usage;
+      }
+      block.handoff.task = INVALID_BARRIER_INDEX;
+      block.owner = INVALID_BARRIER_INDEX;
+      block.usage = {};
+    }
+
+    observed_frames++;
+  }
+
+  bool GraphResources::is_warmed_up() const {
+    return observed_frames >= ALIASING_WARMUP_FRAMES;
+  }
+
+  void GraphResources::reset_image(GlobalImage &image, gpu::ImagePtr &&ptr) {
+    image.vk_image = std::move(ptr);
+    image.ranges = make_ranges(image.info);
+  }
+
+  bool GraphResources::needs_aliasing_update() const {
+    return !headless && aliasing_dirty && observed_frames >= ALIASING_WARMUP_FRAMES;
+  }
+
+  void GraphResources::update_aliasing() {
+    //there is no device memory to share in headless mode
+    if (headless || !aliasing_dirty || observed_frames < ALIASING_WARMUP_FRAMES) {
+      return;
+    }
+    aliasing_dirty = false;
+
+    auto device = gpu::app_device().api_device();
+    auto allocator = gpu::app_device().get_allocator();
+    {
+      std::scoped_lock lock {gpu::app_queue_lock()};
+      vkDeviceWaitIdle(device); //images are going to be recreated
+    }
+
+    struct Candidate {
+      uint32_t index;
+      VkMemoryRequirements requirements;
+      uint32_t block = INVALID_BARRIER_INDEX;
+    };
+
+    std::vector<Candidate> candidates;
+    for (uint32_t i = 0; i < global_images.size(); i++) {
+      auto &image = global_images[i];
+      bool transient = aliasing_enabled
+        && !image.persistent
+        && !image.observed_lifetime.is_empty()
+        && image.info.tiling == VK_IMAGE_TILING_OPTIMAL;
+
+      if (transient) {
+        VkMemoryRequirements requirements {};
+        vkGetImageMemoryRequirements(device, image.vk_image->api_image(), &requirements);
+        candidates.push_back(Candidate {i, requirements});
+      } else if (image.alias_block != INVALID_BARRIER_INDEX) {
+        reset_image(image, gpu::create_driver_image(image.info));
+        image.alias_block = INVALID_BARRIER_INDEX;
+      }
+    }
+
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate &a, const Candidate &b) {
+      return a.requirements.size > b.requirements.size;
+    });
+
+    struct BlockPlan {
+      VkMemoryRequirements requirements;
+      std::vector<uint32_t> images;
+    };
+
+    //largest images first, each goes to the first block without lifetime overlaps
+    std::vector<BlockPlan> plan;
+    for (auto &candidate : candidates) {
+      const auto &lifetime = global_images[candidate.index].observed_lifetime;
+      const auto &req = candidate.requirements;
+
+      for (uint32_t block_index = 0; block_index < plan.size(); block_index++) {
+        auto &block = plan[block_index];
+        if (!(block.requirements.memoryTypeBits & req.memoryTypeBits) || block.requirements.size < req.size) {
+          continue;
+        }
+
+        bool overlaps = false;
+        for (auto image_index : block.images) {
+          overlaps |= global_images[image_index].observed_lifetime.overlaps(lifetime);
+        }
+
+        if (overlaps) {
+          continue;
+        }
+
+        block.requirements.memoryTypeBits &= req.memoryTypeBits;
+        block.requirements.alignment = std::max(block.requirements.alignment, req.alignment);
+        block.images.push_back(candidate.index);
+        candidate.block = block_index;
+        break;
+      }
+
+      if (candidate.block == INVALID_BARRIER_INDEX) {
+        candidate.block = plan.size();
+        plan.push_back(BlockPlan {req, {candidate.index}});
+      }
+    }
+
+    AliasingStats stats {};
+    std::vector<AliasBlock> blocks;
+    blocks.reserve(plan.size());
+
+    for (const auto &block : plan) {
+      VmaAllocationCreateInfo alloc_info {};
+      alloc_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+      AliasBlock alias_block {};
+      VKCHECK(vmaAllocateMemory(allocator, &block.requirements, &alloc_info, &alias_block.memory, nullptr));
+      alias_block.size = block.requirements.size;
+      blocks.push_back(alias_block);
+
+      stats.memory_blocks++;
+      stats.allocated_bytes += block.requirements.size;
+    }
+
+    for (const auto &candidate : candidates) {
+      auto &image = global_images[candidate.index];
+      reset_image(image, gpu::create_aliased_image(image.info, blocks[candidate.block].memory));
+      image.alias_block = candidate.block;
+
+      stats.transient_images++;
+      stats.requested_bytes += candidate.requirements.size;
+    }
+
+    //old images are released by reset_image, destroy them before their memory
+    gpu::collect_image_buffer_resources();
+    for (auto &block : alias_blocks) {
+      vmaFreeMemory(allocator, block.memory);
+    }
+
+    alias_blocks = std::move(blocks);
+    aliasing_stats = stats;
+
+    const double mb = 1024.0 * 1024.0;
+    std::cout << "Rendergraph aliasing: " << stats.transient_images << " transient images in " 
+      << stats.memory_blocks << " blocks, " << stats.requested_bytes/mb << "MB -> " 
+      << stats.allocated_bytes/mb << "MB, saved " << stats.saved_bytes()/mb << "MB\n";
+  }
+
   static bool merge_states(ImageTrackingState &state, const ImageSubresourceState &access) {
     if (state.dst.layout != access.layout) {
       return false;
@@ -175,13 +585,16 @@ namespace rendergraph {
     return false;
   }
 
-  static void flush_barrier(std::vector<Barrier> &barriers, const ImageSubresourceId &id, const ImageTrackingState &track) {
+  static void flush_barrier(std::vector<Barrier> &barriers, ImageResourceId id, const ImageTrackingRange &range) {
+    const auto &track = range.state;
     if (barriers.size() <= track.barrier_id) {
       barriers.resize(track.barrier_id + 1);
     }
     
     ImageBarrierState image_barrier {};
-    image_barrier.id = id;
+    image_barrier.id = ImageSubresourceId {id, range.mip, range.layer};
+    image_barrier.mip_count = range.mip_count;
+    image_barrier.layer_count = range.layer_count;
     image_barrier.wait_for = track.wait_for;
     image_barrier.src = track.src;
     image_barrier.dst = track.dst;
@@ -209,14 +622,17 @@ namespace rendergraph {
     }
   }
 
-  static void flush_resource(std::vector<TaskResources> &tasks, const ImageSubresourceId &id, const ImageTrackingState &track) {
+  static void flush_resource(std::vector<TaskResources> &tasks, ImageResourceId id, const ImageTrackingRange &range) {
+    const auto &track = range.state;
     if (tasks.size() <= track.wait_for) {
       tasks.resize(track.wait_for + 1);
     }
 
     ImageReleaseState image_release {};
     image_release.acquire_at = track.barrier_id;
-    image_release.id = id;
+    image_release.id = ImageSubresourceId {id, range.mip, range.layer};
+    image_release.mip_count = range.mip_count;
+    image_release.layer_count = range.layer_count;
     image_release.src = track.src;
     image_release.dst = track.dst;
 
@@ -257,8 +673,6 @@ namespace rendergraph {
     return false;
   }
 
-  static void dump_stages(VkPipelineStageFlags flags);
-
   static bool validate_stage(VkPipelineStageFlags flags) {
     constexpr auto valid = 
       VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT|
@@ -281,8 +695,8 @@ namespace rendergraph {
     StateValidator(const T &t) : ref {t} {}
     ~StateValidator() {
       /*if (!validate_stage(ref.src.stages) || !validate_stage(ref.dst.stages)) {
-        dump_stages(ref.src.stages);
-        dump_stages(ref.dst.stages);
+        write_stages(std::cout, ref.src.stages);
+        write_stages(std::cout, ref.dst.stages);
         std::cout << "Tracking error\n";
       }*/
     }
@@ -291,7 +705,40 @@ namespace rendergraph {
     const T &ref;
   };
 
+  void TrackingState::next_task(std::string_view name) {
+    gpu::hash_combine(signature, name);
+    if (validation_enabled) {
+      task_names.emplace_back(name);
+    }
+    index++;
+  }
+
   void TrackingState::add_input(GraphResources &resources, const BufferResourceId &id, const BufferState &state) {
+    gpu::hash_combine(signature, index);
+    gpu::hash_combine(signature, id.get_index());
+    gpu::hash_combine(signature, state.stages);
+    gpu::hash_combine(signature, state.access);
+
+    buffer_inputs.push_back(BufferInput {index, id, state});
+  }
+  
+  void TrackingState::add_input(GraphResources &resources, const ImageSubresourceId &id, const ImageSubresourceState &state) {
+    add_input(resources, id, 1, 1, state);
+  }
+
+  void TrackingState::add_input(GraphResources &resources, const ImageSubresourceId &base, uint32_t mip_count, uint32_t layer_count, const ImageSubresourceState &state) {
+    gpu::hash_combine(signature, index);
+    gpu::hash_combine(signature, ImageSubresourceHashFunc {}(base));
+    gpu::hash_combine(signature, mip_count);
+    gpu::hash_combine(signature, layer_count);
+    gpu::hash_combine(signature, state.stages);
+    gpu::hash_combine(signature, state.access);
+    gpu::hash_combine(signature, uint32_t(state.layout));
+
+    image_inputs.push_back(ImageInput {index, base, mip_count, layer_count, state});
+  }
+
+  void TrackingState::track_input(GraphResources &resources, const BufferResourceId &id, const BufferState &state) {
     auto &track = resources.get_resource_state(id);
     StateValidator<decltype(track)> validator {track};
 
@@ -328,8 +775,33 @@ namespace rendergraph {
     track.dst = state;
   }
   
-  void TrackingState::add_input(GraphResources &resources, const ImageSubresourceId &id, const ImageSubresourceState &state) {
-    auto &track = resources.get_resource_state(id);
+  void TrackingState::track_input(GraphResources &resources, const ImageInput &input) {
+    const auto id = input.id.id;
+    resources.split_ranges(input.id, input.mip_count, input.layer_count);
+    auto &ranges = resources.get_ranges(id);
+
+    bool tracked = false;
+    for (const auto &range : ranges) {
+      tracked |= !is_empty_state(range.state);
+    }
+    if (!tracked) {
+      dirty_images.push_back(id);
+    }
+
+    bool first_access = false;
+    for (auto &range : ranges) {
+      if (range_inside(range, input.id, input.mip_count, input.layer_count)) {
+        first_access |= is_empty_state(range.state);
+        track_range(resources, id, range, input.state);
+      }
+    }
+
+    resources.track_image_use(id, index, input.state.access, input.state.stages, first_access);
+    resources.merge_ranges(id);
+  }
+
+  void TrackingState::track_range(GraphResources &resources, ImageResourceId id, ImageTrackingRange &range, const ImageSubresourceState &state) {
+    auto &track = range.state;
     StateValidator<decltype(track)> validator {track};
 
     if (is_empty_state(track)) { //acquire resource
@@ -337,7 +809,10 @@ namespace rendergraph {
       track.last_access = index;
       track.wait_for = INVALID_BARRIER_INDEX;
       track.dst = state;
-      dirty_images.push_back(id);
+      
+      if (resources.is_aliased(id)) {
+        acquire_aliased(resources, id, track);
+      }
       return;
     }
 
@@ -352,9 +827,9 @@ namespace rendergraph {
     }
 
     if (track.wait_for != INVALID_BARRIER_INDEX) {
-      flush_resource(task_resources, id, track);
+      flush_resource(task_resources, id, range);
     } else {
-      flush_barrier(barriers, id, track);
+      flush_barrier(barriers, id, range);
     }
 
     track.wait_for = track.last_access;
@@ -364,21 +839,395 @@ namespace rendergraph {
     track.dst = state;
   }
 
+  static bool same_transition(const ImageBarrierState &a, const ImageBarrierState &b) {
+    return a.id.id == b.id.id && a.wait_for == b.wait_for
+      && a.src.stages == b.src.stages && a.src.access == b.src.access && a.src.layout == b.src.layout
+      && a.dst.stages == b.dst.stages && a.dst.access == b.dst.access && a.dst.layout == b.dst.layout;
+  }
+
+  //joins barriers of neighbour subresources with equal transitions into mip ranges, then into layer ranges
+  static void merge_image_barriers(std::vector<ImageBarrierState> &image_barriers) {
+    if (image_barriers.size() < 2) {
+      return;
+    }
+
+    std::sort(image_barriers.begin(), image_barriers.end(), [](const ImageBarrierState &a, const ImageBarrierState &b) {
+      if (a.id.id.get_index() != b.id.id.get_index()) return a.id.id.get_index() < b.id.id.get_index();
+      if (a.id.layer != b.id.layer) return a.id.layer < b.id.layer;
+      return a.id.mip < b.id.mip;
+    });
+
+    std::vector<ImageBarrierState> mip_ranges;
+    mip_ranges.reserve(image_barriers.size());
+
+    for (const auto &state : image_barriers) {
+      if (mip_ranges.size()) {
+        auto &last = mip_ranges.back();
+        if (same_transition(last, state) && last.id.layer == state.id.layer && last.id.mip + last.mip_count == state.id.mip) {
+          last.mip_count += state.mip_count;
+          continue;
+        }
+      }
+      mip_ranges.push_back(state);
+    }
+
+    image_barriers.clear();
+    for (const auto &state : mip_ranges) {
+      bool merged = false;
+      for (auto iter = image_barriers.rbegin(); iter != image_barriers.rend() && iter->id.id == state.id.id; iter++) {
+        if (same_transition(*iter, state)
+          && iter->id.mip == state.id.mip && iter->mip_count == state.mip_count
+          && iter->id.layer + iter->layer_count == state.id.layer)
+        {
+          iter->layer_count += state.layer_count;
+          merged = true;
+          break;
+        }
+      }
+
+      if (!merged) {
+        image_barriers.push_back(state);
+      }
+    }
+  }
+
+  void TrackingState::acquire_aliased(GraphResources &resources, ImageResourceId id, ImageTrackingState &track) {
+    //memory was used by another image, old content is discarded
+    auto handoff = resources.acquire_alias_memory(id, index);
+    track.src.stages = handoff.stages;
+    track.src.access = handoff.access;
+    track.src.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    if (handoff.task != INVALID_BARRIER_INDEX && handoff.task < index) {
+      track.barrier_id = index;
+      track.wait_for = handoff.task;
+    }
+  }
+
   void TrackingState::flush(GraphResources &resources) {
-    for (auto id : dirty_images) {
-      auto &track = resources.get_resource_state(id);
-      StateValidator<decltype(track)> validator {track};
+    //plan is cached after two frames with equal signatures, so state carried between frames is steady too
+    culled_tasks.clear();
+    hash_resource_states(resources);
+    add_state(resources.is_warmed_up());
+
+    if (cache_valid && signature == cached_signature && is_cached_frame()) {
+      barriers = cached_barriers;
+      dependencies = cached_dependencies;
+      culled_tasks = cached_culled_tasks;
+      renderpasses = cached_renderpasses;
+      for (const auto &image : cached_final_images) {
+        resources.set_range_state(image.id, image.mip_count, image.layer_count, image.state);
+      }
+      for (const auto &[id, state] : cached_final_buffers) {
+        resources.get_resource_state(id).src = state;
+      }
+      cache_stats.hits++;
+    } else {
+      //inputs are changed by culling
+      const bool cache_frame = (signature == prev_signature);
+      if (cache_frame) {
+        cached_image_inputs = image_inputs;
+        cached_buffer_inputs = buffer_inputs;
+        cached_states = frame_states;
+      }
 
-      if (track.wait_for != INVALID_BARRIER_INDEX) {
-        flush_resource(task_resources, id, track);
+      if (validation_enabled) {
+        validate(resources);
+      }
+      if (culling_enabled) {
+        cull_tasks(resources);
+      }
+      compile(resources);
+      cache_stats.misses++;
+
+      if (inputs_requested) {
+        kept_inputs.images = image_inputs;
+        kept_inputs.buffers = buffer_inputs;
+        inputs_requested = false;
+        inputs_kept = true;
+      }
+      
+      cache_valid = cache_frame;
+      if (cache_valid) {
+        cached_signature = signature;
+        cached_barriers = barriers;
+        cached_dependencies = dependencies;
+        cached_final_images = final_images;
+        cached_final_buffers = final_buffers;
+        cached_culled_tasks = culled_tasks;
+        cached_renderpasses = renderpasses;
+      }
+    }
+
+    resources.flush_lifetimes();
+
+    prev_signature = signature;
+    signature = 0;
+    index = 0;
+    image_inputs.clear();
+    buffer_inputs.clear();
+    task_names.clear();
+    frame_states.clear();
+  }
+
+  void TrackingState::add_state(uint32_t value) {
+    gpu::hash_combine(signature, value);
+    frame_states.push_back(value);
+  }
+
+  void TrackingState::hash_resource_states(GraphResources &resources) {
+    for (const auto &input : buffer_inputs) {
+      const auto &track = resources.get_resource_state(input.id);
+      add_state(track.src.stages);
+      add_state(track.src.access);
+    }
+
+    //ranges of each image are hashed once
+    hashed_images.assign(hashed_images.size(), false);
+    for (const auto &input : image_inputs) {
+      const auto image = input.id.id.get_index();
+      if (hashed_images.size() <= image) {
+        hashed_images.resize(image + 1, false);
+      }
+      if (hashed_images[image]) {
+        continue;
+      }
+      hashed_images[image] = true;
+
+      const auto &ranges = resources.get_ranges(input.id.id);
+      add_state(image);
+      add_state(resources.is_aliased(input.id.id));
+      add_state(resources.is_persistent(input.id.id));
+      add_state(ranges.size());
+
+      for (const auto &range : ranges) {
+        add_state(range.mip);
+        add_state(range.layer);
+        add_state(range.mip_count);
+        add_state(range.layer_count);
+        add_state(range.state.src.stages);
+        add_state(range.state.src.access);
+        add_state(uint32_t(range.state.src.layout));
+      }
+    }
+  }
+
+  bool TrackingState::is_cached_frame() const {
+    auto same_image_input = [](const ImageInput &a, const ImageInput &b) {
+      return a.task == b.task && a.id == b.id && a.mip_count == b.mip_count && a.layer_count == b.layer_count && equal_states(a.state, b.state);
+    };
+    auto same_buffer_input = [](const BufferInput &a, const BufferInput &b) {
+      return a.task == b.task && a.id == b.id && a.state.stages == b.state.stages && a.state.access == b.state.access;
+    };
+
+    return frame_states == cached_states
+      && std::equal(image_inputs.begin(), image_inputs.end(), cached_image_inputs.begin(), cached_image_inputs.end(), same_image_input)
+      && std::equal(buffer_inputs.begin(), buffer_inputs.end(), cached_buffer_inputs.begin(), cached_buffer_inputs.end(), same_buffer_input);
+  }
+
+  bool TrackingState::take_inputs(GraphInputs &out) {
+    if (!inputs_kept) {
+      return false;
+    }
+    out = std::move(kept_inputs);
+    kept_inputs = {};
+    inputs_kept = false;
+    return true;
+  }
+
+  void TrackingState::add_warning(std::string &&warning) {
+    if (std::find(validation_warnings.begin(), validation_warnings.end(), warning) != validation_warnings.end()) {
+      return;
+    }
+
+    if (reported_warnings.insert(warning).second) {
+      std::cout << "Rendergraph: " << warning << "\n";
+    }
+    validation_warnings.push_back(std::move(warning));
+  }
+
+  void TrackingState::validate(GraphResources &resources) {
+    validation_warnings.clear();
+    
+    auto task_name = [&](uint32_t task) {
+      return "task '" + ((task < task_names.size())? task_names[task] : std::to_string(task)) + "'";
+    };
+    auto image_name = [](const ImageSubresourceId &id) {
+      return "image " + std::to_string(id.id.get_index()) + " (mip " + std::to_string(id.mip) + ", layer " + std::to_string(id.layer) + ")";
+    };
+
+    //write which wasn't read yet by later tasks
+    struct PendingWrite {
+      uint32_t task = INVALID_BARRIER_INDEX;
+    };
+    std::unordered_map<ImageSubresourceId, PendingWrite, ImageSubresourceHashFunc> writes;
+    std::vector<ImageSubresourceId> access_order;
+
+    for (const auto &input : image_inputs) {
+      const auto &state = input.state;
+      bool reads = is_ro_access(state.access);
+      bool writes_content = is_write_access(state.access);
+
+      if (state.layout == VK_IMAGE_LAYOUT_GENERAL && reads && !writes_content) {
+        add_warning(task_name(input.task) + " uses " + image_name(input.id) + " as read-only storage image, sampling allows VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL");
+      }
+
+      for (uint32_t layer = input.id.layer; layer < input.id.layer + input.layer_count; layer++) {
+        for (uint32_t mip = input.id.mip; mip < input.id.mip + input.mip_count; mip++) {
+          ImageSubresourceId id {input.id.id, mip, layer};
+          auto iter = writes.find(id);
+
+          if (iter == writes.end()) {
+            //first access in frame
+            iter = writes.emplace(id, PendingWrite {}).first;
+            access_order.push_back(id);
+            if (reads && !writes_content) {
+              const auto &track = resources.get_resource_state(id);
+              if (track.src.layout == VK_IMAGE_LAYOUT_UNDEFINED) {
+                add_warning(task_name(input.task) + " reads " + image_name(id) + " before any write, content is undefined");
+              } else if (!resources.is_persistent(id.id)) {
+                add_warning(task_name(input.task) + " reads " + image_name(id) + " before any write in frame, content of previous frame is used but image isn't persistent");
+              }
+            }
+          } else if (iter->second.task != INVALID_BARRIER_INDEX && !reads && state.access == VK_ACCESS_TRANSFER_WRITE_BIT) {
+            //copies replace content, attachments and storage writes may keep a part of it
+            add_warning(task_name(iter->second.task) + " writes " + image_name(id) + ", but " + task_name(input.task) + " overwrites it before any read");
+          }
+
+          if (reads) {
+            iter->second.task = INVALID_BARRIER_INDEX;
+          }
+          if (writes_content) {
+            iter->second.task = input.task;
+          }
+        }
+      }
+    }
+
+    //persistent images are consumed outside of the frame
+    for (const auto &id : access_order) {
+      auto task = writes[id].task;
+      if (task != INVALID_BARRIER_INDEX && !resources.is_persistent(id.id)) {
+        add_warning(task_name(task) + " writes " + image_name(id) + ", but nothing reads it");
+      }
+    }
+  }
+
+  void TrackingState::cull_tasks(GraphResources &resources) {
+    const uint32_t tasks_count = index;
+    std::vector<bool> has_writes(tasks_count, false);
+    std::vector<bool> live(tasks_count, false);
+
+    //buffers and persistent images are consumed outside of the frame
+    for (const auto &input : buffer_inputs) {
+      if (is_write_access(input.state.access)) {
+        has_writes[input.task] = true;
+        live[input.task] = true;
+      }
+    }
+
+    for (const auto &input : image_inputs) {
+      if (is_write_access(input.state.access)) {
+        has_writes[input.task] = true;
+        if (resources.is_persistent(input.id.id)) {
+          live[input.task] = true;
+        }
+      }
+    }
+
+    //tasks without writes have side effects outside of the graph (readbacks, present)
+    for (uint32_t task = 0; task < tasks_count; task++) {
+      if (!has_writes[task]) {
+        live[task] = true;
+      }
+    }
+
+    //inputs are ordered by task, walk them backwards
+    std::unordered_set<uint32_t> needed_images;
+    uint32_t pos = image_inputs.size();
+    
+    for (uint32_t task = tasks_count; task > 0; task--) {
+      uint32_t end = pos;
+      while (pos > 0 && image_inputs[pos - 1].task == task - 1) {
+        pos--;
+      }
+
+      for (uint32_t i = pos; i < end && !live[task - 1]; i++) {
+        const auto &input = image_inputs[i];
+        if (is_write_access(input.state.access) && needed_images.count(input.id.id.get_index())) {
+          live[task - 1] = true;
+        }
+      }
+
+      if (live[task - 1]) {
+        for (uint32_t i = pos; i < end; i++) {
+          needed_images.insert(image_inputs[i].id.id.get_index());
+        }
+      }
+    }
+
+    std::vector<uint32_t> task_remap(tasks_count, INVALID_BARRIER_INDEX);
+    uint32_t live_count = 0;
+    for (uint32_t task = 0; task < tasks_count; task++) {
+      if (live[task]) {
+        task_remap[task] = live_count++;
       } else {
-        flush_barrier(barriers, id, track);
+        culled_tasks.push_back(task);
       }
+    }
 
-      track.src = track.dst;
-      track.barrier_id = INVALID_BARRIER_INDEX;
-      track.last_access = INVALID_BARRIER_INDEX;
-      track.wait_for = INVALID_BARRIER_INDEX;
+    if (culled_tasks.empty()) {
+      return;
+    }
+
+    auto image_end = std::remove_if(image_inputs.begin(), image_inputs.end(), [&](const ImageInput &input) { return !live[input.task]; });
+    image_inputs.erase(image_end, image_inputs.end());
+    for (auto &input : image_inputs) {
+      input.task = task_remap[input.task];
+    }
+
+    auto buffer_end = std::remove_if(buffer_inputs.begin(), buffer_inputs.end(), [&](const BufferInput &input) { return !live[input.task]; });
+    buffer_inputs.erase(buffer_end, buffer_inputs.end());
+    for (auto &input : buffer_inputs) {
+      input.task = task_remap[input.task];
+    }
+  }
+
+  void TrackingState::compile(GraphResources &resources) {
+    const uint32_t tasks_count = index - culled_tasks.size();
+    final_images.clear();
+    final_buffers.clear();
+
+    for (const auto &input : image_inputs) {
+      index = input.task;
+      track_input(resources, input);
+    }
+
+    for (const auto &input : buffer_inputs) {
+      index = input.task;
+      track_input(resources, input.id, input.state);
+    }
+
+    for (auto id : dirty_images) {
+      for (auto &range : resources.get_ranges(id)) {
+        auto &track = range.state;
+        if (is_empty_state(track)) {
+          continue;
+        }
+
+        if (track.wait_for != INVALID_BARRIER_INDEX) {
+          flush_resource(task_resources, id, range);
+        } else {
+          flush_barrier(barriers, id, range);
+        }
+
+        //only src state is kept between frames, so ranges with equal layouts can be merged
+        auto final_state = track.dst;
+        track = {};
+        track.src = final_state;
+        final_images.push_back(ImageRangeState {ImageSubresourceId {id, range.mip, range.layer}, range.mip_count, range.layer_count, final_state});
+      }
+      resources.merge_ranges(id);
     }
 
     for (auto id : dirty_buffers) {
@@ -395,12 +1244,18 @@ namespace rendergraph {
       track.barrier_id = INVALID_BARRIER_INDEX;
       track.last_access = INVALID_BARRIER_INDEX;
       track.wait_for = INVALID_BARRIER_INDEX;
+      final_buffers.push_back({id, track.dst});
     }
     
     gen_barriers();
     gen_event_sync();
+    gen_dependencies();
+    gen_renderpasses(resources, tasks_count);
+
+    for (auto &barrier : barriers) {
+      merge_image_barriers(barrier.image_barriers);
+    }
 
-    index = 0;
     dirty_buffers.clear();
     dirty_images.clear();
   }
@@ -438,6 +1293,8 @@ namespace rendergraph {
         ImageBarrierState img_barrier {};
         img_barrier.wait_for = index;
         img_barrier.id = res.id;
+        img_barrier.mip_count = res.mip_count;
+        img_barrier.layer_count = res.layer_count;
         img_barrier.src = res.src;
         img_barrier.dst = res.dst;
         barrier.image_barriers.push_back(img_barrier);
@@ -465,24 +1322,265 @@ namespace rendergraph {
     }
   }
 
+  void TrackingState::gen_dependencies() {
+    //task depends on the last task which changed resource state and on readers since that change.
+    //Resources are tracked as a whole, first access waits for frame acquires done by task 0
+    struct ResourceUse {
+      bool used = false;
+      uint32_t modifier = 0;
+      VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+      std::vector<uint32_t> readers;
+    };
+
+    dependencies.clear();
+
+    auto add_dependency = [&](uint32_t task, uint32_t dep) {
+      if (dep >= task) {
+        return;
+      }
+      if (dependencies.size() <= task) {
+        dependencies.resize(task + 1);
+      }
+      dependencies[task].push_back(dep);
+    };
+
+    auto use_resource = [&](ResourceUse &use, uint32_t task, bool modify) {
+      add_dependency(task, use.modifier);
+      if (modify) {
+        for (auto reader : use.readers) {
+          add_dependency(task, reader);
+        }
+        use.readers.clear();
+        use.modifier = task;
+      } else {
+        use.readers.push_back(task);
+      }
+      use.used = true;
+    };
+
+    std::unordered_map<uint32_t, ResourceUse> images;
+    for (const auto &input : image_inputs) {
+      auto &use = images[input.id.id.get_index()];
+      bool modify = is_write_access(input.state.access) || (use.used && use.layout != input.state.layout);
+      use_resource(use, input.task, modify);
+      use.layout = input.state.layout;
+    }
+
+    std::unordered_map<uint32_t, ResourceUse> buffers;
+    for (const auto &input : buffer_inputs) {
+      use_resource(buffers[input.id.get_index()], input.task, is_write_access(input.state.access));
+    }
+
+    //aliased memory handoffs are known only from barriers
+    for (uint32_t task = 0; task < barriers.size(); task++) {
+      for (auto wait_task : barriers[task].wait_tasks) {
+        add_dependency(task, wait_task);
+      }
+    }
+
+    for (auto &deps : dependencies) {
+      std::sort(deps.begin(), deps.end());
+      deps.erase(std::unique(deps.begin(), deps.end()), deps.end());
+    }
+  }
+
+  static uint32_t format_texel_size(VkFormat format) {
+    switch (format) {
+      case VK_FORMAT_R8_UNORM:
+      case VK_FORMAT_R8_UINT:
+        return 1;
+      case VK_FORMAT_R8G8_UNORM:
+      case VK_FORMAT_R16_SFLOAT:
+      case VK_FORMAT_R16_UNORM:
+      case VK_FORMAT_R16_UINT:
+      case VK_FORMAT_D16_UNORM:
+        return 2;
+      case VK_FORMAT_R16G16B16A16_SFLOAT:
+      case VK_FORMAT_R16G16B16A16_UNORM:
+      case VK_FORMAT_R32G32_SFLOAT:
+      case VK_FORMAT_R32G32_UINT:
+      case VK_FORMAT_D32_SFLOAT_S8_UINT:
+        return 8;
+      case VK_FORMAT_R32G32B32A32_SFLOAT:
+      case VK_FORMAT_R32G32B32A32_UINT:
+        return 16;
+      default:
+        return 4;
+    }
+  }
+
+  static bool is_attachment_layout(VkImageLayout layout) {
+    return layout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL || layout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+  }
+
+  void TrackingState::gen_renderpasses(GraphResources &resources, uint32_t tasks_count) {
+    //tasks are merged when barrier between them only keeps attachments in the same layout.
+    //Content is not loaded before the first access in frame and not stored after the last one,
+    //unless the image is persistent
+    struct AccessRange {
+      uint32_t first = INVALID_BARRIER_INDEX;
+      uint32_t last = 0;
+    };
+
+    auto &plan = renderpasses;
+    plan.tasks.assign(tasks_count, TaskRenderpass {});
+    plan.attachments.clear();
+    plan.stats = {};
+
+    std::unordered_map<ImageSubresourceId, AccessRange, ImageSubresourceHashFunc> accesses;
+    std::vector<std::pair<ImageSubresourceId, VkImageLayout>> attachments;
+
+    //attachment inputs are ordered by task and address a single subresource
+    for (const auto &input : image_inputs) {
+      if (is_attachment_layout(input.state.layout) && input.task < tasks_count) {
+        auto &task = plan.tasks[input.task];
+        if (!task.attachments_count) {
+          task.first_attachment = attachments.size();
+        }
+        task.attachments_count++;
+        attachments.push_back({input.id, input.state.layout});
+        accesses[input.id] = {};
+      }
+    }
+
+    if (attachments.empty()) {
+      return;
+    }
+
+    for (const auto &input : image_inputs) {
+      for (uint32_t layer = input.id.layer; layer < input.id.layer + input.layer_count; layer++) {
+        for (uint32_t mip = input.id.mip; mip < input.id.mip + input.mip_count; mip++) {
+          auto iter = accesses.find(ImageSubresourceId {input.id.id, mip, layer});
+          if (iter != accesses.end()) {
+            iter->second.first = std::min(iter->second.first, input.task);
+            iter->second.last = std::max(iter->second.last, input.task);
+          }
+        }
+      }
+    }
+
+    auto same_attachments = [&](const TaskRenderpass &l, const TaskRenderpass &r) {
+      if (l.attachments_count != r.attachments_count) {
+        return false;
+      }
+      for (uint32_t i = 0; i < l.attachments_count; i++) {
+        const auto &la = attachments[l.first_attachment + i];
+        const auto &ra = attachments[r.first_attachment + i];
+        if (!(la.first == ra.first) || la.second != ra.second) {
+          return false;
+        }
+      }
+      return true;
+    };
+
+    //only pipeline barriers after the previous task, events are signaled outside of render passes
+    auto attachment_barrier_only = [&](const TaskRenderpass &task, const Barrier &barrier, uint32_t prev_task) {
+      if (barrier.is_empty()) {
+        return true;
+      }
+      if (!barrier.buffer_barriers.empty() || barrier.max_wait_task_index != prev_task) {
+        return false;
+      }
+      for (const auto &image : barrier.image_barriers) {
+        if (image.mip_count != 1 || image.layer_count != 1 || image.src.layout != image.dst.layout) {
+          return false;
+        }
+        bool found = false;
+        for (uint32_t i = 0; i < task.attachments_count && !found; i++) {
+          found = (attachments[task.first_attachment + i].first == image.id);
+        }
+        if (!found) {
+          return false;
+        }
+      }
+      return true;
+    };
+
+    auto attachment_bytes = [&](const ImageSubresourceId &id) {
+      const auto &info = resources.get_info(id.id);
+      uint64_t width = std::max(info.extent.width >> id.mip, 1u);
+      uint64_t height = std::max(info.extent.height >> id.mip, 1u);
+      return width * height * format_texel_size(info.format);
+    };
+
+    const bool warmed_up = resources.is_warmed_up();
+
+    for (uint32_t start = 0; start < tasks_count;) {
+      if (!plan.tasks[start].attachments_count) {
+        start++;
+        continue;
+      }
+
+      uint32_t end = start + 1;
+      while (end < tasks_count
+        && same_attachments(plan.tasks[start], plan.tasks[end])
+        && (end >= barriers.size() || attachment_barrier_only(plan.tasks[start], barriers[end], end - 1))
+        && (end - 1 >= barriers.size() || !barriers[end - 1].signal_mask))
+      {
+        plan.tasks[end - 1].merge_with_next = true;
+        //attachment writes inside one subpass are ordered, task keeps its own signal
+        if (end < barriers.size()) {
+          barriers[end].image_barriers.clear();
+          barriers[end].wait_tasks.clear();
+          barriers[end].max_wait_task_index = INVALID_BARRIER_INDEX;
+        }
+        end++;
+      }
+
+      const auto &first = plan.tasks[start];
+      uint32_t merged = end - start - 1;
+      plan.stats.renderpasses++;
+      plan.stats.merged_tasks += merged;
+
+      uint32_t ops_offset = plan.attachments.size();
+      for (uint32_t i = 0; i < first.attachments_count; i++) {
+        const auto &id = attachments[first.first_attachment + i].first;
+        const auto &range = accesses[id];
+        bool transient = warmed_up && !resources.is_persistent(id.id);
+        uint64_t bytes = attachment_bytes(id);
+
+        gpu::AttachmentOps ops {};
+        if (transient && range.first == start) {
+          ops.load = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+          plan.stats.load_bytes_avoided += bytes;
+        }
+        if (transient && range.last == end - 1) {
+          ops.store = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+          plan.stats.store_bytes_avoided += bytes;
+        }
+        plan.attachments.push_back(AttachmentOpsState {id, ops});
+      }
+
+      //tasks of the render pass share ops
+      for (uint32_t task = start; task < end; task++) {
+        plan.tasks[task].first_attachment = ops_offset;
+      }
+      start = end;
+    }
+  }
+
   void TrackingState::clear() {
     index = 0;
+    signature = 0;
     dirty_buffers.clear();
     dirty_images.clear();
+    image_inputs.clear();
+    buffer_inputs.clear();
+    frame_states.clear();
     barriers.clear();
     task_resources.clear();
   }
 
 
   #define PRINT_FLAG(flag_name) if (flags & flag_name) { \
-    if (!first) std::cout << "|"; \
-    std::cout << #flag_name ; \
+    if (!first) out << "|"; \
+    out << #flag_name ; \
     first = false; \
   } 
 
-  static void dump_stages(VkPipelineStageFlags flags) {
+  void write_stages(std::ostream &out, VkPipelineStageFlags flags) {
     if (!flags) {
-      std::cout << "0";
+      out << "0";
       return;
     }
 
@@ -506,9 +1604,9 @@ namespace rendergraph {
     PRINT_FLAG(VK_PIPELINE_STAGE_ALL_COMMANDS_BIT)
   }
 
-  static void dump_access(VkAccessFlags flags) {
+  void write_access(std::ostream &out, VkAccessFlags flags) {
     if (!flags) {
-      std::cout << "0";
+      out << "0";
       return;
     }
 
@@ -532,8 +1630,8 @@ namespace rendergraph {
     PRINT_FLAG(VK_ACCESS_MEMORY_WRITE_BIT)
   }
 
-  static void dump_layout(VkImageLayout layout) {
-    #define PRINT(x) case x: std::cout << #x; break
+  void write_layout(std::ostream &out, VkImageLayout layout) {
+    #define PRINT(x) case x: out << #x; break
 
     switch (layout) {
       PRINT(VK_IMAGE_LAYOUT_UNDEFINED);
@@ -553,7 +1651,7 @@ namespace rendergraph {
       PRINT(VK_IMAGE_LAYOUT_STENCIL_READ_ONLY_OPTIMAL);
       PRINT(VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
       default:
-        std::cout << "EXT layout";
+        out << "EXT layout";
     }
   } 
 
@@ -565,29 +1663,30 @@ namespace rendergraph {
       std::cout << " - Image barrier " << "\n";
       std::cout << " --- id " << img_barrier.id.id.get_index() << "\n";
       std::cout << " --- mip = " << img_barrier.id.mip << " layer = " << img_barrier.id.layer << "\n";
+      std::cout << " --- mip_count = " << img_barrier.mip_count << " layer_count = " << img_barrier.layer_count << "\n";
       std::cout << " --- wait for " << img_barrier.wait_for << "\n";
-      std::cout << " --- src_stages : "; dump_stages(img_barrier.src.stages); std::cout << "\n";
-      std::cout << " --- src_access : "; dump_access(img_barrier.src.access); std::cout << "\n";
-      std::cout << " --- src_layout : "; dump_layout(img_barrier.src.layout); std::cout << "\n";
+      std::cout << " --- src_stages : "; write_stages(std::cout, img_barrier.src.stages); std::cout << "\n";
+      std::cout << " --- src_access : "; write_access(std::cout, img_barrier.src.access); std::cout << "\n";
+      std::cout << " --- src_layout : "; write_layout(std::cout, img_barrier.src.layout); std::cout << "\n";
       
-      std::cout << " --- dst_stages : "; dump_stages(img_barrier.dst.stages); std::cout << "\n";
-      std::cout << " --- dst_access : "; dump_access(img_barrier.dst.access); std::cout << "\n";
-      std::cout << " --- dst_layout : "; dump_layout(img_barrier.dst.layout); std::cout << "\n";
+      std::cout << " --- dst_stages : "; write_stages(std::cout, img_barrier.dst.stages); std::cout << "\n";
+      std::cout << " --- dst_access : "; write_access(std::cout, img_barrier.dst.access); std::cout << "\n";
+      std::cout << " --- dst_layout : "; write_layout(std::cout, img_barrier.dst.layout); std::cout << "\n";
     }
 
     for (const auto &buf_barrier : barrier.buffer_barriers) {
 
       std::cout << " - Memory barrier for buffer " << buf_barrier.id.get_index() << "\n";
       std::cout << " --- wait for " << buf_barrier.wait_for << "\n";
-      std::cout << " --- src_stages : "; dump_stages(buf_barrier.src.stages); std::cout << "\n";
-      std::cout << " --- src_access : "; dump_access(buf_barrier.src.access); std::cout << "\n";
+      std::cout << " --- src_stages : "; write_stages(std::cout, buf_barrier.src.stages); std::cout << "\n";
+      std::cout << " --- src_access : "; write_access(std::cout, buf_barrier.src.access); std::cout << "\n";
       
-      std::cout << " --- dst_stages : "; dump_stages(buf_barrier.dst.stages); std::cout << "\n";
-      std::cout << " --- dst_access : "; dump_access(buf_barrier.dst.access); std::cout << "\n";
+      std::cout << " --- dst_stages : "; write_stages(std::cout, buf_barrier.dst.stages); std::cout << "\n";
+      std::cout << " --- dst_access : "; write_access(std::cout, buf_barrier.dst.access); std::cout << "\n";
     }
 
     std::cout << "Signal = ";
-    dump_stages(barrier.signal_mask);
+    write_stages(std::cout, barrier.signal_mask);
     std::cout << "\n";
   }
 
@@ -603,32 +1702,33 @@ namespace rendergraph {
       std::cout << " - Image " << "\n";
       std::cout << " --- id " << img_release.id.id.get_index() << "\n";
       std::cout << " --- mip = " << img_release.id.mip << " layer = " << img_release.id.layer << "\n";
+      std::cout << " --- mip_count = " << img_release.mip_count << " layer_count = " << img_release.layer_count << "\n";
       std::cout << " --- acquired at " << img_release.acquire_at << "\n";
-      std::cout << " --- src_stages : "; dump_stages(img_release.src.stages); std::cout << "\n";
-      std::cout << " --- src_access : "; dump_access(img_release.src.access); std::cout << "\n";
-      std::cout << " --- src_layout : "; dump_layout(img_release.src.layout); std::cout << "\n";
+      std::cout << " --- src_stages : "; write_stages(std::cout, img_release.src.stages); std::cout << "\n";
+      std::cout << " --- src_access : "; write_access(std::cout, img_release.src.access); std::cout << "\n";
+      std::cout << " --- src_layout : "; write_layout(std::cout, img_release.src.layout); std::cout << "\n";
       
-      std::cout << " --- dst_stages : "; dump_stages(img_release.dst.stages); std::cout << "\n";
-      std::cout << " --- dst_access : "; dump_access(img_release.dst.access); std::cout << "\n";
-      std::cout << " --- dst_layout : "; dump_layout(img_release.dst.layout); std::cout << "\n";
+      std::cout << " --- dst_stages : "; write_stages(std::cout, img_release.dst.stages); std::cout << "\n";
+      std::cout << " --- dst_access : "; write_access(std::cout, img_release.dst.access); std::cout << "\n";
+      std::cout << " --- dst_layout : "; write_layout(std::cout, img_release.dst.layout); std::cout << "\n";
     }
 
     for (const auto &buf_release : res.release_buffers) {
 
       std::cout << " - Memory barrier for buffer " << buf_release.id.get_index() << "\n";
       std::cout << " --- acquire at " << buf_release.acquire_at << "\n";
-      std::cout << " --- src_stages : "; dump_stages(buf_release.src.stages); std::cout << "\n";
-      std::cout << " --- src_access : "; dump_access(buf_release.src.access); std::cout << "\n";
+      std::cout << " --- src_stages : "; write_stages(std::cout, buf_release.src.stages); std::cout << "\n";
+      std::cout << " --- src_access : "; write_access(std::cout, buf_release.src.access); std::cout << "\n";
       
-      std::cout << " --- dst_stages : "; dump_stages(buf_release.dst.stages); std::cout << "\n";
-      std::cout << " --- dst_access : "; dump_access(buf_release.dst.access); std::cout << "\n";
+      std::cout << " --- dst_stages : "; write_stages(std::cout, buf_release.dst.stages); std::cout << "\n";
+      std::cout << " --- dst_access : "; write_access(std::cout, buf_release.dst.access); std::cout << "\n";
     }
   }
 
   void TrackingState::dump_task_resources() {
     for (uint32_t i = 0; i < task_resources.size(); i++) {
       std::cout << "Task " << i << "\n";
-      std::cout << "Stages "; dump_stages(task_resources[i].stages); std::cout << "\n";
+      std::cout << "Stages "; write_stages(std::cout, task_resources[i].stages); std::cout << "\n";
       dump_task_resources(task_resources[i]);
     }
   }
@@ -7,6 +7,10 @@
 #include <memory>
 #include <functional>
 #include <unordered_map>
+#include <unordered_set>
+#include <string>
+#include <string_view>
+#include <ostream>
 
 #include <gpu/gpu.hpp>
 
@@ -135,7 +139,9 @@ namespace rendergraph {
   
   struct ImageBarrierState {
     uint32_t wait_for = INVALID_BARRIER_INDEX;
-    ImageSubresourceId id; 
+    ImageSubresourceId id; //first subresource in range
+    uint32_t mip_count = 1;
+    uint32_t layer_count = 1;
     ImageSubresourceState src;
     ImageSubresourceState dst;
   };
@@ -149,7 +155,9 @@ namespace rendergraph {
 
   struct ImageReleaseState {
     uint32_t acquire_at = INVALID_BARRIER_INDEX;
-    ImageSubresourceId id; 
+    ImageSubresourceId id; //first subresource in range
+    uint32_t mip_count = 1;
+    uint32_t layer_count = 1;
     ImageSubresourceState src;
     ImageSubresourceState dst;
   };
@@ -162,6 +170,18 @@ namespace rendergraph {
     ImageSubresourceState dst;
   };
 
+  //subresources of an image with the same tracking state. Ranges of an image cover it without overlaps,
+  //they are split when a task accesses a part of a range and joined back when states become equal
+  struct ImageTrackingRange {
+    uint32_t mip = 0;
+    uint32_t layer = 0;
+    uint32_t mip_count = 1;
+    uint32_t layer_count = 1;
+    ImageTrackingState state;
+
+    bool contains(uint32_t m, uint32_t l) const { return m >= mip && m < mip + mip_count && l >= layer && l < layer + layer_count; }
+  };
+
   struct BufferTrackingState {
     uint32_t barrier_id = INVALID_BARRIER_INDEX;
     uint32_t last_access = INVALID_BARRIER_INDEX;
@@ -184,6 +204,30 @@ namespace rendergraph {
     bool is_empty() const { return buffer_barriers.empty() && image_barriers.empty(); }
   };
 
+  struct ImageLifetime {
+    uint32_t first_task = INVALID_BARRIER_INDEX;
+    uint32_t last_task = INVALID_BARRIER_INDEX;
+
+    bool is_empty() const { return first_task == INVALID_BARRIER_INDEX; }
+    bool overlaps(const ImageLifetime &l) const { return first_task <= l.last_task && l.first_task <= last_task; }
+  };
+
+  //last usage of aliased memory by previous image
+  struct AliasHandoff {
+    uint32_t task = INVALID_BARRIER_INDEX;
+    VkPipelineStageFlags stages = 0;
+    VkAccessFlags access = 0;
+  };
+
+  struct AliasingStats {
+    uint32_t transient_images = 0;
+    uint32_t memory_blocks = 0;
+    uint64_t requested_bytes = 0;
+    uint64_t allocated_bytes = 0;
+
+    uint64_t saved_bytes() const { return requested_bytes - allocated_bytes; }
+  };
+
   struct TaskResources {
     std::vector<BufferReleaseState> release_buffers;
     std::vector<ImageReleaseState> release_images;
@@ -193,7 +237,9 @@ namespace rendergraph {
   };
 
   struct GraphResources {
-    GraphResources() {}
+    //headless resources keep only descriptions, no driver objects are created
+    GraphResources(bool headless_mode = false) : headless {headless_mode} {}
+    ~GraphResources();
     
     ImageResourceId create_global_image(const ImageDescriptor &desc, gpu::ImageCreateOptions options = gpu::ImageCreateOptions::None);
     ImageResourceId create_global_image_ref(const gpu::ImagePtr &image);
@@ -202,6 +248,10 @@ namespace rendergraph {
 
     void remap(ImageResourceId src, ImageResourceId dst);
     void remap(BufferResourceId src, BufferResourceId dst);
+    //swaps tracking state now and driver images in apply_remaps, so the previous frame is recorded
+    //with old images while the next one is compiled
+    void remap_tracking(ImageResourceId src, ImageResourceId dst);
+    void apply_remaps();
 
     const VkImageCreateInfo &get_info(ImageResourceId id) const;
     gpu::ImagePtr &get_image(ImageResourceId id);
@@ -210,19 +260,61 @@ namespace rendergraph {
     const gpu::ImagePtr &get_image(ImageResourceId id) const;
 
     const BufferTrackingState &get_resource_state(BufferResourceId id) const;
+    //state of the range which contains subresource
     const ImageTrackingState &get_resource_state(ImageSubresourceId id) const;
     
     BufferTrackingState &get_resource_state(BufferResourceId id);
-    ImageTrackingState &get_resource_state(ImageSubresourceId id);
+
+    std::vector<ImageTrackingRange> &get_ranges(ImageResourceId id) { return global_images.at(id.index).ranges; }
+    const std::vector<ImageTrackingRange> &get_ranges(ImageResourceId id) const { return global_images.at(id.index).ranges; }
+    //after split each range of the image is either inside or outside of the mip and layer rect
+    void split_ranges(const ImageSubresourceId &base, uint32_t mip_count, uint32_t layer_count);
+    //joins neighbour ranges with equal states
+    void merge_ranges(ImageResourceId id);
+    //state of a range outside of frame, used to restore states of a cached frame
+    void set_range_state(const ImageSubresourceId &base, uint32_t mip_count, uint32_t layer_count, const ImageSubresourceState &state);
 
     gpu::DriverResourceID get_driver_id(BufferResourceId id) const { return global_buffers.at(id.index).vk_buffer.get_id(); }
     gpu::DriverResourceID get_driver_id(ImageResourceId id) const { return global_images.at(id.index).vk_image.get_id(); }
-  
+    
+    //persistent images keep their content between frames and never share memory
+    void mark_persistent(ImageResourceId id);
+    //next access transitions image from undefined layout, previous accesses are still waited
+    void discard_content(ImageResourceId id);
+    bool is_aliased(ImageResourceId id) const { return global_images.at(id.index).alias_block != INVALID_BARRIER_INDEX; }
+    bool is_persistent(ImageResourceId id) const { return global_images.at(id.index).persistent; }
+    
+    void track_image_use(ImageResourceId id, uint32_t task, VkAccessFlags access, VkPipelineStageFlags stages, bool first_access);
+    AliasHandoff acquire_alias_memory(ImageResourceId id, uint32_t task);
+    void flush_lifetimes();
+
+    void enable_aliasing(bool enable) { aliasing_enabled = enable; aliasing_dirty = true; }
+    void update_aliasing();
+    //re-plan recreates images, so it can't overlap recording of a frame
+    bool needs_aliasing_update() const;
+    const AliasingStats &get_aliasing_stats() const { return aliasing_stats; }
+    //lifetimes and persistent images are known after a few frames
+    bool is_warmed_up() const;
+
   private:
     
     struct GlobalImage {
       gpu::ImagePtr vk_image;
-      std::unique_ptr<ImageTrackingState[]> states;
+      std::vector<ImageTrackingRange> ranges;
+      VkImageCreateInfo info {};
+      
+      bool persistent = false;
+      uint32_t alias_block = INVALID_BARRIER_INDEX;
+      ImageLifetime frame_lifetime;
+      ImageLifetime observed_lifetime;
+    };
+
+    struct AliasBlock {
+      VmaAllocation memory {nullptr};
+      uint64_t size = 0;
+      uint32_t owner = INVALID_BARRIER_INDEX;
+      AliasHandoff usage;
+      AliasHandoff handoff;
     };
     
     struct GlobalBuffer {
@@ -232,12 +324,90 @@ namespace rendergraph {
 
     std::vector<GlobalImage> global_images;
     std::vector<GlobalBuffer> global_buffers;
+
+    std::vector<AliasBlock> alias_blocks;
+    std::vector<std::pair<uint32_t, uint32_t>> pending_remaps;
+    AliasingStats aliasing_stats;
+    uint32_t observed_frames = 0;
+    bool aliasing_enabled = true;
+    bool aliasing_dirty = true;
+    bool headless = false;
+
+    void reset_image(GlobalImage &image, gpu::ImagePtr &&ptr);
+  };
+
+  //flag names for debug output
+  void write_stages(std::ostream &out, VkPipelineStageFlags flags);
+  void write_access(std::ostream &out, VkAccessFlags flags);
+  void write_layout(std::ostream &out, VkImageLayout layout);
+  bool is_write_access(VkAccessFlags flags);
+
+  struct GraphCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+  };
+
+  struct AttachmentOpsState {
+    ImageSubresourceId id;
+    gpu::AttachmentOps ops;
+  };
+
+  //consecutive tasks with equal attachments and no barriers between them are recorded into one render pass
+  struct TaskRenderpass {
+    uint32_t first_attachment = 0;
+    uint32_t attachments_count = 0;
+    bool merge_with_next = false;
+  };
+
+  //attachment traffic removed from the frame by DONT_CARE ops, merged render passes are counted separately
+  struct RenderpassStats {
+    uint32_t renderpasses = 0;
+    uint32_t merged_tasks = 0; //tasks recorded into the render pass of the previous task
+    uint64_t load_bytes_avoided = 0;
+    uint64_t store_bytes_avoided = 0;
+
+    uint64_t bytes_avoided() const { return load_bytes_avoided + store_bytes_avoided; }
+  };
+
+  struct RenderpassPlan {
+    std::vector<TaskRenderpass> tasks;
+    std::vector<AttachmentOpsState> attachments;
+    RenderpassStats stats;
+  };
+
+  //accesses are recorded while tasks are added and resolved in flush 
+  struct ImageInput {
+    uint32_t task;
+    ImageSubresourceId id;
+    uint32_t mip_count;
+    uint32_t layer_count;
+    ImageSubresourceState state;
+  };
+
+  //state of image range at the end of compiled frame
+  struct ImageRangeState {
+    ImageSubresourceId id;
+    uint32_t mip_count;
+    uint32_t layer_count;
+    ImageSubresourceState state;
+  };
+
+  struct BufferInput {
+    uint32_t task;
+    BufferResourceId id;
+    BufferState state;
+  };
+
+  struct GraphInputs {
+    std::vector<ImageInput> images;
+    std::vector<BufferInput> buffers;
   };
 
   struct TrackingState {
     void add_input(GraphResources &resources, const BufferResourceId &id, const BufferState &state);
     void add_input(GraphResources &resources, const ImageSubresourceId &id, const ImageSubresourceState &state);
-    void next_task() { index++; }
+    void add_input(GraphResources &resources, const ImageSubresourceId &base, uint32_t mip_count, uint32_t layer_count, const ImageSubresourceState &state);
+    void next_task(std::string_view name);
 
     void flush(GraphResources &resources);
     void gen_barriers();
@@ -248,16 +418,88 @@ namespace rendergraph {
 
     const std::vector<Barrier> &get_barriers() { return barriers; }
     std::vector<Barrier> take_barriers() { return std::move(barriers); }
+    //for each task - earlier tasks which must complete before it starts
+    std::vector<std::vector<uint32_t>> take_dependencies() { return std::move(dependencies); }
+    
+    const GraphCacheStats &get_cache_stats() const { return cache_stats; }
+    
+    void enable_culling(bool enable) { culling_enabled = enable; cache_valid = false; }
+    const std::vector<uint32_t> &get_culled_tasks() const { return culled_tasks; }
+    //valid until the next flush
+    const RenderpassPlan &get_renderpasses() const { return renderpasses; }
+
+    //lint declared accesses when the graph is compiled. Cached plans keep warnings of the compiled frame
+    void enable_validation(bool enable) { validation_enabled = enable; cache_valid = false; }
+    const std::vector<std::string> &get_validation_warnings() const { return validation_warnings; }
+
+    //the next flush compiles the graph and keeps inputs of live tasks
+    void request_inputs() { inputs_requested = true; cache_valid = false; }
+    bool take_inputs(GraphInputs &out);
     
   private:
     uint32_t index = 0;
     std::vector<BufferResourceId> dirty_buffers;
-    std::vector<ImageSubresourceId> dirty_images;
+    std::vector<ImageResourceId> dirty_images;
     std::vector<TaskResources> task_resources;
     std::vector<Barrier> barriers;
+    std::vector<std::vector<uint32_t>> dependencies;
+
+    std::vector<ImageInput> image_inputs;
+    std::vector<BufferInput> buffer_inputs;
+    //resource states at the end of compiled frame
+    std::vector<ImageRangeState> final_images;
+    std::vector<std::pair<BufferResourceId, BufferState>> final_buffers;
+
+    //frame graph signature includes initial resource states, so equal signatures produce equal barriers
+    std::size_t signature = 0;
+    std::size_t prev_signature = 0;
+    std::size_t cached_signature = 0;
+    bool cache_valid = false;
+    std::vector<Barrier> cached_barriers;
+    std::vector<std::vector<uint32_t>> cached_dependencies;
+    std::vector<ImageRangeState> cached_final_images;
+    std::vector<std::pair<BufferResourceId, BufferState>> cached_final_buffers;
+    std::vector<uint32_t> cached_culled_tasks;
+    RenderpassPlan cached_renderpasses;
+    GraphCacheStats cache_stats;
+    //signatures may collide, so inputs and initial states of the cached frame are compared on match
+    std::vector<ImageInput> cached_image_inputs;
+    std::vector<BufferInput> cached_buffer_inputs;
+    std::vector<uint32_t> cached_states;
+    std::vector<uint32_t> frame_states;
+    std::vector<bool> hashed_images;
+
+    bool culling_enabled = false;
+    std::vector<uint32_t> culled_tasks;
+    RenderpassPlan renderpasses;
+
+    bool validation_enabled = false;
+    std::vector<std::string> task_names;
+    std::vector<std::string> validation_warnings;
+    //each warning is printed once
+    std::unordered_set<std::string> reported_warnings;
+
+    bool inputs_requested = false;
+    bool inputs_kept = false;
+    GraphInputs kept_inputs;
+
+    void track_input(GraphResources &resources, const BufferResourceId &id, const BufferState &state);
+    void track_input(GraphResources &resources, const ImageInput &input);
+    void track_range(GraphResources &resources, ImageResourceId id, ImageTrackingRange &range, const ImageSubresourceState &state);
+    void compile(GraphResources &resources);
+    void cull_tasks(GraphResources &resources);
+    void validate(GraphResources &resources);
+    void add_warning(std::string &&warning);
+    //states are hashed at flush, inputs may be added while the previous frame still owns resource mappings
+    void hash_resource_states(GraphResources &resources);
+    void add_state(uint32_t value);
+    bool is_cached_frame() const;
+    void gen_dependencies();
+    void gen_renderpasses(GraphResources &resources, uint32_t tasks_count);
 
     void dump_barrier(const Barrier &barrier);
     void dump_task_resources(const TaskResources &res);
+    void acquire_aliased(GraphResources &resources, ImageResourceId id, ImageTrackingState &track);
   };
 
   
@@ -0,0 +1,48 @@
+#include "task_arena.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace rendergraph {
+
+  void *TaskArena::allocate(std::size_t size, std::size_t alignment) {
+    while (current_block < blocks.size()) {
+      auto &block = blocks[current_block];
+      auto base = reinterpret_cast<uintptr_t>(block.memory.get());
+      auto start = (base + offset + alignment - 1) & ~uintptr_t(alignment - 1);
+
+      if (start + size <= base + block.size) {
+        used_bytes += (start + size) - (base + offset);
+        offset = start + size - base;
+        return reinterpret_cast<void*>(start);
+      }
+
+      current_block++;
+      offset = 0;
+    }
+
+    //oversized objects get own block
+    auto new_size = std::max(block_size, size + alignment);
+    blocks.push_back(Block {std::unique_ptr<uint8_t[]> {new uint8_t[new_size]}, new_size});
+    reserved_bytes += new_size;
+    heap_allocations++;
+
+    current_block = blocks.size() - 1;
+    offset = 0;
+    return allocate(size, alignment);
+  }
+
+  const char *TaskArena::copy_string(std::string_view str) {
+    auto ptr = static_cast<char*>(allocate(str.size() + 1, alignof(char)));
+    std::memcpy(ptr, str.data(), str.size());
+    ptr[str.size()] = '\0';
+    return ptr;
+  }
+
+  void TaskArena::reset() {
+    current_block = 0;
+    offset = 0;
+    used_bytes = 0;
+  }
+
+}
@@ -0,0 +1,56 @@
+#ifndef RENDERGRAPH_TASK_ARENA_HPP_INCLUDED
+#define RENDERGRAPH_TASK_ARENA_HPP_INCLUDED
+
+#include <cinttypes>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace rendergraph {
+
+  //linear allocator for objects living one frame. Memory blocks are kept after reset,
+  //so frames with the same tasks don't touch the heap
+  struct TaskArena {
+    TaskArena(std::size_t default_block_size = 64 * 1024) : block_size {default_block_size} {}
+
+    void *allocate(std::size_t size, std::size_t alignment);
+    const char *copy_string(std::string_view str);
+
+    template <typename T, typename... Args>
+    T *create(Args&&... args) {
+      void *ptr = allocate(sizeof(T), alignof(T));
+      return new (ptr) T {std::forward<Args>(args)...};
+    }
+
+    //objects must be destroyed before reset
+    void reset();
+
+    std::size_t get_used_bytes() const { return used_bytes; }
+    std::size_t get_reserved_bytes() const { return reserved_bytes; }
+    uint64_t get_heap_allocations() const { return heap_allocations; }
+
+    TaskArena(const TaskArena &) = delete;
+    TaskArena &operator=(const TaskArena &) = delete;
+
+  private:
+    struct Block {
+      std::unique_ptr<uint8_t[]> memory;
+      std::size_t size = 0;
+    };
+
+    std::size_t block_size = 0;
+    std::vector<Block> blocks;
+    uint32_t current_block = 0;
+    std::size_t offset = 0;
+
+    std::size_t used_bytes = 0;
+    std::size_t reserved_bytes = 0;
+    uint64_t heap_allocations = 0;
+  };
+
+}
+
+#endif
@@ -0,0 +1,137 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+
+#include "rendergraph/rendergraph.hpp"
+
+//Builds synthetic graphs of N tasks over M images with K mips and measures CPU cost of the graph compile.
+//Runs without device: rendergraph_bench [tasks] [images] [mips] [frames]
+
+struct BenchConfig {
+  uint32_t tasks = 256;
+  uint32_t images = 64;
+  uint32_t mips = 4;
+  uint32_t frames = 500;
+};
+
+constexpr uint32_t READS_PER_TASK = 2;
+
+struct BenchTask {};
+
+struct FrameTimings {
+  std::vector<double> build_us;
+  std::vector<double> submit_us;
+};
+
+static void build_graph(rendergraph::RenderGraph &graph, const BenchConfig &cfg, const std::vector<rendergraph::ImageResourceId> &images, const std::vector<std::string> &names, uint32_t seed) {
+  std::mt19937 rng {seed};
+
+  for (uint32_t t = 0; t < cfg.tasks; t++) {
+    uint32_t target = t % cfg.images;
+    uint32_t mip = (t / cfg.images) % cfg.mips;
+
+    uint32_t reads[READS_PER_TASK];
+    uint32_t reads_count = 0;
+    for (uint32_t r = 0; r < READS_PER_TASK && cfg.images > 1; r++) {
+      uint32_t src = rng() % (cfg.images - 1);
+      reads[reads_count++] = (src >= target)? src + 1 : src;
+    }
+    bool last = (t + 1 == cfg.tasks);
+
+    graph.add_task<BenchTask>(names[t],
+      [&](BenchTask &, rendergraph::RenderGraphBuilder &input){
+        input.use_storage_image(images[target], VK_SHADER_STAGE_COMPUTE_BIT, mip, 0);
+        for (uint32_t r = 0; r < reads_count; r++) {
+          input.sample_image(images[reads[r]], VK_SHADER_STAGE_COMPUTE_BIT);
+        }
+        if (last) {
+          input.prepare_backbuffer();
+        }
+      },
+      [](BenchTask &, rendergraph::RenderResources &, gpu::CmdContext &){});
+  }
+}
+
+static FrameTimings run_frames(const BenchConfig &cfg, bool vary_graph) {
+  rendergraph::RenderGraph graph {rendergraph::HeadlessConfig {}};
+
+  std::vector<rendergraph::ImageResourceId> images;
+  for (uint32_t i = 0; i < cfg.images; i++) {
+    images.push_back(graph.create_image(rendergraph::ImageDescriptor {
+      VK_IMAGE_TYPE_2D,
+      VK_FORMAT_R16G16B16A16_SFLOAT,
+      VK_IMAGE_ASPECT_COLOR_BIT,
+      VK_IMAGE_TILING_OPTIMAL,
+      VK_IMAGE_USAGE_STORAGE_BIT|VK_IMAGE_USAGE_SAMPLED_BIT,
+      1024,
+      1024,
+      1,
+      cfg.mips,
+      1
+    }));
+  }
+
+  std::vector<std::string> names;
+  for (uint32_t t = 0; t < cfg.tasks; t++) {
+    names.push_back("task_" + std::to_string(t));
+  }
+
+  FrameTimings timings;
+  for (uint32_t frame = 0; frame < cfg.frames; frame++) {
+    auto start = std::chrono::steady_clock::now();
+    build_graph(graph, cfg, images, names, vary_graph? frame : 0);
+    auto built = std::chrono::steady_clock::now();
+    graph.submit();
+    auto end = std::chrono::steady_clock::now();
+
+    timings.build_us.push_back(std::chrono::duration<double, std::micro>(built - start).count());
+    timings.submit_us.push_back(std::chrono::duration<double, std::micro>(end - built).count());
+  }
+
+  const auto &stats = graph.get_cache_stats();
+  const auto &alloc_stats = graph.get_task_alloc_stats();
+  std::cout << (vary_graph? "varying graph" : "static graph") << ", cache hits " << stats.hits << ", misses " << stats.misses << "\n";
+  std::cout << "  task heap allocations: last frame " << alloc_stats.frame_heap_allocations
+    << ", total " << alloc_stats.total_heap_allocations
+    << ", arena " << alloc_stats.frame_arena_bytes << "/" << alloc_stats.arena_reserved_bytes << " bytes\n";
+  return timings;
+}
+
+static void report(const char *name, std::vector<double> samples) {
+  if (samples.empty()) {
+    return;
+  }
+
+  std::sort(samples.begin(), samples.end());
+  double sum = 0.0;
+  for (auto s : samples) {
+    sum += s;
+  }
+
+  std::cout << "  " << name
+    << ": avg " << sum / samples.size()
+    << " us, median " << samples[samples.size()/2]
+    << " us, min " << samples.front()
+    << " us, max " << samples.back() << " us\n";
+}
+
+int main(int argc, char **argv) {
+  BenchConfig cfg {};
+  uint32_t *params[] {&cfg.tasks, &cfg.images, &cfg.mips, &cfg.frames};
+
+  for (int i = 1; i < argc && i <= 4; i++) {
+    *params[i - 1] = std::max(std::stoul(argv[i]), 1ul);
+  }
+
+  std::cout << "Rendergraph compile: " << cfg.tasks << " tasks, " << cfg.images << " images, " << cfg.mips << " mips, " << cfg.frames << " frames\n";
+
+  for (bool vary_graph : {false, true}) {
+    auto timings = run_frames(cfg, vary_graph);
+    report("build", timings.build_us);
+    report("submit", timings.submit_us);
+  }
+  return 0;
+}
@@ -0,0 +1,274 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+#include "rendergraph/resources.hpp"
+#include "rendergraph/rendergraph.hpp"
+
+//Compiles small graphs on headless resources and checks the generated barriers, culling and submit batches.
+//Runs without device: rendergraph_test
+
+using namespace rendergraph;
+
+#define CHECK(cond) if (!(cond)) { throw std::runtime_error {std::string {__FILE__} + ":" + std::to_string(__LINE__) + " " + #cond}; }
+
+static const ImageSubresourceState STORAGE_WRITE {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL};
+static const ImageSubresourceState TRANSFER_WRITE {VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL};
+static const ImageSubresourceState SAMPLED {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+static const BufferState BUFFER_WRITE {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT};
+
+static ImageResourceId create_image(GraphResources &resources, uint32_t mips, uint32_t layers) {
+  return resources.create_global_image(ImageDescriptor {
+    VK_IMAGE_TYPE_2D,
+    VK_FORMAT_R16G16B16A16_SFLOAT,
+    VK_IMAGE_ASPECT_COLOR_BIT,
+    VK_IMAGE_TILING_OPTIMAL,
+    VK_IMAGE_USAGE_STORAGE_BIT|VK_IMAGE_USAGE_SAMPLED_BIT|VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+    256,
+    256,
+    1,
+    mips,
+    layers
+  });
+}
+
+static void add_task(TrackingState &tracking, GraphResources &resources, ImageResourceId id, uint32_t mip, uint32_t mip_count, uint32_t layer, uint32_t layer_count, const ImageSubresourceState &state) {
+  tracking.add_input(resources, ImageSubresourceId {id, mip, layer}, mip_count, layer_count, state);
+  tracking.next_task("task");
+}
+
+static void add_buffer_task(TrackingState &tracking, GraphResources &resources, BufferResourceId id, const BufferState &state) {
+  tracking.add_input(resources, id, state);
+  tracking.next_task("buffer_task");
+}
+
+static std::vector<Barrier> compile(TrackingState &tracking, GraphResources &resources) {
+  tracking.flush(resources);
+  auto barriers = tracking.take_barriers();
+  tracking.take_dependencies();
+  tracking.clear();
+  return barriers;
+}
+
+static void check_barrier(const ImageBarrierState &barrier, uint32_t mip, uint32_t mip_count, uint32_t layer, uint32_t layer_count, VkImageLayout src, VkImageLayout dst) {
+  CHECK(barrier.id.mip == mip && barrier.mip_count == mip_count);
+  CHECK(barrier.id.layer == layer && barrier.layer_count == layer_count);
+  CHECK(barrier.src.layout == src && barrier.dst.layout == dst);
+}
+
+static void test_write_then_sample() {
+  GraphResources resources {true};
+  TrackingState tracking;
+  auto image = create_image(resources, 4, 1);
+
+  add_task(tracking, resources, image, 0, 1, 0, 1, STORAGE_WRITE);
+  add_task(tracking, resources, image, 0, 4, 0, 1, SAMPLED);
+  auto barriers = compile(tracking, resources);
+
+  CHECK(barriers.size() == 2);
+  CHECK(barriers[0].image_barriers.size() == 2);
+  check_barrier(barriers[0].image_barriers[0], 0, 1, 0, 1, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+  check_barrier(barriers[0].image_barriers[1], 1, 3, 0, 1, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+  CHECK(barriers[1].image_barriers.size() == 1);
+  check_barrier(barriers[1].image_barriers[0], 0, 1, 0, 1, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+  CHECK(barriers[1].image_barriers[0].wait_for == 0);
+  CHECK(barriers[1].max_wait_task_index == 0);
+
+  //equal final layouts are joined back
+  CHECK(resources.get_ranges(image).size() == 1);
+}
+
+static void test_full_range_barrier() {
+  GraphResources resources {true};
+  TrackingState tracking;
+  auto image = create_image(resources, 4, 6);
+
+  add_task(tracking, resources, image, 0, 4, 0, 6, TRANSFER_WRITE);
+  add_task(tracking, resources, image, 0, 4, 0, 6, SAMPLED);
+  auto barriers = compile(tracking, resources);
+
+  CHECK(barriers.size() == 2);
+  CHECK(barriers[0].image_barriers.size() == 1);
+  check_barrier(barriers[0].image_barriers[0], 0, 4, 0, 6, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+  CHECK(barriers[1].image_barriers.size() == 1);
+  check_barrier(barriers[1].image_barriers[0], 0, 4, 0, 6, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+}
+
+static void test_partial_layers() {
+  GraphResources resources {true};
+  TrackingState tracking;
+  auto image = create_image(resources, 4, 6);
+
+  add_task(tracking, resources, image, 0, 4, 0, 6, TRANSFER_WRITE);
+  add_task(tracking, resources, image, 0, 4, 2, 1, SAMPLED);
+  add_task(tracking, resources, image, 0, 4, 0, 6, SAMPLED);
+  auto barriers = compile(tracking, resources);
+
+  CHECK(barriers.size() == 3);
+  CHECK(barriers[0].image_barriers.size() == 1);
+  check_barrier(barriers[0].image_barriers[0], 0, 4, 0, 6, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+  CHECK(barriers[1].image_barriers.size() == 1);
+  check_barrier(barriers[1].image_barriers[0], 0, 4, 2, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+  //layer 2 is already readable
+  CHECK(barriers[2].image_barriers.size() == 2);
+  check_barrier(barriers[2].image_barriers[0], 0, 4, 0, 2, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+  check_barrier(barriers[2].image_barriers[1], 0, 4, 3, 3, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+  CHECK(resources.get_ranges(image).size() == 1);
+}
+
+static void test_cached_plan() {
+  GraphResources resources {true};
+  TrackingState tracking;
+  auto image = create_image(resources, 4, 1);
+
+  //signature changes when resources are warmed up, plan is cached after two equal frames
+  for (uint32_t frame = 0; frame < 6; frame++) {
+    add_task(tracking, resources, image, 0, 1, 0, 1, STORAGE_WRITE);
+    add_task(tracking, resources, image, 0, 4, 0, 1, SAMPLED);
+    auto barriers = compile(tracking, resources);
+
+    if (frame == 0) {
+      continue;
+    }
+    //layouts are carried from the previous frame
+    CHECK(barriers.size() == 2);
+    CHECK(barriers[0].image_barriers.size() == 2);
+    check_barrier(barriers[0].image_barriers[0], 0, 1, 0, 1, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL);
+    check_barrier(barriers[0].image_barriers[1], 1, 3, 0, 1, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    CHECK(barriers[1].image_barriers.size() == 1);
+    check_barrier(barriers[1].image_barriers[0], 0, 1, 0, 1, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+  }
+
+  CHECK(tracking.get_cache_stats().hits == 1);
+  CHECK(tracking.get_cache_stats().misses == 5);
+
+  //different graph isn't taken from cache
+  add_task(tracking, resources, image, 0, 4, 0, 1, SAMPLED);
+  auto barriers = compile(tracking, resources);
+  CHECK(tracking.get_cache_stats().misses == 6);
+  CHECK(barriers.size() == 1);
+  CHECK(barriers[0].image_barriers.size() == 1);
+  check_barrier(barriers[0].image_barriers[0], 0, 4, 0, 1, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+}
+
+static void test_cull_unread_writes() {
+  GraphResources resources {true};
+  TrackingState tracking;
+  tracking.enable_culling(true);
+  tracking.request_inputs();
+
+  auto used = create_image(resources, 1, 1);
+  auto unread = create_image(resources, 1, 1);
+  auto exported = create_image(resources, 1, 1);
+  auto chain = create_image(resources, 1, 1);
+  auto chain_end = create_image(resources, 1, 1);
+  auto buffer = resources.create_global_buffer(BufferDescriptor {256, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_ONLY});
+  resources.mark_persistent(exported);
+
+  add_task(tracking, resources, used, 0, 1, 0, 1, STORAGE_WRITE);   //0 - read by 3
+  add_task(tracking, resources, unread, 0, 1, 0, 1, STORAGE_WRITE); //1 - culled
+  add_task(tracking, resources, chain, 0, 1, 0, 1, STORAGE_WRITE);  //2 - read only by culled task
+  tracking.add_input(resources, ImageSubresourceId {used, 0, 0}, 1, 1, SAMPLED);
+  add_task(tracking, resources, exported, 0, 1, 0, 1, STORAGE_WRITE); //3 - persistent image is kept
+  tracking.add_input(resources, ImageSubresourceId {chain, 0, 0}, 1, 1, SAMPLED);
+  add_task(tracking, resources, chain_end, 0, 1, 0, 1, STORAGE_WRITE); //4 - culled
+  add_buffer_task(tracking, resources, buffer, BUFFER_WRITE); //5 - buffer writers are kept
+  auto barriers = compile(tracking, resources);
+
+  const auto &culled = tracking.get_culled_tasks();
+  CHECK(culled.size() == 3);
+  CHECK(culled[0] == 1 && culled[1] == 2 && culled[2] == 4);
+
+  //inputs of live tasks are renumbered 0, 1, 2
+  GraphInputs inputs;
+  CHECK(tracking.take_inputs(inputs));
+  CHECK(inputs.images.size() == 3);
+  CHECK(inputs.images[0].task == 0 && inputs.images[0].id.id == used);
+  CHECK(inputs.images[1].task == 1 && inputs.images[1].id.id == used);
+  CHECK(inputs.images[2].task == 1 && inputs.images[2].id.id == exported);
+  CHECK(inputs.buffers.size() == 1);
+  CHECK(inputs.buffers[0].task == 2);
+
+  //barriers use remapped indices too
+  CHECK(barriers.size() >= 2);
+  bool found = false;
+  for (const auto &barrier : barriers[1].image_barriers) {
+    if (barrier.id.id == used) {
+      check_barrier(barrier, 0, 1, 0, 1, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+      CHECK(barrier.wait_for == 0);
+      found = true;
+    }
+  }
+  CHECK(found);
+}
+
+static void test_submit_batches() {
+  const auto MAIN = QueueType::Main;
+  const auto ASYNC = QueueType::AsyncCompute;
+  std::vector<std::pair<uint32_t, uint32_t>> ranges;
+  std::vector<SubmitBatch> batches;
+
+  //async tasks 1-2 wait for task 0, task 4 waits for async task 2
+  build_submit_batches({MAIN, ASYNC, ASYNC, MAIN, MAIN}, {{}, {0}, {1}, {0}, {2}}, ranges, batches);
+  CHECK(batches.size() == 4);
+  CHECK(ranges.size() == 4);
+  CHECK(ranges[0] == std::make_pair(0u, 1u) && ranges[1] == std::make_pair(1u, 3u));
+  CHECK(ranges[2] == std::make_pair(3u, 4u) && ranges[3] == std::make_pair(4u, 5u));
+  CHECK(batches[0].queue == MAIN && !batches[0].wait_batch.has_value());
+  CHECK(batches[1].queue == ASYNC && batches[1].wait_batch == 0u);
+  CHECK(batches[2].queue == MAIN && !batches[2].wait_batch.has_value());
+  CHECK(batches[3].queue == MAIN && batches[3].wait_batch == 1u);
+  for (uint32_t i = 0; i < batches.size(); i++) {
+    CHECK(batches[i].first_recorder == i && batches[i].recorders_count == 1);
+  }
+
+  //batch which was already waited by the queue doesn't split it again
+  ranges.clear();
+  batches.clear();
+  build_submit_batches({MAIN, ASYNC, MAIN, MAIN}, {{}, {0}, {1}, {1}}, ranges, batches);
+  CHECK(batches.size() == 3);
+  CHECK(ranges[2] == std::make_pair(2u, 4u));
+  CHECK(batches[2].wait_batch == 1u);
+
+  //async work at the end is waited by an empty main queue batch which signals the frame fence
+  ranges.clear();
+  batches.clear();
+  build_submit_batches({MAIN, ASYNC}, {{}, {0}}, ranges, batches);
+  CHECK(batches.size() == 3);
+  CHECK(ranges.size() == 2);
+  CHECK(batches[2].queue == MAIN && batches[2].recorders_count == 0);
+  CHECK(batches[2].first_recorder == 2 && batches[2].wait_batch == 1u);
+}
+
+int main() {
+  struct Test {
+    const char *name;
+    void (*run)();
+  };
+
+  const Test tests[] {
+    {"write_then_sample", test_write_then_sample},
+    {"full_range_barrier", test_full_range_barrier},
+    {"partial_layers", test_partial_layers},
+    {"cached_plan", test_cached_plan},
+    {"cull_unread_writes", test_cull_unread_writes},
+    {"submit_batches", test_submit_batches}
+  };
+
+  int failed = 0;
+  for (const auto &test : tests) {
+    try {
+      test.run();
+      std::cout << "[ OK ] " << test.name << "\n";
+    } catch (const std::exception &e) {
+      std::cout << "[FAIL] " << test.name << ": " << e.what() << "\n";
+      failed++;
+    }
+  }
+  return failed? 1 : 0;
+}
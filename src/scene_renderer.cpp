@@ -39,8 +39,9 @@ Gbuffer::Gbuffer(rendergraph::RenderGraph &graph, uint32_t width, uint32_t heigh
   downsampled_velocity_vectors = graph.create_image(VK_IMAGE_TYPE_2D, velocity_info, tiling, color_usage);
   
   material = graph.create_image(VK_IMAGE_TYPE_2D, mat_info, tiling, color_usage);
-  depth = graph.create_image(VK_IMAGE_TYPE_2D, depth_info, tiling, depth_usage);
-  prev_depth = graph.create_image(VK_IMAGE_TYPE_2D, depth_info, tiling, depth_usage|VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+  depth_history = graph.create_history_image(VK_IMAGE_TYPE_2D, depth_info, tiling, depth_usage|VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+  depth = graph.get_current(depth_history);
+  prev_depth = graph.get_previous(depth_history);
 }
 
 struct GbufConst {
@@ -188,13 +189,9 @@ void SceneRenderer::draw_taa(rendergraph::RenderGraph &graph, const Gbuffer &gbu
       auto blk = cmd.allocate_ubo<GbufConst>();
       *blk.ptr = consts;
 
-      auto set = resources.allocate_set(opaque_taa_pipeline, 0);
-
-      gpu::write_set(set, 
+      resources.bind_set(cmd, opaque_taa_pipeline, 0, {blk.offset},
         gpu::UBOBinding {0, cmd.get_ubo_pool(), blk},
         gpu::SSBOBinding {1, resources.get_buffer(transform_buffer)});
-
-      cmd.bind_descriptors_graphics(0, {set}, {blk.offset});
       cmd.bind_descriptors_graphics(1, {bindless_textures}, {});
 
       for (const auto &draw_call : draw_calls) {
@@ -253,7 +250,7 @@ void SceneRenderer::render_shadow(rendergraph::RenderGraph &graph, const glm::ma
       auto block = cmd.allocate_ubo<glm::mat4>();
       *block.ptr = shadow_mvp;
 
-      gpu::write_set(set, 
+      gpu::write_set(set, shadow_pipeline.get_update_template(0), 
         gpu::UBOBinding {0, cmd.get_ubo_pool(), block},
         gpu::SSBOBinding {1, resources.get_buffer(transform_buffer)});
 
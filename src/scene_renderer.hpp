@@ -17,6 +17,7 @@ struct Gbuffer {
   rendergraph::ImageResourceId material;
   rendergraph::ImageResourceId depth;
   rendergraph::ImageResourceId prev_depth;
+  rendergraph::HistoryImageId depth_history;
   rendergraph::ImageResourceId velocity_vectors;
   rendergraph::ImageResourceId downsampled_velocity_vectors;
 
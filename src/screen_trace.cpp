@@ -73,7 +73,7 @@ void ScreenSpaceTrace::add_main_pass(
 
       auto set = resources.allocate_set(trace_pipeline, 0);
     
-      gpu::write_set(set,
+      gpu::write_set(set, trace_pipeline.get_update_template(0),
         gpu::TextureBinding {0, resources.get_view(input.depth), sampler},
         gpu::TextureBinding {1, resources.get_view(input.norm), sampler},
         gpu::TextureBinding {2, resources.get_view(input.color), sampler},
@@ -117,7 +117,7 @@ void ScreenSpaceTrace::add_filter_pass(
     [=](PassData &input, rendergraph::RenderResources &resources, gpu::CmdContext &cmd){
       auto set = resources.allocate_set(filter_pipeline, 0);
     
-      gpu::write_set(set,
+      gpu::write_set(set, filter_pipeline.get_update_template(0),
         gpu::TextureBinding {0, resources.get_view(input.raw), sampler},
         gpu::TextureBinding {1, resources.get_view(input.depth), sampler},
         gpu::StorageTextureBinding {2, resources.get_view(input.filtered)}
@@ -164,7 +164,7 @@ void ScreenSpaceTrace::add_accumulate_pass(
     [=](PassData &input, rendergraph::RenderResources &resources, gpu::CmdContext &cmd){
       auto set = resources.allocate_set(accum_pipeline, 0);
     
-      gpu::write_set(set,
+      gpu::write_set(set, accum_pipeline.get_update_template(0),
         gpu::TextureBinding {0, resources.get_view(input.depth), sampler},
         gpu::TextureBinding {1, resources.get_view(input.prev_depth), sampler},
         gpu::TextureBinding {2, resources.get_view(input.filtered), sampler},
@@ -1,4 +1,5 @@
 #version 460 
+#include <bindless.glsl>
 #include <gbuffer_encode.glsl>
 #include <screen_trace.glsl>
 #include <brdf.glsl>
@@ -7,12 +8,7 @@ layout (location = 0) out vec4 out_color;
 
 layout (location = 0) in vec2 screen_uv;
 
-layout (set = 0, binding = 0) uniform sampler2D albedo_tex;
-layout (set = 0, binding = 1) uniform sampler2D normal_tex;
-layout (set = 0, binding = 2) uniform sampler2D material_tex;
-layout (set = 0, binding = 3) uniform sampler2D depth_tex;
-
-layout (set = 0, binding = 4) uniform Constants {
+layout (set = 0, binding = 0) uniform Constants {
   mat4 inverse_camera;
   mat4 camera_mat;
   mat4 shadow_mvp;
@@ -22,16 +18,29 @@ layout (set = 0, binding = 4) uniform Constants {
   float zfar;
 };
 
-layout (set = 0, binding = 5) uniform sampler2D shadow_map;
-layout (set = 0, binding = 6) uniform sampler2D occlusion_tex;
-layout (set = 0, binding = 7) uniform sampler2D brdf_tex;
-layout (set = 0, binding = 8) uniform sampler2D reflections_tex;
-
 layout (push_constant) uniform PushConsts {
   vec2 min_max_rougness;
   uint show_ao;
+  uint albedo_index;
+  uint normal_index;
+  uint material_index;
+  uint depth_index;
+  uint shadow_index;
+  uint occlusion_index;
+  uint brdf_index;
+  uint reflections_index;
+  uint sampler_index;
 };
 
+#define albedo_tex BINDLESS_SAMPLER2D(albedo_index, sampler_index)
+#define normal_tex BINDLESS_SAMPLER2D(normal_index, sampler_index)
+#define material_tex BINDLESS_SAMPLER2D(material_index, sampler_index)
+#define depth_tex BINDLESS_SAMPLER2D(depth_index, sampler_index)
+#define shadow_map BINDLESS_SAMPLER2D(shadow_index, sampler_index)
+#define occlusion_tex BINDLESS_SAMPLER2D(occlusion_index, sampler_index)
+#define brdf_tex BINDLESS_SAMPLER2D(brdf_index, sampler_index)
+#define reflections_tex BINDLESS_SAMPLER2D(reflections_index, sampler_index)
+
 vec4 sample_ocllusion_ssr(float depth, vec2 screen_uv);
 
 const vec3 LIGHT_POS = vec3(-1.85867, 5.81832, -0.247114);
@@ -39,7 +48,8 @@ const vec3 LIGHT_RADIANCE = vec3(0.1, 0.1, 0.1);
 #define USE_OCCLUSION 1
 
 void main() {
-  vec3 normal = sample_gbuffer_normal(normal_tex, screen_uv);
+  //sample_gbuffer_normal takes sampler2D argument, constructed samplers can't be passed to functions
+  vec3 normal = decode_normal(texture(normal_tex, screen_uv).xy);
   vec3 albedo = texture(albedo_tex, screen_uv).xyz;
   vec4 material = texture(material_tex, screen_uv);
   float depth = textureLod(depth_tex, screen_uv, 0).r;
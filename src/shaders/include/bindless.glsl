@@ -0,0 +1,26 @@
+#ifndef BINDLESS_GLSL_INCLUDED
+#define BINDLESS_GLSL_INCLUDED
+
+#extension GL_EXT_nonuniform_qualifier : require
+#extension GL_EXT_samplerless_texture_functions : require
+
+//global heap, must match gpu/bindless.hpp
+#define BINDLESS_SET 3
+
+layout (set = BINDLESS_SET, binding = 0) uniform texture2D g_textures[];
+layout (set = BINDLESS_SET, binding = 1) uniform sampler g_samplers[];
+
+//sampled images of other view types alias binding 0
+#define BINDLESS_TEXTURES(type, name) \
+  layout (set = BINDLESS_SET, binding = 0) uniform type name[]
+
+//storage images alias binding 2 with the format and type of the shader
+#define BINDLESS_STORAGE_IMAGES(fmt, type, name) \
+  layout (set = BINDLESS_SET, binding = 2, fmt) uniform writeonly type name[]
+
+#define BINDLESS_RW_STORAGE_IMAGES(fmt, type, name) \
+  layout (set = BINDLESS_SET, binding = 2, fmt) uniform type name[]
+
+#define BINDLESS_SAMPLER2D(tex, smp) sampler2D(g_textures[tex], g_samplers[smp])
+
+#endif
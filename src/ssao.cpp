@@ -78,7 +78,7 @@ void SSAOPass::draw(rendergraph::RenderGraph &graph, rendergraph::ImageResourceI
 
       auto set = resources.allocate_set(pipeline, 0);
     
-      gpu::write_set(set,
+      gpu::write_set(set, pipeline.get_update_template(0),
         gpu::TextureBinding {0, resources.get_view(input.depth), sampler},
         gpu::UBOBinding {1, cmd.get_ubo_pool(), block});
       
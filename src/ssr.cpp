@@ -50,15 +50,6 @@ void add_ssr_pass(
       auto block = cmd.allocate_ubo<SSRParams>();
       *block.ptr = params;
 
-      auto set = resources.allocate_set(pipeline, 0);
-
-      gpu::write_set(set,
-        gpu::TextureBinding {0, resources.get_view(input.normal), sampler},
-        gpu::TextureBinding {1, resources.get_view(input.depth), depth_sampler},
-        gpu::TextureBinding {2, resources.get_view(input.color), sampler},
-        gpu::UBOBinding {3, cmd.get_ubo_pool(), block},
-        gpu::TextureBinding {4, resources.get_view(input.material), sampler});
-
       const auto &image_info = resources.get_image(input.rt)->get_extent();
       auto w = image_info.width;
       auto h = image_info.height;
@@ -67,7 +58,12 @@ void add_ssr_pass(
       cmd.bind_pipeline(pipeline);
       cmd.bind_viewport(0.f, 0.f, float(w), float(h), 0.f, 1.f);
       cmd.bind_scissors(0, 0, w, h);
-      cmd.bind_descriptors_graphics(0, {set}, {block.offset});
+      resources.bind_set(cmd, pipeline, 0, {block.offset},
+        gpu::TextureBinding {0, resources.get_view(input.normal), sampler},
+        gpu::TextureBinding {1, resources.get_view(input.depth), depth_sampler},
+        gpu::TextureBinding {2, resources.get_view(input.color), sampler},
+        gpu::UBOBinding {3, cmd.get_ubo_pool(), block},
+        gpu::TextureBinding {4, resources.get_view(input.material), sampler});
       cmd.draw(3, 1, 0, 0);
       cmd.end_renderpass();
     });
@@ -6,9 +6,11 @@ TAA::TAA(rendergraph::RenderGraph &graph, uint32_t w, uint32_t h) {
   gpu::ImageInfo info {VK_FORMAT_R16G16B16A16_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, w, h};
   auto usage = VK_IMAGE_USAGE_SAMPLED_BIT|VK_IMAGE_USAGE_STORAGE_BIT|VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
 
-  history = graph.create_image(VK_IMAGE_TYPE_2D, info, VK_IMAGE_TILING_OPTIMAL, usage);
-  target = graph.create_image(VK_IMAGE_TYPE_2D, info, VK_IMAGE_TILING_OPTIMAL, usage);
+  resolved = graph.create_history_image(VK_IMAGE_TYPE_2D, info, VK_IMAGE_TILING_OPTIMAL, usage);
+  target = graph.get_current(resolved);
+  history = graph.get_previous(resolved);
   sampler = gpu::create_sampler(gpu::DEFAULT_SAMPLER);
+  sampler_index = gpu::get_sampler_index(sampler);
 }
 
 void TAA::run(rendergraph::RenderGraph &graph, const Gbuffer &gbuffer, rendergraph::ImageResourceId color, const DrawTAAParams &params) {
@@ -39,29 +41,35 @@ void TAA::run(rendergraph::RenderGraph &graph, const Gbuffer &gbuffer, rendergra
       input.out = builder.use_storage_image(target, VK_SHADER_STAGE_COMPUTE_BIT, 0, 0);
     },
     [=](PassData &input, rendergraph::RenderResources &resources, gpu::CmdContext &cmd){
-      auto set = resources.allocate_set(pipeline, 0);
       auto blk = cmd.allocate_ubo<TAAParams>();
       *blk.ptr = consts;
 
-      gpu::write_set(set,
-        gpu::TextureBinding {0, resources.get_view(input.history_color), sampler},
-        gpu::TextureBinding {1, resources.get_view(input.history_depth), sampler},
-        gpu::TextureBinding {2, resources.get_view(input.current_depth), sampler},
-        gpu::TextureBinding {3, resources.get_view(input.velocity), sampler},
-        gpu::TextureBinding {4, resources.get_view(input.color), sampler},
-        gpu::StorageTextureBinding {5, resources.get_view(input.out)},
-        gpu::UBOBinding {6, cmd.get_ubo_pool(), blk}
-      );
+      struct PushConstants {
+        uint32_t history_color_index;
+        uint32_t history_depth_index;
+        uint32_t current_depth_index;
+        uint32_t velocity_index;
+        uint32_t color_index;
+        uint32_t out_index;
+        uint32_t sampler_index;
+      };
+
+      PushConstants pc {
+        resources.get_sampled_index(input.history_color),
+        resources.get_sampled_index(input.history_depth),
+        resources.get_sampled_index(input.current_depth),
+        resources.get_sampled_index(input.velocity),
+        resources.get_sampled_index(input.color),
+        resources.get_storage_index(input.out),
+        sampler_index
+      };
 
       const auto &extent = resources.get_image(input.out)->get_extent();
 
       cmd.bind_pipeline(pipeline);
-      cmd.bind_descriptors_compute(0, {set}, {blk.offset});
-      //cmd.push_constants_compute(0, sizeof(pc), &pc);
+      resources.bind_set(cmd, pipeline, 0, {blk.offset},
+        gpu::UBOBinding {0, cmd.get_ubo_pool(), blk});
+      cmd.push_constants_compute(0, sizeof(pc), &pc);
       cmd.dispatch((extent.width + 7)/8, (extent.height + 7)/8, 1);
     });
-}
-
-void TAA::remap_targets(rendergraph::RenderGraph &graph) {
-  graph.remap(history, target);
 }
\ No newline at end of file
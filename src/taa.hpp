@@ -9,15 +9,16 @@ struct TAA {
   TAA(rendergraph::RenderGraph &graph, uint32_t w, uint32_t h);
 
   void run(rendergraph::RenderGraph &graph, const Gbuffer &gbuffer, rendergraph::ImageResourceId color, const DrawTAAParams &params);
-  void remap_targets(rendergraph::RenderGraph &graph);
 
   rendergraph::ImageResourceId get_output() const { return target; }
 
 private:
   rendergraph::ImageResourceId history;
   rendergraph::ImageResourceId target;
+  rendergraph::HistoryImageId resolved;
   gpu::ComputePipeline pipeline;
   VkSampler sampler;
+  uint32_t sampler_index;
 };
 
 #endif
\ No newline at end of file
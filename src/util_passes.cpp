@@ -76,6 +76,7 @@ void gen_mipmaps(rendergraph::RenderGraph &graph, rendergraph::ImageResourceId i
           .layerCount = 1
         }; 
 
+        cmd.flush_renderpass();
         vkCmdBlitImage(
           cmd.get_command_buffer(),
           api_image,
@@ -109,6 +110,7 @@ void clear_depth(rendergraph::RenderGraph &graph, rendergraph::ImageResourceId i
         info.array_layers
       };
 
+      cmd.flush_renderpass();
       vkCmdClearDepthStencilImage(
         cmd.get_command_buffer(),
         resources.get_image(image)->api_image(),
@@ -139,6 +141,7 @@ void clear_color(rendergraph::RenderGraph &graph, rendergraph::ImageResourceId i
         info.array_layers
       };
 
+      cmd.flush_renderpass();
       vkCmdClearColorImage(
         cmd.get_command_buffer(),
         resources.get_image(image)->api_image(),
@@ -166,6 +169,7 @@ void blit_image(rendergraph::RenderGraph &graph, rendergraph::ImageResourceId sr
         .dstOffsets {{0, 0, 0}, {(int32_t)dst_ext.width, (int32_t)dst_ext.height, 1}}
       };
 
+      cmd.flush_renderpass();
       vkCmdBlitImage(
         cmd.get_command_buffer(),
         resources.get_image(src)->api_image(),